@@ -0,0 +1,243 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Conversion microbenchmark. Every pair of color types is timed, which covers
+	each direct conversion in the descriptor table and each proxied route. Pairs
+	needing a change of extra (YUV matrices, YCbCr range) are timed too.
+
+	Each pair is timed three ways:
+	- scalar: color_convert on each color.
+	- plan: color_plan_execute with the scalar step functions only.
+	- batch: color_plan_execute using whatever batch kernels the plan has.
+
+	Inputs are the pixels of a synthetic image, smooth gradients with noise,
+	converted to the source type beforehand. Results are printed as JSON.
+
+	usage: bench [colors per run] [minimum milliseconds per measurement]
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static double now_ns(void)
+{
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	return (double)count.QuadPart * 1e9 / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+#endif
+
+enum bench_variant
+{
+	BENCH_SCALAR,
+	BENCH_PLAN,
+	BENCH_BATCH
+};
+
+static char const* const variant_names[] = { "scalar", "plan", "batch" };
+
+static void make_input(struct color *dst, size_t count, enum color_type type, uint8_t extra)
+{
+	uint32_t seed = 12345;
+	size_t i;
+
+	for(i = 0; i < count; ++i)
+	{
+		int R, G, B;
+
+		seed = seed * 1664525u + 1013904223u;
+
+		// a slowly varying base color plus a little noise, like photographic content.
+
+		R = (int)((i * 7 / 64) % 256) + (int)((seed >> 8) % 9) - 4;
+		G = (int)((i / 251) % 256) + (int)((seed >> 12) % 9) - 4;
+		B = (int)((i * 3 / 128 + 64) % 256) + (int)((seed >> 16) % 9) - 4;
+
+		dst[i].type = COLOR_RGB8;
+		dst[i].extra = 0;
+		dst[i].RGB8.R = (uint8_t)(R < 0 ? 0 : R > 255 ? 255 : R);
+		dst[i].RGB8.G = (uint8_t)(G < 0 ? 0 : G > 255 ? 255 : G);
+		dst[i].RGB8.B = (uint8_t)(B < 0 ? 0 : B > 255 ? 255 : B);
+
+		color_convert(&dst[i], type, extra);
+	}
+}
+
+static double run_once(enum bench_variant variant, struct color *work, struct color const *input, size_t count, struct color_plan const *plan)
+{
+	double start, end;
+	size_t i;
+
+	memcpy(work, input, count * sizeof(struct color));
+
+	start = now_ns();
+
+	switch(variant)
+	{
+	case BENCH_SCALAR:
+		for(i = 0; i < count; ++i)
+		{
+			color_convert(&work[i], (enum color_type)plan->dst_type, plan->dst_extra);
+		}
+		break;
+	case BENCH_PLAN:
+	case BENCH_BATCH:
+		color_plan_execute(plan, work, count);
+		break;
+	}
+
+	end = now_ns();
+	return end - start;
+}
+
+// best time of several runs, in ns per color.
+
+static double measure(enum bench_variant variant, struct color *work, struct color const *input, size_t count, struct color_plan const *plan, double min_ns)
+{
+	double best = -1.0, total = 0.0, t;
+	int runs = 0;
+
+	while(runs < 3 || total < min_ns)
+	{
+		t = run_once(variant, work, input, count, plan);
+
+		if(best < 0.0 || t < best) best = t;
+		total += t;
+		++runs;
+	}
+
+	return best / (double)count;
+}
+
+static void bench_pair(struct color *work, struct color *input, size_t count, double min_ns,
+	enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra, int *first)
+{
+	struct color_plan plan, scalar_plan;
+	double ns[3];
+	unsigned i;
+	int v;
+
+	color_plan_init(&plan, from, from_extra, to, to_extra);
+
+	scalar_plan = plan;
+
+	for(i = 0; i < scalar_plan.count; ++i)
+	{
+		scalar_plan.batch[i] = NULL;
+	}
+
+	make_input(input, count, from, from_extra);
+
+	for(v = BENCH_SCALAR; v <= BENCH_BATCH; ++v)
+	{
+		ns[v] = measure((enum bench_variant)v, work, input, count, v == BENCH_PLAN ? &scalar_plan : &plan, min_ns);
+	}
+
+	printf("%s\t\t{ \"from\": \"%s\", \"from_extra\": %u, \"to\": \"%s\", \"to_extra\": %u, \"route\": \"%s\", \"steps\": %u",
+		*first ? "" : ",\n", color_name(from), from_extra, color_name(to), to_extra, plan.count == 1 ? "direct" : "proxied", plan.count);
+
+	for(v = BENCH_SCALAR; v <= BENCH_BATCH; ++v)
+	{
+		printf(", \"%s_ns\": %.3f", variant_names[v], ns[v]);
+	}
+
+	printf(" }");
+	fflush(stdout);
+
+	*first = 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct color *work, *input;
+	size_t count = 65536;
+	double min_ns = 20e6;
+	int from, to, first = 1;
+
+	if(argc > 1) count = (size_t)strtoul(argv[1], NULL, 10);
+	if(argc > 2) min_ns = strtod(argv[2], NULL) * 1e6;
+
+	if(!count)
+	{
+		fprintf(stderr, "usage: %s [colors per run] [minimum milliseconds per measurement]\n", argv[0]);
+		return 1;
+	}
+
+	work = (struct color*)malloc(count * sizeof(struct color));
+	input = (struct color*)malloc(count * sizeof(struct color));
+
+	if(!work || !input)
+	{
+		fprintf(stderr, "out of memory.\n");
+		return 1;
+	}
+
+	printf("{\n\t\"colors\": %u,\n\t\"results\":\n\t[\n", (unsigned)count);
+
+	for(from = COLOR_RGB8; from < COLOR_DUMMY_END; ++from)
+	{
+		for(to = COLOR_RGB8; to < COLOR_DUMMY_END; ++to)
+		{
+			if(from != to)
+			{
+				bench_pair(work, input, count, min_ns, (enum color_type)from, 0, (enum color_type)to, 0, &first);
+			}
+		}
+	}
+
+	// conversions that only change extra.
+
+	bench_pair(work, input, count, min_ns, COLOR_YUV, COLOR_YUV_MAT_REC601, COLOR_YUV, COLOR_YUV_MAT_REC709, &first);
+	bench_pair(work, input, count, min_ns, COLOR_YCBCR, COLOR_YUV_MAT_REC601, COLOR_YCBCR, COLOR_YUV_MAT_REC709, &first);
+	bench_pair(work, input, count, min_ns, COLOR_YCBCR, COLOR_YUV_MAT_REC601, COLOR_YCBCR, COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE, &first);
+	bench_pair(work, input, count, min_ns, COLOR_YCBCR, COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE, COLOR_YCBCR, COLOR_YUV_MAT_REC601, &first);
+
+	printf("\n\t]\n}\n");
+
+	free(work);
+	free(input);
+	return 0;
+}
@@ -0,0 +1,2234 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Accuracy test for the batch paths. Colors are swept over the whole RGB8
+	cube, over all 8-bit codes, or randomly over a type's nominal component
+	ranges, and the batch result is compared against color_convert, or
+	against the original color for round trips. Sweeps run in parallel, with per-thread error
+	accumulators merged at the end.
+
+	Palette dithering is checked on flat fills between two entries, against the
+	mean output the fill should produce.
+
+	Checked are round trips through every type over the full RGB8 cube, storage
+	as packed floats and halves (and Lab as Lab16) over each type's nominal
+	range, fixed-point YCbCr matrix changes, 8-bit HSV and Lab and the single
+	luma components of RGB8 over all 2^24 codes, the mean output of palette
+	dithering over flat fills, in-place conversion of arrays mixing types and
+	of masked and rectangular image regions, image statistics, quantization,
+	resampling and blending, gradients, instrumentation counters, file
+	conversion, and every plan and every colors::convert of color.hpp against
+	color_convert over random inputs. Maximum and mean error per component are
+	printed as JSON. The polar batch kernels, Lab <-> LCHab and Luv <-> LCHuv on
+	their own, are reported as "polar", with the a and b error of the inverse
+	direction divided by the color's C.
+
+	The exit status is non-zero when a result exceeds its documented bound:
+	- round_trip: any difference, or more than two codes through YCbCr. RGB8
+	  black through Luv, LCHuv and LSHuv is left out: L = 0 gives NaN on the
+	  way back to XYZ.
+	- polar: any difference in L or in the C computed, or more than 1e-12 in
+	  hue or in a and b relative to C.
+	- plan: any difference, except on routes with more steps around a polar
+	  kernel, which amplify its difference.
+	- ycbcr_fixed and code8: more than one code value.
+	- luma: any difference.
+	- dither: a fill whose mean index is off by more than 1/64.
+	- mixed: any difference from converting each color with its own plan.
+	- masked and rects: any difference from converting the selected pixels one
+	  at a time, or any change to the others.
+	- resample: more than one code from linearizing, filtering in double and
+	  encoding with color_convert.
+	- blend: any difference from dst where alpha is 0 and src where it is 255,
+	  or a change past the width.
+	- gradient: more than 1e-9 from interpolating each sample on its own, or
+	  a hue outside [0, period).
+	- instrument: a per-edge call or color count that differs from the steps
+	  a plan and color_convert run, or any count without COLOR_INSTRUMENT.
+	- quantize: a palette of no colors or more than asked for, or an index
+	  whose entry is farther from its pixel than the nearest, beyond 1e-5
+	  relative.
+	- stats: a count, extent or histogram bin that differs, or a mean or
+	  variance off by more than 1e-12 relative to max(1, |value|).
+	- file: a file converted onto itself, by its own path or through a
+	  symbolic link, that is not refused or that changes; a named pipe that
+	  is accepted or removed; or a conversion to a new file that differs
+	  from the plan's.
+	- hpp: any difference, or a pair of types and extras without a route.
+	Storage formats are reported only. Failures are listed on stderr.
+
+	Build it with the library, like bench.c; it needs color_internal.h, and
+	check_hpp.cpp compiled as C++17. The file check writes its temporary files
+	to the current directory. Build the library with COLOR_INSTRUMENT too, to
+	check the instrumentation counters as well as their absence.
+
+	usage: check [random samples per pair]
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef _WIN32
+// symlink and mkfifo, which strict C11 modes hide.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <math.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#define CUBE_SIZE ((size_t)1 << 24)
+
+enum check_kind
+{
+	CHECK_PLAN, // the plan from -> to against color_convert.
+	CHECK_POLAR, // as CHECK_PLAN, with the error in components 1 and 2 relative to a polar source's C.
+	CHECK_ROUND_TRIP, // from -> to -> from against the input.
+	CHECK_FORMAT, // stored in format and read back.
+	CHECK_YCBCR, // color_ycbcr_convert against color_convert.
+	CHECK_CODE8, // 8-bit HSV or Lab against color_convert, rounded.
+	CHECK_LUMA, // color_rgb8_luma against the component of color_convert's result.
+	CHECK_HPP // colors::convert from color.hpp against color_convert.
+};
+
+enum check_sweep
+{
+	SWEEP_RGB8_CUBE, // all 2^24 RGB8 colors, converted to the source type.
+	SWEEP_RANDOM, // uniformly random components over color_component_range of the source type.
+	SWEEP_CODES // all 2^24 byte triplets, as the components of an RGB8 or YCbCr source.
+};
+
+struct check_error
+{
+	uint64_t count;
+	uint64_t mismatches; // colors with any component differing.
+	double max[3], mean[3]; // absolute error per component.
+};
+
+struct check_accum
+{
+	uint64_t count, mismatches;
+	double max[3], sum[3];
+};
+
+// colors::convert from src's type and extra to another, in check_hpp.cpp. returns 0 when it has
+// no route between them.
+
+int check_hpp_convert(struct color *dst, enum color_type to, uint8_t to_extra, struct color const *src, size_t count);
+
+static uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+static void make_sample(struct color *c, size_t i, enum check_sweep sweep, enum color_type type, uint8_t extra, double const *lo, double const *hi)
+{
+	if(sweep == SWEEP_RGB8_CUBE)
+	{
+		c->type = COLOR_RGB8;
+		c->extra = 0;
+		c->RGB8.R = (uint8_t)i;
+		c->RGB8.G = (uint8_t)(i >> 8);
+		c->RGB8.B = (uint8_t)(i >> 16);
+
+		color_convert(c, type, extra);
+	}
+	else if(sweep == SWEEP_CODES)
+	{
+		assert(type == COLOR_RGB8 || type == COLOR_YCBCR);
+
+		c->type = (uint8_t)type;
+		c->extra = extra;
+		c->RGB8.R = (uint8_t)i;
+		c->RGB8.G = (uint8_t)(i >> 8);
+		c->RGB8.B = (uint8_t)(i >> 16);
+	}
+	else
+	{
+		double v[3];
+		uint64_t r = i;
+		int j;
+
+		for(j = 0; j < 3; ++j)
+		{
+			r = splitmix64(r);
+			v[j] = (double)(r >> 11) * (1.0 / 9007199254740992.0) * (hi[j] - lo[j]) + lo[j];
+		}
+
+		color_set_components(c, type, extra, v);
+	}
+}
+
+// the double path for 8-bit HSV and Lab. c holds the codes on either side as an RGB8 color;
+// type is COLOR_HSV or COLOR_LAB.
+
+static void code8_reference(struct color *c, enum color_type type, int to_rgb8)
+{
+	double v[3];
+
+	assert(c->type == COLOR_RGB8);
+	assert(type == COLOR_HSV || type == COLOR_LAB);
+
+	color_extract_components(v, c);
+
+	if(to_rgb8)
+	{
+		if(type == COLOR_HSV)
+		{
+			v[0] *= 1.0 / 30.0;
+			v[1] *= 1.0 / 255.0;
+			v[2] *= 1.0 / 255.0;
+		}
+		else
+		{
+			v[0] *= 100.0 / 255.0;
+			v[1] -= 128.0;
+			v[2] -= 128.0;
+		}
+
+		color_set_components(c, type, 0, v);
+		color_convert(c, COLOR_RGB8, 0);
+		return;
+	}
+
+	color_convert(c, type, 0);
+	color_extract_components(v, c);
+
+	if(type == COLOR_HSV)
+	{
+		// hue is in (-1, 6), and wraps once rounded.
+
+		v[0] = floor(v[0] * 30.0 + 0.5);
+		v[0] += v[0] < 0.0 ? 180.0 : v[0] >= 180.0 ? -180.0 : 0.0;
+		v[1] *= 255.0;
+		v[2] *= 255.0;
+	}
+	else
+	{
+		v[0] *= 255.0 / 100.0;
+		v[1] += 128.0;
+		v[2] += 128.0;
+	}
+
+	color_set_components(c, COLOR_RGB8, 0, v);
+}
+
+// scale divides the error of components 1 and 2. a color of another type or extra than b is an
+// infinite error.
+
+static void check_accum_add(struct check_accum *acc, struct color const *a, struct color const *b, double scale)
+{
+	double va[3], vb[3], d;
+	int j, mismatch = 0, same = a->type == b->type && a->extra == b->extra;
+
+	color_extract_components(va, a);
+	color_extract_components(vb, b);
+
+	for(j = 0; j < 3; ++j)
+	{
+		// NaN matches NaN. NaN against a number is an infinite error.
+
+		if(!same)
+		{
+			d = HUGE_VAL;
+		}
+		else if(va[j] != va[j] || vb[j] != vb[j])
+		{
+			d = (va[j] != va[j]) == (vb[j] != vb[j]) ? 0.0 : HUGE_VAL;
+		}
+		else
+		{
+			d = fabs(va[j] - vb[j]);
+		}
+
+		if(j) d /= scale;
+
+		if(d > acc->max[j]) acc->max[j] = d;
+		acc->sum[j] += d;
+		mismatch |= d != 0.0;
+	}
+
+	acc->mismatches += mismatch;
+	++acc->count;
+}
+
+static int is_polar(enum color_type type)
+{
+	return type == COLOR_LCHAB || type == COLOR_LCHUV || type == COLOR_LSHUV;
+}
+
+static int luv_based(enum color_type type)
+{
+	return type == COLOR_LUV || type == COLOR_LCHUV || type == COLOR_LSHUV;
+}
+
+static int check_run(struct check_error *err, enum check_kind kind, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra,
+	enum color_format format, enum check_sweep sweep, size_t samples)
+{
+	struct check_accum *accs;
+	struct color_plan plan, back;
+	void (COLOR_CALL *code8)(void*, void const*, enum color_format, size_t) = NULL;
+	double lo[3], hi[3];
+	size_t total;
+	int threads, t, j;
+
+	assert(err != NULL);
+	assert(sweep == SWEEP_RGB8_CUBE || sweep == SWEEP_RANDOM || sweep == SWEEP_CODES);
+
+	total = sweep != SWEEP_RANDOM ? CUBE_SIZE : samples;
+	threads = total >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+
+	accs = (struct check_accum*)calloc(threads, sizeof(struct check_accum));
+
+	if(!accs)
+	{
+		return 0;
+	}
+
+	// 8-bit HSV and Lab are swept as codes, whichever side they are on.
+	color_component_range(lo, hi, kind == CHECK_CODE8 ? COLOR_RGB8 : from);
+
+	switch(kind)
+	{
+	case CHECK_FORMAT:
+	case CHECK_YCBCR:
+		// packing only.
+		color_plan_init(&plan, from, from_extra, from, from_extra);
+		break;
+	case CHECK_ROUND_TRIP:
+		color_plan_init(&plan, from, from_extra, to, to_extra);
+		color_plan_init(&back, to, to_extra, from, from_extra);
+		break;
+	case CHECK_LUMA:
+		// no plan.
+		break;
+	case CHECK_CODE8:
+		code8 = from == COLOR_HSV ? color_hsv8_to_rgb8 : from == COLOR_LAB ? color_lab8_to_rgb8 : to == COLOR_HSV ? color_rgb8_to_hsv8 : color_rgb8_to_lab8;
+		break;
+	default:
+		color_plan_init(&plan, from, from_extra, to, to_extra);
+		break;
+	}
+
+#pragma omp parallel num_threads(threads)
+	{
+		struct check_accum *acc = &accs[color_thread_index()];
+		struct color src[COLOR_CHUNK], fast[COLOR_CHUNK];
+		struct color_packedf packed[COLOR_CHUNK];
+		struct color_packed24 codes[COLOR_CHUNK];
+		double scale[COLOR_CHUNK], luma[COLOR_CHUNK];
+		ptrdiff_t block;
+
+#pragma omp for schedule(dynamic, 16)
+		for(block = 0; block < (ptrdiff_t)((total + COLOR_CHUNK - 1) / COLOR_CHUNK); ++block)
+		{
+			size_t first = (size_t)block * COLOR_CHUNK;
+			size_t n = total - first < COLOR_CHUNK ? total - first : COLOR_CHUNK;
+			size_t i;
+
+			for(i = 0; i < n; ++i)
+			{
+				make_sample(&src[i], first + i, sweep, kind == CHECK_CODE8 ? COLOR_RGB8 : from, from_extra, lo, hi);
+
+				// C of an LCHab or LCHuv source, which is 0 only when a and b are exactly 0.
+				scale[i] = kind == CHECK_POLAR && is_polar(from) && src[i].LCHab.C > 0.0 ? src[i].LCHab.C : 1.0;
+			}
+
+			switch(kind)
+			{
+			case CHECK_FORMAT:
+				color_plan_execute_packed(&plan, packed, format, src, COLOR_FORMAT_COLOR, n);
+				color_plan_execute_packed(&plan, fast, COLOR_FORMAT_COLOR, packed, format, n);
+				break;
+			case CHECK_ROUND_TRIP:
+				memcpy(fast, src, n * sizeof(struct color));
+				color_plan_execute(&plan, fast, n);
+				color_plan_execute(&back, fast, n);
+				break;
+			case CHECK_YCBCR:
+				color_plan_execute_packed(&plan, codes, COLOR_FORMAT_PACKED24, src, COLOR_FORMAT_COLOR, n);
+				color_ycbcr_convert(codes, codes, COLOR_FORMAT_PACKED24, n, from_extra, to_extra);
+
+				for(i = 0; i < n; ++i)
+				{
+					fast[i].type = COLOR_YCBCR;
+					fast[i].extra = to_extra;
+					fast[i].YCbCr.Y = codes[i].c[0];
+					fast[i].YCbCr.Cb = codes[i].c[1];
+					fast[i].YCbCr.Cr = codes[i].c[2];
+					color_convert(&src[i], to, to_extra);
+				}
+				break;
+			case CHECK_CODE8:
+				for(i = 0; i < n; ++i)
+				{
+					codes[i].c[0] = src[i].RGB8.R;
+					codes[i].c[1] = src[i].RGB8.G;
+					codes[i].c[2] = src[i].RGB8.B;
+				}
+
+				code8(codes, codes, COLOR_FORMAT_PACKED24, n);
+
+				for(i = 0; i < n; ++i)
+				{
+					fast[i].type = COLOR_RGB8;
+					fast[i].extra = 0;
+					fast[i].RGB8.R = codes[i].c[0];
+					fast[i].RGB8.G = codes[i].c[1];
+					fast[i].RGB8.B = codes[i].c[2];
+					code8_reference(&src[i], from == COLOR_RGB8 ? to : from, from != COLOR_RGB8);
+
+					// hue codes 0 and 179 are one apart. 180 stands in for 0 on whichever side is 0.
+
+					if(to == COLOR_HSV && (fast[i].RGB8.R == 0) != (src[i].RGB8.R == 0) && fast[i].RGB8.R + src[i].RGB8.R == 179)
+					{
+						(fast[i].RGB8.R == 0 ? &fast[i] : &src[i])->RGB8.R = 180;
+					}
+				}
+				break;
+			case CHECK_HPP:
+				if(!check_hpp_convert(fast, to, to_extra, src, n))
+				{
+					// no route: an infinite error.
+					for(i = 0; i < n; ++i) fast[i].type = COLOR_NONE;
+				}
+
+				for(i = 0; i < n; ++i)
+				{
+					color_convert(&src[i], to, to_extra);
+				}
+				break;
+			case CHECK_LUMA:
+				color_rgb8_luma(luma, src, COLOR_FORMAT_COLOR, n, to == COLOR_YUV ? COLOR_LUMA_Y : to == COLOR_XYZ ? COLOR_LUMA_LUMINANCE : COLOR_LUMA_LIGHTNESS, to_extra);
+
+				for(i = 0; i < n; ++i)
+				{
+					double v[3];
+
+					// the full conversion, with its Y', Y or L replaced.
+
+					color_convert(&src[i], to, to_extra);
+					color_extract_components(v, &src[i]);
+					v[to == COLOR_XYZ ? 1 : 0] = luma[i];
+					color_set_components(&fast[i], to, to_extra, v);
+				}
+				break;
+			default:
+				memcpy(fast, src, n * sizeof(struct color));
+				color_plan_execute(&plan, fast, n);
+
+				for(i = 0; i < n; ++i)
+				{
+					color_convert(&src[i], to, to_extra);
+				}
+				break;
+			}
+
+			for(i = 0; i < n; ++i)
+			{
+				// RGB8 black has L = 0, which the Luv -> XYZ conversion turns into NaN.
+				if(kind == CHECK_ROUND_TRIP && sweep == SWEEP_RGB8_CUBE && first + i == 0 && luv_based(to))
+				{
+					continue;
+				}
+
+				check_accum_add(acc, &fast[i], &src[i], scale[i]);
+			}
+		}
+	}
+
+	memset(err, 0, sizeof *err);
+
+	for(t = 0; t < threads; ++t)
+	{
+		err->count += accs[t].count;
+		err->mismatches += accs[t].mismatches;
+
+		for(j = 0; j < 3; ++j)
+		{
+			if(accs[t].max[j] > err->max[j]) err->max[j] = accs[t].max[j];
+			err->mean[j] += accs[t].sum[j];
+		}
+	}
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->mean[j] = err->count ? err->mean[j] / (double)err->count : 0.0;
+	}
+
+	free(accs);
+	return 1;
+}
+
+// check_plan compares a plan's batch kernels against color_convert. check_round_trip converts
+// from -> via -> from with plans and compares against the input. samples is ignored when sweeping
+// the RGB8 cube or all codes.
+
+static int check_plan(struct check_error *err, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra, enum check_sweep sweep, size_t samples)
+{
+	return check_run(err, CHECK_PLAN, from, from_extra, to, to_extra, COLOR_FORMAT_COLOR, sweep, samples);
+}
+
+// a polar batch kernel against color_convert. from -> to is Lab <-> LCHab or Luv <-> LCHuv.
+
+static int check_polar(struct check_error *err, enum color_type from, enum color_type to, size_t samples)
+{
+	return check_run(err, CHECK_POLAR, from, 0, to, 0, COLOR_FORMAT_COLOR, SWEEP_RANDOM, samples);
+}
+
+// colors::convert against color_convert, over random colors of from.
+
+static int check_hpp(struct check_error *err, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra, size_t samples)
+{
+	return check_run(err, CHECK_HPP, from, from_extra, to, to_extra, COLOR_FORMAT_COLOR, SWEEP_RANDOM, samples);
+}
+
+static int check_round_trip(struct check_error *err, enum color_type from, uint8_t from_extra, enum color_type via, uint8_t via_extra, enum check_sweep sweep, size_t samples)
+{
+	assert(via > COLOR_NONE);
+	return check_run(err, CHECK_ROUND_TRIP, from, from_extra, via, via_extra, COLOR_FORMAT_COLOR, sweep, samples);
+}
+
+// stores colors in a packed float, half or Lab16 format and reads them back. swept over the type's
+// nominal component range, it gives the storage error for that range. Lab16 clamps a and b to
+// [-128, 127], below the top of Lab's nominal range.
+
+static int check_format(struct check_error *err, enum color_type type, uint8_t extra, enum color_format format, enum check_sweep sweep, size_t samples)
+{
+	assert(format == COLOR_FORMAT_FLOAT || format == COLOR_FORMAT_HALF || (format == COLOR_FORMAT_LAB16 && type == COLOR_LAB));
+	assert(type != COLOR_RGB8 && type != COLOR_YCBCR);
+	return check_run(err, CHECK_FORMAT, type, extra, type, extra, format, sweep, samples);
+}
+
+// color_ycbcr_convert against color_convert.
+
+static int check_ycbcr(struct check_error *err, uint8_t from_extra, uint8_t to_extra, enum check_sweep sweep, size_t samples)
+{
+	return check_run(err, CHECK_YCBCR, COLOR_YCBCR, from_extra, COLOR_YCBCR, to_extra, COLOR_FORMAT_PACKED24, sweep, samples);
+}
+
+// the 8-bit HSV or Lab conversions of type, COLOR_HSV or COLOR_LAB, against color_convert with the
+// codes rounded half up. to_rgb8 picks the conversion back to RGB8. sweeping all codes covers every
+// input of either direction.
+
+static int check_code8(struct check_error *err, enum color_type type, int to_rgb8, enum check_sweep sweep, size_t samples)
+{
+	assert(type == COLOR_HSV || type == COLOR_LAB);
+
+	return to_rgb8 ?
+		check_run(err, CHECK_CODE8, type, 0, COLOR_RGB8, 0, COLOR_FORMAT_PACKED24, sweep, samples) :
+		check_run(err, CHECK_CODE8, COLOR_RGB8, 0, type, 0, COLOR_FORMAT_PACKED24, sweep, samples);
+}
+
+// color_rgb8_luma's Y' of YUV in the matrix given by extra, Y of XYZ or L of Lab, as type says,
+// against color_convert. sweeping all codes covers every input.
+
+static int check_luma(struct check_error *err, enum color_type type, uint8_t extra, enum check_sweep sweep, size_t samples)
+{
+	assert(type == COLOR_YUV || type == COLOR_XYZ || type == COLOR_LAB);
+	return check_run(err, CHECK_LUMA, COLOR_RGB8, 0, type, extra, COLOR_FORMAT_COLOR, sweep, samples);
+}
+
+// color_convert_mixed against a plan per color, over samples random colors. a mixed array takes every
+// type, with random YUV and YCbCr extras, so that some colors are already in to/to_extra. otherwise all
+// colors are YCbCr in full range BT.601, one bucket covering the whole array.
+
+static int check_mixed(struct check_error *err, int mixed, enum color_type to, uint8_t to_extra, size_t samples)
+{
+	struct color_plan plans[COLOR_DUMMY_END - 1][8];
+	struct check_accum acc;
+	struct color *c, *ref;
+	double lo[3], hi[3];
+	size_t i;
+	int t, e, j;
+
+	assert(err != NULL);
+	assert(mixed || to != COLOR_YCBCR || to_extra != (COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE));
+
+	c = (struct color*)malloc(sizeof(struct color) * samples);
+	ref = (struct color*)malloc(sizeof(struct color) * samples);
+
+	if(!c || !ref)
+	{
+		free(c);
+		free(ref);
+		return 0;
+	}
+
+	for(t = COLOR_RGB8; t < COLOR_DUMMY_END; ++t)
+	{
+		for(e = 0; e < (t == COLOR_YCBCR ? 8 : t == COLOR_YUV ? 4 : 1); ++e)
+		{
+			color_plan_init(&plans[t - 1][e], (enum color_type)t, (uint8_t)e, to, to_extra);
+		}
+	}
+
+	for(i = 0; i < samples; ++i)
+	{
+		uint64_t r = splitmix64(~(uint64_t)i);
+		enum color_type type = mixed ? (enum color_type)(r % (COLOR_DUMMY_END - 1) + 1) : COLOR_YCBCR;
+		uint8_t extra = !mixed ? COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE : type == COLOR_YCBCR ? (uint8_t)(r >> 32 & 7) : type == COLOR_YUV ? (uint8_t)(r >> 32 & 3) : 0;
+
+		color_component_range(lo, hi, type);
+		make_sample(&c[i], i, SWEEP_RANDOM, type, extra, lo, hi);
+
+		ref[i] = c[i];
+
+		if(type != to || extra != to_extra)
+		{
+			color_plan_execute(&plans[type - 1][extra], &ref[i], 1);
+		}
+	}
+
+	if(!color_convert_mixed(c, samples, to, to_extra))
+	{
+		free(c);
+		free(ref);
+		return 0;
+	}
+
+	memset(&acc, 0, sizeof acc);
+
+	for(i = 0; i < samples; ++i)
+	{
+		check_accum_add(&acc, &c[i], &ref[i], 1.0);
+	}
+
+	free(c);
+	free(ref);
+
+	err->count = acc.count;
+	err->mismatches = acc.mismatches;
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->max[j] = acc.max[j];
+		err->mean[j] = acc.count ? acc.sum[j] / (double)acc.count : 0.0;
+	}
+
+	return 1;
+}
+
+// color_image_convert_masked, or color_image_convert_rects when rects is set, against converting
+// the selected pixels one at a time. the image is REGION_WIDTH wide, not a multiple of 64, with
+// RGB8 pixels in the stride past it that must stay untouched, as must every unselected pixel.
+// density picks the mask: 0 for none, 1 for a mix of random, sparse, full and nearly full words
+// and runs, 2 for every pixel. mask bits past the width are always set. the rectangles overlap,
+// repeat, touch the edges and include empty ones.
+
+#define REGION_WIDTH 150
+#define REGION_STRIDE 163
+#define REGION_HEIGHT 120
+#define REGION_MASK_STRIDE 24
+
+static int check_region(struct check_error *err, int rects, int density, enum color_type to)
+{
+	static struct color_rect const rect_list[] =
+	{
+		{ 0, 0, REGION_WIDTH, 1 }, // first row.
+		{ 10, 5, 40, 30 },
+		{ 30, 20, 60, 10 }, // overlaps the one before.
+		{ 50, 5, 10, 30 }, // touches it.
+		{ 10, 5, 40, 30 }, // repeated.
+		{ 20, 10, 5, 5 }, // inside another.
+		{ 100, 0, 0, 50 }, // empty.
+		{ 0, 60, 70, 0 }, // empty.
+		{ REGION_WIDTH - 7, 40, 7, REGION_HEIGHT - 40 }, // right and bottom edges.
+		{ 0, 90, REGION_WIDTH, 3 }, // full rows.
+		{ 63, 100, 3, 20 } // across x = 64.
+	};
+
+	struct color_image img;
+	struct color_plan plan;
+	struct check_accum acc;
+	struct color *ref;
+	uint8_t *mask, *sel;
+	size_t x, y, i, r;
+	int j;
+
+	assert(err != NULL);
+
+	img.width = REGION_WIDTH;
+	img.height = REGION_HEIGHT;
+	img.stride = REGION_STRIDE;
+	img.pixels = (struct color*)malloc(sizeof(struct color) * REGION_STRIDE * REGION_HEIGHT);
+	ref = (struct color*)malloc(sizeof(struct color) * REGION_STRIDE * REGION_HEIGHT);
+	mask = (uint8_t*)calloc(REGION_MASK_STRIDE * REGION_HEIGHT, 1);
+	sel = (uint8_t*)calloc(REGION_WIDTH * REGION_HEIGHT, 1);
+
+	if(!img.pixels || !ref || !mask || !sel)
+	{
+		free(img.pixels);
+		free(ref);
+		free(mask);
+		free(sel);
+		return 0;
+	}
+
+	for(i = 0; i < REGION_STRIDE * REGION_HEIGHT; ++i)
+	{
+		make_sample(&img.pixels[i], (size_t)splitmix64(i), SWEEP_RGB8_CUBE, COLOR_RGB8, 0, NULL, NULL);
+	}
+
+	// the selected pixels.
+
+	for(y = 0; y < REGION_HEIGHT; ++y)
+	{
+		for(x = 0; x < REGION_WIDTH; ++x)
+		{
+			uint64_t h = splitmix64(y * REGION_WIDTH + x + ((uint64_t)1 << 32));
+
+			if(rects)
+			{
+				for(r = 0; r < sizeof rect_list / sizeof rect_list[0]; ++r)
+				{
+					sel[y * REGION_WIDTH + x] |= x - rect_list[r].x < rect_list[r].width && y - rect_list[r].y < rect_list[r].height;
+				}
+			}
+			else if(density == 1)
+			{
+				switch(y % 4)
+				{
+				case 0: sel[y * REGION_WIDTH + x] = h & 1; break;
+				case 1: sel[y * REGION_WIDTH + x] = x != y % REGION_WIDTH; break;
+				case 2: sel[y * REGION_WIDTH + x] = x - y < 70; break;
+				default: sel[y * REGION_WIDTH + x] = (h & 15) == 0; break;
+				}
+			}
+			else
+			{
+				sel[y * REGION_WIDTH + x] = density == 2;
+			}
+		}
+
+		for(x = 0; x < REGION_MASK_STRIDE * 8; ++x)
+		{
+			if(x >= REGION_WIDTH || sel[y * REGION_WIDTH + x])
+			{
+				mask[y * REGION_MASK_STRIDE + x / 8] |= (uint8_t)(1 << (x % 8));
+			}
+		}
+	}
+
+	memcpy(ref, img.pixels, sizeof(struct color) * REGION_STRIDE * REGION_HEIGHT);
+	color_plan_init(&plan, COLOR_RGB8, 0, to, 0);
+
+	for(y = 0; y < REGION_HEIGHT; ++y)
+	{
+		for(x = 0; x < REGION_WIDTH; ++x)
+		{
+			if(sel[y * REGION_WIDTH + x])
+			{
+				color_plan_execute(&plan, &ref[y * REGION_STRIDE + x], 1);
+			}
+		}
+	}
+
+	if(rects)
+	{
+		if(!color_image_convert_rects(&img, rect_list, sizeof rect_list / sizeof rect_list[0], to, 0))
+		{
+			free(img.pixels);
+			free(ref);
+			free(mask);
+			free(sel);
+			return 0;
+		}
+	}
+	else
+	{
+		color_image_convert_masked(&img, mask, REGION_MASK_STRIDE, to, 0);
+	}
+
+	memset(&acc, 0, sizeof acc);
+
+	for(i = 0; i < REGION_STRIDE * REGION_HEIGHT; ++i)
+	{
+		check_accum_add(&acc, &img.pixels[i], &ref[i], 1.0);
+	}
+
+	free(img.pixels);
+	free(ref);
+	free(mask);
+	free(sel);
+
+	err->count = acc.count;
+	err->mismatches = acc.mismatches;
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->max[j] = acc.max[j];
+		err->mean[j] = acc.count ? acc.sum[j] / (double)acc.count : 0.0;
+	}
+
+	return 1;
+}
+
+// color_image_stats against converting each pixel with color_convert and a serial two-pass mean,
+// variance, extent and histogram. the image is strided and, unless empty, large enough to run in
+// parallel. an RGB source has NaN in one component of every 7th pixel, which the histogram counts
+// in bin 0 and the extents skip. the histogram spans the inner 80% of each component's range, so
+// the edge bins collect the rest. the per-thread merge only runs with more than one OpenMP thread,
+// e.g. OMP_NUM_THREADS=4 on a single core. mismatches counts the results over their bound: the count,
+// extents and histogram exact, the mean and variance within 1e-12 relative to max(1, |value|).
+// max is the largest relative difference of the mean and variance of each component.
+
+#define STATS_BINS 37
+
+static double stats_difference(double a, double b)
+{
+	if(a != a || b != b)
+	{
+		return (a != a) == (b != b) ? 0.0 : HUGE_VAL;
+	}
+
+	return fabs(a - b) / (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+static int check_stats(struct check_error *err, enum color_type from, enum color_type to, size_t width, size_t height)
+{
+	struct color_image img;
+	struct color_stats stats;
+	struct color *ref;
+	uint64_t *histogram, ref_histogram[STATS_BINS * 3];
+	double lo[3], hi[3], sum[3], mean[3], var[3], min[3], max[3], v[3];
+	size_t stride = width + 16, n = width * height, x, y, i;
+	int j;
+
+	assert(err != NULL);
+	assert(from == COLOR_RGB8 || from == COLOR_RGB);
+
+	img.width = width;
+	img.height = height;
+	img.stride = stride;
+	img.pixels = n ? (struct color*)malloc(sizeof(struct color) * stride * height) : NULL;
+	ref = n ? (struct color*)malloc(sizeof(struct color) * n) : NULL;
+	histogram = (uint64_t*)malloc(sizeof(uint64_t) * STATS_BINS * 3);
+
+	if((n && (!img.pixels || !ref)) || !histogram)
+	{
+		free(img.pixels);
+		free(ref);
+		free(histogram);
+		return 0;
+	}
+
+	for(i = 0; i < stride * height; ++i)
+	{
+		uint64_t r = splitmix64(i + 0x5747);
+
+		if(from == COLOR_RGB8)
+		{
+			v[0] = (double)(uint8_t)r;
+			v[1] = (double)(uint8_t)(r >> 8);
+			v[2] = (double)(uint8_t)(r >> 16);
+		}
+		else
+		{
+			for(j = 0; j < 3; ++j)
+			{
+				v[j] = (double)((r >> (j * 20)) & 0xFFFFF) * (1.0 / 1048576.0);
+			}
+
+			if(i % 7 == 0) v[i % 3] = NAN;
+		}
+
+		color_set_components(&img.pixels[i], from, 0, v);
+	}
+
+	color_component_range(lo, hi, to);
+
+	stats.bins = STATS_BINS;
+	stats.histogram = histogram;
+
+	for(j = 0; j < 3; ++j)
+	{
+		double margin = (hi[j] - lo[j]) * 0.1;
+
+		stats.lo[j] = lo[j] + margin;
+		stats.hi[j] = hi[j] - margin;
+
+		// the out fields, and the histogram, must all be overwritten.
+		stats.mean[j] = stats.variance[j] = stats.min[j] = stats.max[j] = 12345.0;
+		sum[j] = var[j] = 0.0;
+		min[j] = HUGE_VAL;
+		max[j] = -HUGE_VAL;
+	}
+
+	stats.count = 12345;
+	memset(histogram, 0xA5, sizeof(uint64_t) * STATS_BINS * 3);
+	memset(ref_histogram, 0, sizeof ref_histogram);
+
+	if(!color_image_stats(&stats, &img, to, 0))
+	{
+		free(img.pixels);
+		free(ref);
+		free(histogram);
+		return 0;
+	}
+
+	// the reference: every pixel converted on its own, then two passes.
+
+	for(y = 0; y < height; ++y)
+	{
+		for(x = 0; x < width; ++x)
+		{
+			struct color *c = &ref[y * width + x];
+
+			*c = img.pixels[y * stride + x];
+			color_convert(c, to, 0);
+			color_extract_components(v, c);
+
+			for(j = 0; j < 3; ++j)
+			{
+				double bin = floor((v[j] - stats.lo[j]) * ((double)STATS_BINS / (stats.hi[j] - stats.lo[j])));
+
+				sum[j] += v[j];
+				if(v[j] < min[j]) min[j] = v[j];
+				if(v[j] > max[j]) max[j] = v[j];
+
+				++ref_histogram[j * STATS_BINS + (v[j] != v[j] || bin < 0.0 ? 0 : bin > STATS_BINS - 1 ? STATS_BINS - 1 : (size_t)bin)];
+			}
+		}
+	}
+
+	for(j = 0; j < 3; ++j)
+	{
+		mean[j] = n ? sum[j] / (double)n : 0.0;
+	}
+
+	for(i = 0; i < n; ++i)
+	{
+		color_extract_components(v, &ref[i]);
+
+		for(j = 0; j < 3; ++j)
+		{
+			var[j] += (v[j] - mean[j]) * (v[j] - mean[j]);
+		}
+	}
+
+	memset(err, 0, sizeof *err);
+
+	err->count = n;
+	err->mismatches = stats.count != n;
+
+	for(j = 0; j < 3; ++j)
+	{
+		double dm = stats_difference(stats.mean[j], mean[j]);
+		double dv = stats_difference(stats.variance[j], n ? var[j] / (double)n : 0.0);
+
+		err->max[j] = dm > dv ? dm : dv;
+		err->mean[j] = (dm + dv) * 0.5;
+		err->mismatches += (dm > 1e-12) + (dv > 1e-12) + (stats.min[j] != min[j]) + (stats.max[j] != max[j]);
+	}
+
+	for(i = 0; i < STATS_BINS * 3; ++i)
+	{
+		err->mismatches += histogram[i] != ref_histogram[i];
+	}
+
+	free(img.pixels);
+	free(ref);
+	free(histogram);
+	return 1;
+}
+
+// color_quantize of a strided RGB8 image, large enough to run in parallel, against a brute-force
+// search over the palette it returns: every index must name an entry no farther from its pixel,
+// in float as color_quantize measures it, than the nearest one beyond rounding. distinct > 0 draws
+// the pixels from that many colors. the palette must have between 1 and the requested colors.
+// mismatches counts the indices that fail, plus one for a bad palette size; max[0] is the largest
+// excess distance relative to the nearest.
+
+#define QUANTIZE_WIDTH 173
+#define QUANTIZE_STRIDE 181
+#define QUANTIZE_HEIGHT 131
+
+static int check_quantize(struct check_error *err, enum color_type space, unsigned colors, unsigned distinct, unsigned iterations, double threshold)
+{
+	struct color_image img;
+	struct color palette[256];
+	uint8_t *indices;
+	unsigned k = colors, i;
+	size_t x, y;
+
+	assert(err != NULL);
+	assert(colors >= 1 && colors <= 256);
+
+	img.width = QUANTIZE_WIDTH;
+	img.height = QUANTIZE_HEIGHT;
+	img.stride = QUANTIZE_STRIDE;
+	img.pixels = (struct color*)malloc(sizeof(struct color) * QUANTIZE_STRIDE * QUANTIZE_HEIGHT);
+	indices = (uint8_t*)malloc(QUANTIZE_WIDTH * QUANTIZE_HEIGHT);
+
+	if(!img.pixels || !indices)
+	{
+		free(img.pixels);
+		free(indices);
+		return 0;
+	}
+
+	for(x = 0; x < QUANTIZE_STRIDE * QUANTIZE_HEIGHT; ++x)
+	{
+		uint64_t r = splitmix64(distinct ? splitmix64(x) % distinct : x);
+
+		img.pixels[x].type = COLOR_RGB8;
+		img.pixels[x].extra = 0;
+		img.pixels[x].RGB8.R = (uint8_t)r;
+		img.pixels[x].RGB8.G = (uint8_t)(r >> 8);
+		img.pixels[x].RGB8.B = (uint8_t)(r >> 16);
+	}
+
+	memset(err, 0, sizeof *err);
+
+	if(!color_quantize(palette, &k, indices, &img, space, iterations, threshold))
+	{
+		free(img.pixels);
+		free(indices);
+		return 0;
+	}
+
+	err->mismatches = k < 1 || k > colors;
+
+	for(y = 0; y < (err->mismatches ? 0 : QUANTIZE_HEIGHT); ++y)
+	{
+		for(x = 0; x < QUANTIZE_WIDTH; ++x)
+		{
+			struct color c = img.pixels[y * QUANTIZE_STRIDE + x];
+			unsigned idx = indices[y * QUANTIZE_WIDTH + x];
+			double v[3], best = HUGE_VAL, chosen = HUGE_VAL, excess;
+			float p[3];
+
+			color_convert(&c, space, 0);
+			color_extract_components(v, &c);
+
+			p[0] = (float)v[0];
+			p[1] = (float)v[1];
+			p[2] = (float)v[2];
+
+			for(i = 0; i < k; ++i)
+			{
+				double dx = (float)palette[i].Lab.L - p[0], dy = (float)palette[i].Lab.a - p[1], dz = (float)palette[i].Lab.b - p[2];
+				double d = dx * dx + dy * dy + dz * dz;
+
+				if(d < best) best = d;
+				if(i == idx) chosen = d;
+			}
+
+			// an index past the palette is an infinite error.
+			excess = (chosen - best) / (best > 1e-6 ? best : 1e-6);
+
+			if(excess > err->max[0]) err->max[0] = excess;
+			err->mean[0] += excess;
+			err->mismatches += excess > 1e-5;
+			++err->count;
+		}
+	}
+
+	if(err->count) err->mean[0] /= (double)err->count;
+
+	free(img.pixels);
+	free(indices);
+	return 1;
+}
+
+// color_resample_rgb8 against a double-precision reference: every source pixel linearized, each
+// axis weighted by the filter stretched over the scale and normalized, summed over the whole
+// source, and encoded with color_convert. the source is strided, and the output is large enough to
+// run in parallel. mismatches counts pixels more than one code off; max is in codes.
+
+#define RESAMPLE_WIDTH 403
+#define RESAMPLE_STRIDE 411
+#define RESAMPLE_HEIGHT 301
+
+static double resample_weight(enum color_filter filter, double x)
+{
+	switch(filter)
+	{
+	case COLOR_FILTER_BOX:
+		return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+	case COLOR_FILTER_BILINEAR:
+		return fabs(x) < 1.0 ? 1.0 - fabs(x) : 0.0;
+	default:
+		// sinc(x) * sinc(x / 3).
+		if(x == 0.0) return 1.0;
+		if(fabs(x) >= 3.0) return 0.0;
+		return 3.0 * sin(3.1415926535897932384626433833 * x) * sin(3.1415926535897932384626433833 * x / 3.0) / (9.8696044010893586188344909999 * x * x);
+	}
+}
+
+// the in weights of output pixel o, normalized.
+
+static void resample_weights(double *w, size_t in, size_t out, size_t o, enum color_filter filter)
+{
+	double scale = (double)in / (double)out, fscale = scale > 1.0 ? scale : 1.0;
+	double center = (o + 0.5) * scale, sum = 0.0;
+	size_t i;
+
+	for(i = 0; i < in; ++i)
+	{
+		w[i] = resample_weight(filter, (i + 0.5 - center) / fscale);
+		sum += w[i];
+	}
+
+	for(i = 0; i < in; ++i)
+	{
+		w[i] /= sum;
+	}
+}
+
+static int check_resample(struct check_error *err, enum color_filter filter, size_t width, size_t height)
+{
+	struct color_image src, dst;
+	double *lin, *rows, *w;
+	size_t x, y, i;
+	int j;
+
+	assert(err != NULL);
+
+	src.width = RESAMPLE_WIDTH;
+	src.height = RESAMPLE_HEIGHT;
+	src.stride = RESAMPLE_STRIDE;
+	src.pixels = (struct color*)malloc(sizeof(struct color) * RESAMPLE_STRIDE * RESAMPLE_HEIGHT);
+	dst.width = width;
+	dst.height = height;
+	dst.stride = width + 5;
+	dst.pixels = (struct color*)malloc(sizeof(struct color) * dst.stride * height);
+	lin = (double*)malloc(sizeof(double) * 3 * RESAMPLE_WIDTH * RESAMPLE_HEIGHT);
+	rows = (double*)malloc(sizeof(double) * 3 * width * RESAMPLE_HEIGHT);
+	w = (double*)malloc(sizeof(double) * RESAMPLE_WIDTH * RESAMPLE_HEIGHT);
+
+	if(!src.pixels || !dst.pixels || !lin || !rows || !w)
+	{
+		free(src.pixels);
+		free(dst.pixels);
+		free(lin);
+		free(rows);
+		free(w);
+		return 0;
+	}
+
+	// smooth gradients with noise and hard edges, which ring under Lanczos.
+
+	for(y = 0; y < RESAMPLE_HEIGHT; ++y)
+	{
+		for(x = 0; x < RESAMPLE_STRIDE; ++x)
+		{
+			struct color *c = &src.pixels[y * RESAMPLE_STRIDE + x];
+			uint64_t r = splitmix64(y * RESAMPLE_STRIDE + x);
+
+			c->type = COLOR_RGB8;
+			c->extra = 0;
+			c->RGB8.R = (uint8_t)(x * 255 / RESAMPLE_WIDTH + (r & 15));
+			c->RGB8.G = (uint8_t)((x / 17 + y / 13) & 1 ? 250 : 5);
+			c->RGB8.B = (uint8_t)(r >> 8);
+		}
+	}
+
+	if(!color_resample_rgb8(&dst, &src, filter))
+	{
+		free(src.pixels);
+		free(dst.pixels);
+		free(lin);
+		free(rows);
+		free(w);
+		return 0;
+	}
+
+	for(y = 0; y < RESAMPLE_HEIGHT; ++y)
+	{
+		for(x = 0; x < RESAMPLE_WIDTH; ++x)
+		{
+			struct color c = src.pixels[y * RESAMPLE_STRIDE + x];
+
+			color_convert(&c, COLOR_LINEAR_RGB, 0);
+			color_extract_components(lin + (y * RESAMPLE_WIDTH + x) * 3, &c);
+		}
+	}
+
+	// horizontally, then vertically.
+
+	for(x = 0; x < width; ++x)
+	{
+		resample_weights(w, RESAMPLE_WIDTH, width, x, filter);
+
+		for(y = 0; y < RESAMPLE_HEIGHT; ++y)
+		{
+			double v[3] = { 0.0, 0.0, 0.0 };
+
+			for(i = 0; i < RESAMPLE_WIDTH; ++i)
+			{
+				for(j = 0; j < 3; ++j)
+				{
+					v[j] += lin[(y * RESAMPLE_WIDTH + i) * 3 + j] * w[i];
+				}
+			}
+
+			for(j = 0; j < 3; ++j)
+			{
+				rows[(y * width + x) * 3 + j] = v[j];
+			}
+		}
+	}
+
+	memset(err, 0, sizeof *err);
+
+	for(y = 0; y < height; ++y)
+	{
+		resample_weights(w, RESAMPLE_HEIGHT, height, y, filter);
+
+		for(x = 0; x < width; ++x)
+		{
+			struct color ref;
+			double v[3] = { 0.0, 0.0, 0.0 }, a[3], b[3];
+			int mismatch = 0;
+
+			for(i = 0; i < RESAMPLE_HEIGHT; ++i)
+			{
+				for(j = 0; j < 3; ++j)
+				{
+					v[j] += rows[(i * width + x) * 3 + j] * w[i];
+				}
+			}
+
+			color_set_components(&ref, COLOR_LINEAR_RGB, 0, v);
+			color_convert(&ref, COLOR_RGB8, 0);
+			color_extract_components(a, &dst.pixels[y * dst.stride + x]);
+			color_extract_components(b, &ref);
+
+			for(j = 0; j < 3; ++j)
+			{
+				double d = dst.pixels[y * dst.stride + x].type == COLOR_RGB8 ? fabs(a[j] - b[j]) : HUGE_VAL;
+
+				if(d > err->max[j]) err->max[j] = d;
+				err->mean[j] += d;
+				mismatch |= d > 1.0;
+			}
+
+			err->mismatches += mismatch;
+			++err->count;
+		}
+	}
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->mean[j] /= (double)err->count;
+	}
+
+	free(src.pixels);
+	free(dst.pixels);
+	free(lin);
+	free(rows);
+	free(w);
+	return 1;
+}
+
+// color_blend_over_rgb8 with every alpha 0 or 255, which must give dst or src exactly, over a
+// strided image large enough to run in parallel. the alpha rows are strided too. mismatches counts
+// pixels that differ, or stride pixels of dst that changed; max is in codes.
+
+static int check_blend(struct check_error *err)
+{
+	struct color_image src, dst;
+	struct color *orig;
+	uint8_t *alpha;
+	size_t x, y, alpha_stride = RESAMPLE_WIDTH + 9;
+	int j;
+
+	assert(err != NULL);
+
+	src.width = dst.width = RESAMPLE_WIDTH;
+	src.height = dst.height = RESAMPLE_HEIGHT;
+	src.stride = RESAMPLE_STRIDE;
+	dst.stride = RESAMPLE_WIDTH + 3;
+	src.pixels = (struct color*)malloc(sizeof(struct color) * src.stride * RESAMPLE_HEIGHT);
+	dst.pixels = (struct color*)malloc(sizeof(struct color) * dst.stride * RESAMPLE_HEIGHT);
+	orig = (struct color*)malloc(sizeof(struct color) * dst.stride * RESAMPLE_HEIGHT);
+	alpha = (uint8_t*)malloc(alpha_stride * RESAMPLE_HEIGHT);
+
+	if(!src.pixels || !dst.pixels || !orig || !alpha)
+	{
+		free(src.pixels);
+		free(dst.pixels);
+		free(orig);
+		free(alpha);
+		return 0;
+	}
+
+	for(x = 0; x < src.stride * RESAMPLE_HEIGHT; ++x)
+	{
+		uint64_t r = splitmix64(x);
+
+		src.pixels[x].type = COLOR_RGB8;
+		src.pixels[x].extra = 0;
+		src.pixels[x].RGB8.R = (uint8_t)r;
+		src.pixels[x].RGB8.G = (uint8_t)(r >> 8);
+		src.pixels[x].RGB8.B = (uint8_t)(r >> 16);
+	}
+
+	for(x = 0; x < dst.stride * RESAMPLE_HEIGHT; ++x)
+	{
+		uint64_t r = splitmix64(x + 0x8000000);
+
+		orig[x].type = COLOR_RGB8;
+		orig[x].extra = 0;
+		orig[x].RGB8.R = (uint8_t)r;
+		orig[x].RGB8.G = (uint8_t)(r >> 8);
+		orig[x].RGB8.B = (uint8_t)(r >> 16);
+	}
+
+	for(x = 0; x < alpha_stride * RESAMPLE_HEIGHT; ++x)
+	{
+		alpha[x] = splitmix64(x + 0x9000000) & 1 ? 255 : 0;
+	}
+
+	memcpy(dst.pixels, orig, sizeof(struct color) * dst.stride * RESAMPLE_HEIGHT);
+	color_blend_over_rgb8(&dst, &src, alpha, alpha_stride);
+
+	memset(err, 0, sizeof *err);
+
+	for(y = 0; y < RESAMPLE_HEIGHT; ++y)
+	{
+		for(x = 0; x < dst.stride; ++x)
+		{
+			struct color const *want = x < RESAMPLE_WIDTH && alpha[y * alpha_stride + x] ? &src.pixels[y * src.stride + x] : &orig[y * dst.stride + x];
+			struct color const *got = &dst.pixels[y * dst.stride + x];
+			double a[3], b[3];
+			int mismatch = 0;
+
+			color_extract_components(a, got);
+			color_extract_components(b, want);
+
+			for(j = 0; j < 3; ++j)
+			{
+				double d = fabs(a[j] - b[j]);
+
+				if(d > err->max[j]) err->max[j] = d;
+				err->mean[j] += d;
+				mismatch |= d != 0.0;
+			}
+
+			err->mismatches += mismatch || got->type != want->type;
+			++err->count;
+		}
+	}
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->mean[j] /= (double)err->count;
+	}
+
+	free(src.pixels);
+	free(dst.pixels);
+	free(orig);
+	free(alpha);
+	return 1;
+}
+
+// color_gradient against interpolating each sample on its own and converting it with
+// color_convert. two segments between chromatic stops cross hue 0 in some modes, one segment has
+// no length, and the stops include an exact gray and a gray from RGB8, whose hue is noise; each
+// gray takes the hue of the other end of its segments. the gradient is made in RGB, and in the
+// space itself, where every hue must be in [0, period). mismatches counts samples more than 1e-9
+// off in any component, with hues compared around the circle, or with a hue out of range. max is
+// the larger of the two differences.
+
+#define GRADIENT_STOPS 8
+#define GRADIENT_SAMPLES 1000
+
+// moves h0 or h1 by a whole period for the mode, as CSS Color 4 does. both start in [0, period).
+
+static void gradient_hues(double *h0, double *h1, double period, enum color_hue_mode mode)
+{
+	double d = *h1 - *h0;
+
+	switch(mode)
+	{
+	case COLOR_HUE_SHORTER:
+		if(d > period * 0.5) *h0 += period;
+		else if(d < period * -0.5) *h1 += period;
+		break;
+	case COLOR_HUE_LONGER:
+		if(d > 0.0 && d < period * 0.5) *h0 += period;
+		else if(d <= 0.0 && d > period * -0.5) *h1 += period;
+		break;
+	case COLOR_HUE_INCREASING:
+		if(d < 0.0) *h1 += period;
+		break;
+	default:
+		if(d > 0.0) *h0 += period;
+		break;
+	}
+}
+
+static int check_gradient(struct check_error *err, enum color_type space, enum color_hue_mode mode)
+{
+	static double const positions[GRADIENT_STOPS] = { 0.05, 0.2, 0.4, 0.55, 0.55, 0.7, 0.8, 0.9 };
+
+	// hue, scaled to [0, 1) of the period, then the other two components of LCHab and HSL.
+	static double const stop_values[GRADIENT_STOPS][5] =
+	{
+		{ 0.05, 60.0, 40.0, 0.8, 0.5 },
+		{ 0.95, 70.0, 50.0, 0.6, 0.6 }, // shorter and decreasing cross 0.
+		{ 0.3, 50.0, 0.0, 0.0, 0.4 }, // gray.
+		{ 0.15, 45.0, 20.0, 0.5, 0.3 },
+		{ 0.4, 55.0, 30.0, 0.7, 0.5 }, // at the same position.
+		{ 0.7, 65.0, 35.0, 0.6, 0.4 }, // longer and decreasing cross 0.
+		{ 0.0, 0.0, 0.0, 0.0, 0.0 }, // RGB8 gray.
+		{ 0.55, 40.0, 30.0, 0.7, 0.5 }
+	};
+
+	struct color stops[GRADIENT_STOPS], out[GRADIENT_SAMPLES], in_space[GRADIENT_SAMPLES];
+	double vals[GRADIENT_STOPS][3], period = space == COLOR_HSL ? 6.0 : 3.1415926535897932384626433833 * 2.0;
+	int hue = space == COLOR_HSL ? 0 : 2;
+	size_t i, k;
+	int j;
+
+	assert(err != NULL);
+	assert(space == COLOR_HSL || space == COLOR_LCHAB);
+
+	for(i = 0; i < GRADIENT_STOPS; ++i)
+	{
+		double v[3];
+
+		if(space == COLOR_HSL)
+		{
+			v[0] = stop_values[i][0] * period;
+			v[1] = stop_values[i][3];
+			v[2] = stop_values[i][4];
+		}
+		else
+		{
+			v[0] = stop_values[i][1];
+			v[1] = stop_values[i][2];
+			v[2] = stop_values[i][0] * period;
+		}
+
+		color_set_components(&stops[i], space, 0, v);
+	}
+
+	stops[6].type = COLOR_RGB8;
+	stops[6].extra = 0;
+	stops[6].RGB8.R = stops[6].RGB8.G = stops[6].RGB8.B = 128;
+
+	if(!color_gradient(out, COLOR_FORMAT_COLOR, GRADIENT_SAMPLES, stops, positions, GRADIENT_STOPS, space, mode, COLOR_RGB, 0) ||
+		!color_gradient(in_space, COLOR_FORMAT_COLOR, GRADIENT_SAMPLES, stops, positions, GRADIENT_STOPS, space, mode, space, 0))
+	{
+		return 0;
+	}
+
+	for(i = 0; i < GRADIENT_STOPS; ++i)
+	{
+		struct color c = stops[i];
+
+		color_convert(&c, space, 0);
+		color_extract_components(vals[i], &c);
+	}
+
+	memset(err, 0, sizeof *err);
+
+	for(k = 0; k < GRADIENT_SAMPLES; ++k)
+	{
+		struct color ref, ref_rgb;
+		double t = k * (1.0 / (GRADIENT_SAMPLES - 1)), f = 0.0, h0, h1, v[3], a[3], b[3], c[3];
+		size_t s = 0, next;
+		int gray0, gray1, mismatch;
+
+		// the last stop at or before t, and the one after it.
+		while(s + 1 < GRADIENT_STOPS && positions[s + 1] <= t) ++s;
+		next = s + 1 < GRADIENT_STOPS ? s + 1 : s;
+
+		if(positions[next] > positions[s])
+		{
+			f = (t - positions[s]) / (positions[next] - positions[s]);
+			f = f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+		}
+
+		h0 = vals[s][hue];
+		h1 = vals[next][hue];
+		gray0 = fabs(vals[s][1]) < 1e-6;
+		gray1 = fabs(vals[next][1]) < 1e-6;
+
+		if(gray0 && !gray1) h0 = h1;
+		if(gray1 && !gray0) h1 = h0;
+
+		gradient_hues(&h0, &h1, period, mode);
+
+		for(j = 0; j < 3; ++j)
+		{
+			v[j] = vals[s][j] + (vals[next][j] - vals[s][j]) * f;
+		}
+
+		v[hue] = fmod(h0 + (h1 - h0) * f, period);
+
+		color_set_components(&ref, space, 0, v);
+		ref_rgb = ref;
+		color_convert(&ref_rgb, COLOR_RGB, 0);
+
+		color_extract_components(a, &out[k]);
+		color_extract_components(b, &ref_rgb);
+		color_extract_components(c, &in_space[k]);
+
+		mismatch = out[k].type != COLOR_RGB || in_space[k].type != space || !(c[hue] >= 0.0 && c[hue] < period);
+
+		for(j = 0; j < 3; ++j)
+		{
+			double d = fabs(a[j] - b[j]), ds = fabs(c[j] - v[j]);
+
+			if(j == hue && ds > period * 0.5) ds = period - ds;
+			if(ds > d) d = ds;
+
+			if(!(d <= err->max[j])) err->max[j] = d;
+			err->mean[j] += d;
+			mismatch |= !(d <= 1e-9);
+		}
+
+		err->mismatches += mismatch;
+		++err->count;
+	}
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->mean[j] /= (double)err->count;
+	}
+
+	return 1;
+}
+
+// the per-edge counters of color_instrument_snapshot after a plan over INSTRUMENT_COLORS colors,
+// and after color_convert of one color, each from a reset. a plan counts one call per step and
+// chunk, color_convert one per step. when the library is built without COLOR_INSTRUMENT, every
+// counter must stay 0. mismatches counts edges whose calls or colors differ, or that sampled more
+// colors than they counted.
+
+#define INSTRUMENT_COLORS 1000
+#define INSTRUMENT_EDGES ((COLOR_DUMMY_END - 1) * (COLOR_DUMMY_END - 1))
+
+static void instrument_compare(struct check_error *err, struct color_edge_stats const *want)
+{
+	struct color_edge_stats got[INSTRUMENT_EDGES];
+	size_t i;
+
+	color_instrument_snapshot(got);
+
+	for(i = 0; i < INSTRUMENT_EDGES; ++i)
+	{
+		double d = fabs((double)got[i].calls - (double)want[i].calls);
+
+		if(d > err->max[0]) err->max[0] = d;
+		d = fabs((double)got[i].colors - (double)want[i].colors);
+		if(d > err->max[1]) err->max[1] = d;
+
+		err->mismatches += got[i].calls != want[i].calls || got[i].colors != want[i].colors || got[i].sampled_colors > got[i].colors;
+		++err->count;
+	}
+}
+
+static int check_instrument(struct check_error *err, enum color_type to)
+{
+	struct color_edge_stats want[INSTRUMENT_EDGES];
+	struct color_plan plan;
+	struct color *c;
+	int enabled = color_instrument_enabled();
+	size_t i;
+	unsigned s;
+
+	assert(err != NULL);
+
+	c = (struct color*)malloc(sizeof(struct color) * INSTRUMENT_COLORS);
+
+	if(!c)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < INSTRUMENT_COLORS; ++i)
+	{
+		c[i].type = COLOR_RGB8;
+		c[i].extra = 0;
+		c[i].RGB8.R = (uint8_t)i;
+		c[i].RGB8.G = (uint8_t)(i * 7);
+		c[i].RGB8.B = (uint8_t)(i * 13);
+	}
+
+	memset(err, 0, sizeof *err);
+
+	color_plan_init(&plan, COLOR_RGB8, 0, to, 0);
+	memset(want, 0, sizeof want);
+
+	for(s = 0; enabled && s < plan.count; ++s)
+	{
+		struct color_edge_stats *e = &want[(plan.route[s] - 1) * (COLOR_DUMMY_END - 1) + plan.route[s + 1] - 1];
+
+		e->calls += (INSTRUMENT_COLORS + COLOR_CHUNK - 1) / COLOR_CHUNK;
+		e->colors += INSTRUMENT_COLORS;
+	}
+
+	color_instrument_reset();
+	color_plan_execute(&plan, c, INSTRUMENT_COLORS);
+	instrument_compare(err, want);
+
+	// color_convert walks the router one step at a time.
+
+	memset(want, 0, sizeof want);
+
+	for(s = COLOR_RGB8; enabled && s != (unsigned)to; )
+	{
+		unsigned next = (unsigned)color_route_next((enum color_type)s, to);
+
+		++want[(s - 1) * (COLOR_DUMMY_END - 1) + next - 1].calls;
+		++want[(s - 1) * (COLOR_DUMMY_END - 1) + next - 1].colors;
+		s = next;
+	}
+
+	c[0].type = COLOR_RGB8;
+	c[0].extra = 0;
+
+	color_instrument_reset();
+	color_convert(&c[0], to, 0);
+	instrument_compare(err, want);
+
+	color_instrument_reset();
+
+	free(c);
+	return 1;
+}
+
+// color_convert_file onto its own source: by the same path, and through a symbolic link where
+// there are any. each must return 0 and leave the source as it was. onto a named pipe where there
+// are any, which can be opened but not sized: it must return 0 and leave the pipe in place, as a
+// destination it didn't create. then a conversion to a new file, which must hold what
+// color_plan_execute_packed gives. mismatches counts the cases that fail; max is unused.
+
+#define FILE_COLORS 4096
+#define FILE_SRC "check_file.tmp"
+#define FILE_LINK "check_file_link.tmp"
+#define FILE_DST "check_file_out.tmp"
+#define FILE_FIFO "check_file_fifo.tmp"
+
+static int file_equals(char const *path, void const *data, size_t size)
+{
+	FILE *f = fopen(path, "rb");
+	unsigned char buf[4096];
+	size_t done = 0, n;
+	int same = f != NULL;
+
+	while(same && (n = fread(buf, 1, sizeof buf, f)) != 0)
+	{
+		same = done + n <= size && !memcmp(buf, (unsigned char const*)data + done, n);
+		done += n;
+	}
+
+	if(f) fclose(f);
+	return same && done == size;
+}
+
+static int check_file(struct check_error *err)
+{
+	struct color_plan plan;
+	struct color_packed24 *src;
+	struct color_packedf *dst;
+	FILE *f;
+	size_t i;
+	int ok;
+
+	assert(err != NULL);
+
+	src = (struct color_packed24*)malloc(sizeof(struct color_packed24) * FILE_COLORS);
+	dst = (struct color_packedf*)malloc(sizeof(struct color_packedf) * FILE_COLORS);
+
+	if(!src || !dst)
+	{
+		free(src);
+		free(dst);
+		return 0;
+	}
+
+	for(i = 0; i < FILE_COLORS; ++i)
+	{
+		uint64_t r = splitmix64(i);
+
+		src[i].c[0] = (uint8_t)r;
+		src[i].c[1] = (uint8_t)(r >> 8);
+		src[i].c[2] = (uint8_t)(r >> 16);
+	}
+
+	color_plan_init(&plan, COLOR_RGB8, 0, COLOR_LAB, 0);
+	color_plan_execute_packed(&plan, dst, COLOR_FORMAT_FLOAT, src, COLOR_FORMAT_PACKED24, FILE_COLORS);
+
+	memset(err, 0, sizeof *err);
+
+	f = fopen(FILE_SRC, "wb");
+	ok = f && fwrite(src, sizeof(struct color_packed24), FILE_COLORS, f) == FILE_COLORS;
+	if(f) ok &= !fclose(f);
+
+	if(ok)
+	{
+		// onto itself, into a format that would grow the file.
+
+		ok = !color_convert_file(FILE_SRC, COLOR_FORMAT_FLOAT, FILE_SRC, COLOR_FORMAT_PACKED24, &plan) && file_equals(FILE_SRC, src, sizeof(struct color_packed24) * FILE_COLORS);
+		err->mismatches += !ok;
+		++err->count;
+
+#ifndef _WIN32
+		remove(FILE_LINK);
+
+		if(!symlink(FILE_SRC, FILE_LINK))
+		{
+			ok = !color_convert_file(FILE_LINK, COLOR_FORMAT_FLOAT, FILE_SRC, COLOR_FORMAT_PACKED24, &plan) && file_equals(FILE_SRC, src, sizeof(struct color_packed24) * FILE_COLORS);
+			err->mismatches += !ok;
+			++err->count;
+
+			remove(FILE_LINK);
+		}
+
+		remove(FILE_FIFO);
+
+		if(!mkfifo(FILE_FIFO, 0666))
+		{
+			struct stat st;
+
+			ok = !color_convert_file(FILE_FIFO, COLOR_FORMAT_FLOAT, FILE_SRC, COLOR_FORMAT_PACKED24, &plan) && !stat(FILE_FIFO, &st) && S_ISFIFO(st.st_mode);
+			err->mismatches += !ok;
+			++err->count;
+
+			remove(FILE_FIFO);
+		}
+#endif
+
+		remove(FILE_DST);
+
+		ok = color_convert_file(FILE_DST, COLOR_FORMAT_FLOAT, FILE_SRC, COLOR_FORMAT_PACKED24, &plan) && file_equals(FILE_DST, dst, sizeof(struct color_packedf) * FILE_COLORS);
+		err->mismatches += !ok;
+		++err->count;
+
+		remove(FILE_DST);
+	}
+	else
+	{
+		fprintf(stderr, "can't write %s.\n", FILE_SRC);
+		err->mismatches = err->count = 1;
+	}
+
+	remove(FILE_SRC);
+
+	free(src);
+	free(dst);
+	return 1;
+}
+
+// dithers samples flat fills, evenly spaced between the two palette entries in linear light, to
+// those entries. it gives the error of the mean output in linear RGB; mismatches counts fills whose
+// mean index is off by more than 1/64. each fill is 64x64 pixels, a whole number of tiles for both
+// threshold maps.
+
+#define DITHER_FILL 64
+
+static int check_dither(struct check_error *err, struct color const *palette, enum color_dither method, size_t samples)
+{
+	struct color_image img;
+	struct check_accum acc;
+	double pal[2][3];
+	uint8_t *indices;
+	size_t k, i;
+	int j;
+
+	assert(err != NULL);
+	assert(palette != NULL);
+
+	img.width = DITHER_FILL;
+	img.height = DITHER_FILL;
+	img.stride = DITHER_FILL;
+	img.pixels = (struct color*)malloc(sizeof(struct color) * DITHER_FILL * DITHER_FILL);
+	indices = (uint8_t*)malloc(DITHER_FILL * DITHER_FILL);
+
+	if(!img.pixels || !indices)
+	{
+		free(img.pixels);
+		free(indices);
+		return 0;
+	}
+
+	for(k = 0; k < 2; ++k)
+	{
+		struct color c = palette[k];
+
+		color_convert(&c, COLOR_LINEAR_RGB, 0);
+		color_extract_components(pal[k], &c);
+	}
+
+	memset(&acc, 0, sizeof acc);
+
+	for(k = 0; k < samples; ++k)
+	{
+		double f = (k + 0.5) / (double)samples, v[3];
+		size_t ones = 0;
+		int mismatch;
+
+		for(j = 0; j < 3; ++j)
+		{
+			v[j] = (pal[1][j] - pal[0][j]) * f + pal[0][j];
+		}
+
+		for(i = 0; i < DITHER_FILL * DITHER_FILL; ++i)
+		{
+			color_set_components(&img.pixels[i], COLOR_LINEAR_RGB, 0, v);
+		}
+
+		if(!color_dither_palette(indices, &img, palette, 2, method))
+		{
+			free(img.pixels);
+			free(indices);
+			return 0;
+		}
+
+		for(i = 0; i < DITHER_FILL * DITHER_FILL; ++i)
+		{
+			ones += indices[i];
+		}
+
+		// the mean light output against the fill, which is the error in the mean index
+		// fraction scaled by each channel's distance between the entries.
+
+		for(j = 0; j < 3; ++j)
+		{
+			double d = fabs((pal[1][j] - pal[0][j]) * ((double)ones / (DITHER_FILL * DITHER_FILL)) + pal[0][j] - v[j]);
+
+			if(d > acc.max[j]) acc.max[j] = d;
+			acc.sum[j] += d;
+		}
+
+		mismatch = fabs((double)ones / (DITHER_FILL * DITHER_FILL) - f) > 1.0 / 64.0;
+		acc.mismatches += mismatch;
+		++acc.count;
+	}
+
+	free(img.pixels);
+	free(indices);
+
+	err->count = acc.count;
+	err->mismatches = acc.mismatches;
+
+	for(j = 0; j < 3; ++j)
+	{
+		err->max[j] = acc.max[j];
+		err->mean[j] = acc.count ? acc.sum[j] / (double)acc.count : 0.0;
+	}
+
+	return 1;
+}
+
+// prints one result, and on stderr also when failed is set. from is COLOR_NONE for mixed types.
+
+static void print_error(char const *kind, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra, struct check_error const *err, int failed, int *first)
+{
+	int j;
+
+	printf("%s\t\t{ \"check\": \"%s\", \"from\": \"%s\", \"from_extra\": %u, \"to\": \"%s\", \"to_extra\": %u, \"count\": %.0f, \"mismatches\": %.0f",
+		*first ? "" : ",\n", kind, from ? color_name(from) : "mixed", from_extra, color_name(to), to_extra, (double)err->count, (double)err->mismatches);
+
+	// JSON has no infinity; report it as null.
+
+	printf(", \"max\": [");
+	for(j = 0; j < 3; ++j) printf(err->max[j] <= 1e308 ? "%s%.6g" : "%snull", j ? ", " : "", err->max[j]);
+	printf("], \"mean\": [");
+	for(j = 0; j < 3; ++j) printf(err->mean[j] <= 1e308 ? "%s%.6g" : "%snull", j ? ", " : "", err->mean[j]);
+	printf("] }");
+	fflush(stdout);
+
+	if(failed)
+	{
+		fprintf(stderr, "%s %s (%u) -> %s (%u): %.0f of %.0f differ, max [%.6g, %.6g, %.6g] over the bound\n", kind, from ? color_name(from) : "mixed", from_extra, color_name(to), to_extra,
+			(double)err->mismatches, (double)err->count, err->max[0], err->max[1], err->max[2]);
+	}
+
+	*first = 0;
+}
+
+static int max_exceeds(struct check_error const *err, double bound)
+{
+	return err->max[0] > bound || err->max[1] > bound || err->max[2] > bound;
+}
+
+// whether the plan from -> to has a polar batch kernel: 1 when that kernel is the only step, 2 when
+// there are others.
+
+static int polar_steps(enum color_type from, enum color_type to)
+{
+	struct color_plan plan;
+	unsigned s;
+
+	color_plan_init(&plan, from, 0, to, 0);
+
+	for(s = 0; s < plan.count; ++s)
+	{
+		if(plan.batch[s] && is_polar((enum color_type)plan.route[s]) != is_polar((enum color_type)plan.route[s + 1]))
+		{
+			return plan.count == 1 ? 1 : 2;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t const ycbcr_extras[] =
+	{
+		COLOR_YUV_MAT_REC601, COLOR_YUV_MAT_REC709, COLOR_YUV_MAT_SMPTE240M, COLOR_YUV_MAT_FCC,
+		COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE, COLOR_YUV_MAT_REC709 | COLOR_YCBCR_FULL_RANGE,
+		COLOR_YUV_MAT_SMPTE240M | COLOR_YCBCR_FULL_RANGE, COLOR_YUV_MAT_FCC | COLOR_YCBCR_FULL_RANGE
+	};
+
+	// every type, with each YUV matrix and each YCbCr matrix and range.
+	static struct { enum color_type type; uint8_t extra; } const endpoints[] =
+	{
+		{ COLOR_RGB8, 0 }, { COLOR_RGB, 0 }, { COLOR_LINEAR_RGB, 0 }, { COLOR_HSL, 0 }, { COLOR_HSV, 0 },
+		{ COLOR_YUV, COLOR_YUV_MAT_REC601 }, { COLOR_YUV, COLOR_YUV_MAT_REC709 }, { COLOR_YUV, COLOR_YUV_MAT_SMPTE240M }, { COLOR_YUV, COLOR_YUV_MAT_FCC },
+		{ COLOR_YCBCR, COLOR_YUV_MAT_REC601 }, { COLOR_YCBCR, COLOR_YUV_MAT_REC709 }, { COLOR_YCBCR, COLOR_YUV_MAT_SMPTE240M }, { COLOR_YCBCR, COLOR_YUV_MAT_FCC },
+		{ COLOR_YCBCR, COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE }, { COLOR_YCBCR, COLOR_YUV_MAT_REC709 | COLOR_YCBCR_FULL_RANGE },
+		{ COLOR_YCBCR, COLOR_YUV_MAT_SMPTE240M | COLOR_YCBCR_FULL_RANGE }, { COLOR_YCBCR, COLOR_YUV_MAT_FCC | COLOR_YCBCR_FULL_RANGE },
+		{ COLOR_YDBDR, 0 }, { COLOR_YIQ, 0 }, { COLOR_XYZ, 0 }, { COLOR_XYY, 0 }, { COLOR_LAB, 0 },
+		{ COLOR_LUV, 0 }, { COLOR_LCHAB, 0 }, { COLOR_LCHUV, 0 }, { COLOR_LSHUV, 0 }
+	};
+
+	struct check_error err;
+	size_t samples = 1000000;
+	unsigned i;
+	int from, to, failed, failures = 0, first = 1;
+
+	if(argc > 1) samples = (size_t)strtoul(argv[1], NULL, 10);
+
+	if(!samples)
+	{
+		fprintf(stderr, "usage: %s [random samples per pair]\n", argv[0]);
+		return 1;
+	}
+
+	printf("{\n\t\"samples\": %u,\n\t\"results\":\n\t[\n", (unsigned)samples);
+
+	for(to = COLOR_RGB; to < COLOR_DUMMY_END; ++to)
+	{
+		if(to == COLOR_YCBCR) continue;
+		if(!check_round_trip(&err, COLOR_RGB8, 0, (enum color_type)to, 0, SWEEP_RGB8_CUBE, 0)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error("round_trip", COLOR_RGB8, 0, (enum color_type)to, 0, &err, failed, &first);
+	}
+
+	// 8-bit YCbCr can't hold every RGB8 color; within two codes.
+
+	for(i = 0; i < sizeof ycbcr_extras / sizeof ycbcr_extras[0]; ++i)
+	{
+		if(!check_round_trip(&err, COLOR_RGB8, 0, COLOR_YCBCR, ycbcr_extras[i], SWEEP_RGB8_CUBE, 0)) goto nomem;
+
+		failed = max_exceeds(&err, 2.0);
+		failures += failed;
+		print_error("round_trip", COLOR_RGB8, 0, COLOR_YCBCR, ycbcr_extras[i], &err, failed, &first);
+	}
+
+	// storage error of each type's nominal range, as packed floats and halves.
+
+	for(from = COLOR_RGB; from < COLOR_DUMMY_END; ++from)
+	{
+		if(from == COLOR_YCBCR) continue;
+		if(!check_format(&err, (enum color_type)from, 0, COLOR_FORMAT_FLOAT, SWEEP_RANDOM, samples)) goto nomem;
+		print_error("float", (enum color_type)from, 0, (enum color_type)from, 0, &err, 0, &first);
+		if(!check_format(&err, (enum color_type)from, 0, COLOR_FORMAT_HALF, SWEEP_RANDOM, samples)) goto nomem;
+		print_error("half", (enum color_type)from, 0, (enum color_type)from, 0, &err, 0, &first);
+	}
+
+	if(!check_format(&err, COLOR_LAB, 0, COLOR_FORMAT_LAB16, SWEEP_RANDOM, samples)) goto nomem;
+	print_error("lab16", COLOR_LAB, 0, COLOR_LAB, 0, &err, 0, &first);
+
+	// fixed-point matrix and range changes between 8-bit YCbCr, over every code. within one code.
+
+	for(i = 0; i < sizeof ycbcr_extras / sizeof ycbcr_extras[0]; ++i)
+	{
+		unsigned j;
+
+		for(j = 0; j < sizeof ycbcr_extras / sizeof ycbcr_extras[0]; ++j)
+		{
+			if(i == j) continue;
+			if(!check_ycbcr(&err, ycbcr_extras[i], ycbcr_extras[j], SWEEP_CODES, 0)) goto nomem;
+
+			failed = max_exceeds(&err, 1.0);
+			failures += failed;
+			print_error("ycbcr_fixed", COLOR_YCBCR, ycbcr_extras[i], COLOR_YCBCR, ycbcr_extras[j], &err, failed, &first);
+		}
+	}
+
+	// 8-bit HSV and Lab in integers, both ways, over every code. within one code.
+
+	for(i = 0; i < 4; ++i)
+	{
+		enum color_type type = i & 1 ? COLOR_LAB : COLOR_HSV;
+
+		if(!check_code8(&err, type, i >= 2, SWEEP_CODES, 0)) goto nomem;
+
+		failed = max_exceeds(&err, 1.0);
+		failures += failed;
+		print_error("code8", i >= 2 ? type : COLOR_RGB8, 0, i >= 2 ? COLOR_RGB8 : type, 0, &err, failed, &first);
+	}
+
+	// Y' in each matrix, Y and L of RGB8 colors, over every code. exactly color_convert's.
+
+	for(i = 0; i < 6; ++i)
+	{
+		enum color_type type = i < 4 ? COLOR_YUV : i == 4 ? COLOR_XYZ : COLOR_LAB;
+		uint8_t extra = i < 4 ? (uint8_t)i : 0;
+
+		if(!check_luma(&err, type, extra, SWEEP_CODES, 0)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error("luma", COLOR_RGB8, 0, type, extra, &err, failed, &first);
+	}
+
+	// mean output of palette dithering between two gray and two chromatic entries. every fill's
+	// mean index within 1/64.
+
+	for(i = 0; i < 6; ++i)
+	{
+		static char const *const names[] =
+		{
+			"dither_ordered_gray", "dither_ordered_chromatic", "dither_blue_noise_gray", "dither_blue_noise_chromatic",
+			"dither_floyd_steinberg_gray", "dither_floyd_steinberg_chromatic"
+		};
+		struct color pal[2];
+
+		memset(pal, 0, sizeof pal);
+		pal[0].type = pal[1].type = COLOR_RGB;
+
+		if(i & 1)
+		{
+			pal[0].RGB.R = 1.0;
+			pal[1].RGB.B = 1.0;
+		}
+		else
+		{
+			pal[1].RGB.R = pal[1].RGB.G = pal[1].RGB.B = 1.0;
+		}
+
+		if(!check_dither(&err, pal, (enum color_dither)(i >> 1), 256)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error(names[i], COLOR_RGB, 0, COLOR_RGB, 0, &err, failed, &first);
+	}
+
+	// arrays mixing types, and all of one type, against a plan per color. exactly.
+
+	for(to = COLOR_RGB8; to < COLOR_DUMMY_END; ++to)
+	{
+		uint8_t to_extra = to == COLOR_YCBCR ? COLOR_YUV_MAT_REC709 : 0;
+
+		if(!check_mixed(&err, 1, (enum color_type)to, to_extra, samples)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error("mixed", COLOR_NONE, 0, (enum color_type)to, to_extra, &err, failed, &first);
+
+		if(!check_mixed(&err, 0, (enum color_type)to, to_extra, samples)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error("mixed", COLOR_YCBCR, COLOR_YUV_MAT_REC601 | COLOR_YCBCR_FULL_RANGE, (enum color_type)to, to_extra, &err, failed, &first);
+	}
+
+	// masked regions of each density and overlapping rectangles, to a type with a batch kernel and
+	// through a polar kernel. exactly as one pixel at a time.
+
+	for(i = 0; i < 8; ++i)
+	{
+		static char const *const names[] = { "masked_none", "masked_partial", "masked_all", "rects" };
+		enum color_type type = i & 1 ? COLOR_LCHAB : COLOR_LINEAR_RGB;
+
+		if(!check_region(&err, i >> 1 == 3, (int)(i >> 1), type)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error(names[i >> 1], COLOR_RGB8, 0, type, 0, &err, failed, &first);
+	}
+
+	// image statistics: a large image, one with NaN, and empty ones.
+
+	for(i = 0; i < 4; ++i)
+	{
+		static char const *const names[] = { "stats", "stats_nan", "stats_empty", "stats_empty" };
+		static size_t const sizes[][2] = { { 301, 211 }, { 263, 97 }, { 0, 0 }, { 5, 0 } };
+		enum color_type type = i == 1 ? COLOR_RGB : COLOR_RGB8, to = i == 1 ? COLOR_LINEAR_RGB : COLOR_LAB;
+
+		if(!check_stats(&err, type, to, sizes[i][0], sizes[i][1])) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error(names[i], type, 0, to, 0, &err, failed, &first);
+	}
+
+	// quantization: palette sizes off a multiple of 4, early exit on the threshold, and an image
+	// with fewer colors than asked for.
+
+	for(i = 0; i < 5; ++i)
+	{
+		static struct { enum color_type space; unsigned colors, distinct, iterations; double threshold; } const cases[] =
+		{
+			{ COLOR_LAB, 13, 0, 8, 0.0 },
+			{ COLOR_LINEAR_RGB, 16, 0, 8, 0.0 },
+			{ COLOR_LAB, 255, 0, 3, 0.0 },
+			{ COLOR_LAB, 7, 0, 50, 0.5 },
+			{ COLOR_LINEAR_RGB, 32, 5, 8, 0.0 }
+		};
+
+		if(!check_quantize(&err, cases[i].space, cases[i].colors, cases[i].distinct, cases[i].iterations, cases[i].threshold)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error("quantize", COLOR_RGB8, 0, cases[i].space, 0, &err, failed, &first);
+	}
+
+	// resampling at non-integer ratios, within one code of the double-precision reference, one
+	// output large enough to run in parallel; blending with alpha 0 and 255 exactly.
+
+	for(i = 0; i < 6; ++i)
+	{
+		static char const *const names[] = { "resample_box", "resample_bilinear", "resample_lanczos3" };
+
+		if(!check_resample(&err, (enum color_filter)(i % 3), i < 3 ? 151 : 97, i < 3 ? 113 : 71)) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error(names[i % 3], COLOR_RGB8, 0, COLOR_RGB8, 0, &err, failed, &first);
+	}
+
+	if(!check_blend(&err)) goto nomem;
+
+	failed = err.mismatches != 0;
+	failures += failed;
+	print_error("blend", COLOR_RGB8, 0, COLOR_RGB8, 0, &err, failed, &first);
+
+	// gradients in each hue mode, in a polar space and in HSL.
+
+	for(i = 0; i < 8; ++i)
+	{
+		static char const *const names[] = { "gradient_shorter", "gradient_longer", "gradient_increasing", "gradient_decreasing" };
+		enum color_type space = i < 4 ? COLOR_LCHAB : COLOR_HSL;
+
+		if(!check_gradient(&err, space, (enum color_hue_mode)(i % 4))) goto nomem;
+
+		failed = err.mismatches != 0;
+		failures += failed;
+		print_error(names[i % 4], space, 0, COLOR_RGB, 0, &err, failed, &first);
+	}
+
+	// instrumentation counters, exact when the library counts and 0 when it does not.
+
+	if(!check_instrument(&err, COLOR_LCHUV)) goto nomem;
+
+	failed = err.mismatches != 0;
+	failures += failed;
+	print_error("instrument", COLOR_RGB8, 0, COLOR_LCHUV, 0, &err, failed, &first);
+
+	// file conversion refuses its own source, and otherwise writes what the plan gives.
+
+	if(!check_file(&err)) goto nomem;
+
+	failed = err.mismatches != 0;
+	failures += failed;
+	print_error("file", COLOR_RGB8, 0, COLOR_LAB, 0, &err, failed, &first);
+
+	// every plan exactly, and the polar kernels on their own within 1e-12. routes with more steps
+	// around a polar kernel amplify its difference, and are reported only.
+
+	for(from = COLOR_RGB8; from < COLOR_DUMMY_END; ++from)
+	{
+		for(to = COLOR_RGB8; to < COLOR_DUMMY_END; ++to)
+		{
+			int polar;
+
+			if(from == to) continue;
+
+			polar = polar_steps((enum color_type)from, (enum color_type)to);
+
+			if(polar == 1)
+			{
+				if(!check_polar(&err, (enum color_type)from, (enum color_type)to, samples)) goto nomem;
+
+				// towards the polar type, C is the same sqrt and only the hue differs.
+				failed = err.max[0] != 0.0 || (is_polar((enum color_type)to) ? err.max[1] != 0.0 : err.max[1] > 1e-12) || err.max[2] > 1e-12;
+				failures += failed;
+				print_error("polar", (enum color_type)from, 0, (enum color_type)to, 0, &err, failed, &first);
+				continue;
+			}
+
+			if(!check_plan(&err, (enum color_type)from, 0, (enum color_type)to, 0, SWEEP_RANDOM, samples)) goto nomem;
+
+			failed = polar != 2 && err.mismatches != 0;
+			failures += failed;
+			print_error("plan", (enum color_type)from, 0, (enum color_type)to, 0, &err, failed, &first);
+		}
+	}
+
+	// color.hpp derives its constants rather than sharing color.c's; every pair of types and
+	// extras, exactly.
+
+	for(from = 0; from < (int)(sizeof endpoints / sizeof *endpoints); ++from)
+	{
+		for(to = 0; to < (int)(sizeof endpoints / sizeof *endpoints); ++to)
+		{
+			if(from == to) continue;
+			if(!check_hpp(&err, endpoints[from].type, endpoints[from].extra, endpoints[to].type, endpoints[to].extra, samples)) goto nomem;
+
+			failed = err.mismatches != 0;
+			failures += failed;
+			print_error("hpp", endpoints[from].type, endpoints[from].extra, endpoints[to].type, endpoints[to].extra, &err, failed, &first);
+		}
+	}
+
+	printf("\n\t]\n}\n");
+
+	if(failures)
+	{
+		fprintf(stderr, "%d checks over their bound.\n", failures);
+		return 1;
+	}
+
+	return 0;
+
+nomem:
+	fprintf(stderr, "out of memory.\n");
+	return 1;
+}
@@ -0,0 +1,119 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	The C++ half of check: colors::convert for every pair of types and extras,
+	picked at run time, so check.c can compare it against color_convert.
+	Build it with check.c as C++17; it needs color.hpp.
+*/
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include "color.hpp"
+
+namespace
+{
+
+// every type, with each YUV matrix and each YCbCr matrix and range as its own endpoint.
+
+constexpr int ENDPOINTS = (COLOR_LSHUV - COLOR_RGB8 + 1) - 2 + 4 + 8;
+
+constexpr color_type endpoint_type(int i)
+{
+	return i < COLOR_YUV - COLOR_RGB8 ? (color_type)(COLOR_RGB8 + i) :
+		i < COLOR_YUV - COLOR_RGB8 + 4 ? COLOR_YUV :
+		i < COLOR_YUV - COLOR_RGB8 + 12 ? COLOR_YCBCR :
+		(color_type)(COLOR_YDBDR + i - (COLOR_YUV - COLOR_RGB8 + 12));
+}
+
+constexpr uint8_t endpoint_extra(int i)
+{
+	return (uint8_t)(endpoint_type(i) == COLOR_YUV ? i - (COLOR_YUV - COLOR_RGB8) : endpoint_type(i) == COLOR_YCBCR ? i - (COLOR_YUV - COLOR_RGB8 + 4) : 0);
+}
+
+typedef int (*convert_fn)(struct color *dst, struct color const *src, size_t count);
+
+template<int From, int To>
+int convert_all(struct color *dst, struct color const *src, size_t count)
+{
+	constexpr color_type from = endpoint_type(From), to = endpoint_type(To);
+	constexpr uint8_t from_extra = endpoint_extra(From), to_extra = endpoint_extra(To);
+
+	typedef typename colors::detail::by_type<from>::type from_color;
+	typedef typename colors::detail::by_type<to>::type to_color;
+
+	if constexpr(colors::detail::path<from, from_extra, to, to_extra>::value.count >= 0)
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			dst[i] = colors::to_c<to_color, to_extra>(colors::convert<from_color, to_color, from_extra, to_extra>(colors::from_c<from_color>(src[i])));
+		}
+
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+template<std::size_t... I>
+constexpr auto make_table(std::index_sequence<I...>)
+{
+	return std::array<convert_fn, sizeof...(I)>{ { &convert_all<(int)I / ENDPOINTS, (int)I % ENDPOINTS>... } };
+}
+
+constexpr auto table = make_table(std::make_index_sequence<ENDPOINTS * ENDPOINTS>());
+
+int endpoint(enum color_type type, uint8_t extra)
+{
+	for(int i = 0; i < ENDPOINTS; ++i)
+	{
+		if(endpoint_type(i) == type && endpoint_extra(i) == extra)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+}
+
+// converts count colors of one type and extra to another with colors::convert. returns 0 when
+// either is not an endpoint, or when colors::convert has no route between them.
+
+extern "C" int check_hpp_convert(struct color *dst, enum color_type to, uint8_t to_extra, struct color const *src, size_t count)
+{
+	int from_index = count ? endpoint((enum color_type)src[0].type, src[0].extra) : -1;
+	int to_index = endpoint(to, to_extra);
+
+	if(from_index < 0 || to_index < 0)
+	{
+		return 0;
+	}
+
+	return table[from_index * ENDPOINTS + to_index](dst, src, count);
+}
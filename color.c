@@ -39,7 +39,8 @@
 #include <math.h>
 #include <assert.h>
 #include <stddef.h>
-#include "color.h"
+#include <string.h>
+#include "color_internal.h"
 
 static double const COLOR_REF_X = 31271.0/32902.0;
 static double const COLOR_REF_Xr = 32902.0/31271.0;
@@ -53,7 +54,7 @@ static double const COLOR_REF_Zr = 32902.0/35827.0;
 static double const COLOR_REF_U13 = 813046.0/316141.0; // X * 4 / (X + Y * 15 + Z * 3) * 13
 static double const COLOR_REF_V13 = 1924767.0/316141.0; // Y * 9 / (X + Y * 15 + Z * 3) * 13
 
-__declspec(align(64)) double const rgb_to_yuv[][8] =
+COLOR_ALIGN(64) double const rgb_to_yuv[][8] =
 {
 	// Rec. 601
 	{ 0.299, 0.587, 0.114, -32591.0/221500.0, -63983.0/221500.0, -72201.0/140200.0, -7011.0/70100.0 },
@@ -65,7 +66,7 @@ __declspec(align(64)) double const rgb_to_yuv[][8] =
 	{ 0.3, 0.59, 0.11, -327.0/2225.0, -6431.0/22250.0, -7257.0/14000.0, -1353.0/14000.0 }
 };
 
-__declspec(align(32)) double const yuv_to_rgb[][4] =
+COLOR_ALIGN(32) double const yuv_to_rgb[][4] =
 {
 	// Rec. 601
 	{ 701.0/615.0, -25251.0/63983.0, -209599.0/361005.0, 443.0/218.0 },
@@ -105,9 +106,84 @@ static void color_RGB8_to_RGB(struct color *c, uint8_t extra)
 	c->type = COLOR_RGB;
 }
 
+// rgb8_to_linear for every 8-bit value: pow(c * (40.0 / 10761.0) + (11.0 / 211.0), 2.4) correctly
+// rounded, with the base and exponent as the doubles that expression evaluates to. this is a
+// deliberate normalization across platforms: it equals pow only where pow is correctly rounded, as
+// glibc's is. against a pow that isn't, such as MSVC's, the table changes color_convert's results
+// in the last bit, and makes them the same everywhere.
+
+COLOR_ALIGN(64) double const color_rgb8_linear_tbl[256] =
+{
+	0.0, 3.0352698354883751513319523063e-4, 6.0705396709767503026639046126e-4, 9.1058095064651249118947706762e-4,
+	1.2141079341953500605327809225e-3, 1.5176349177441876298760847774e-3, 1.8211619012930249823789541352e-3, 2.1246888848418625517222579901e-3,
+	2.4282158683907001210655618451e-3, 2.7317428519395376904088657000e-3, 3.0352698354883752597521695549e-3, 3.3465357638991583502822994244e-3,
+	3.6765073240474346295945200142e-3, 4.0247170184963037920812879613e-3, 4.3914420374102935416505559911e-3, 4.7769534806937276561346490564e-3,
+	5.1815167023383855442507985596e-3, 5.6053916242027209949860404582e-3, 6.0488330228570526041492409185e-3, 6.5120907925944713067733278301e-3,
+	6.9954101872653869591244210001e-3, 7.4990320432261712449767154128e-3, 8.0231929853849943864793585016e-3, 8.5681256180693027507816525276e-3,
+	9.1340587022207866789567128918e-3, 9.7212173202378438798790249082e-3, 1.0329823029626937019100175943e-2, 1.0960094006488240610969262700e-2,
+	1.1612245179743880804033916789e-2, 1.2286488356915866060504536588e-2, 1.2983032342173006632657139651e-2, 1.3702083047289681432022494602e-2,
+	1.4443843596092538734875523394e-2, 1.5208514422912702888708838366e-2, 1.5996293365509624989577828628e-2, 1.6807375752887372967989958869e-2,
+	1.7641954488384072854353188411e-2, 1.8500220128379683854179182732e-2, 1.9382360956935717387960759791e-2, 2.0288563056652385198172219899e-2,
+	2.1219010376003548790205062899e-2, 2.2173884793387383176551667254e-2, 2.3153366178110411637303622526e-2, 2.4157632448504755245730794209e-2,
+	2.5186859627361628922748834321e-2, 2.6241221894849896411236788304e-2, 2.7320891639074895123018214046e-2, 2.8426039504420793581966749055e-2,
+	2.9556834437808801921967260868e-2, 3.0713443732993626158426825437e-2, 3.1896033073011519865403765397e-2, 3.3104766570885049368264083729e-2,
+	3.4339806808682168520500895632e-2, 3.5601314875020324044902449999e-2, 3.6889450401100018071253434015e-2, 3.8204371595346483935597819264e-2,
+	3.9546235276732833899476709293e-2, 4.0915196906853168133592954380e-2, 4.2311410620809652894171442665e-2, 4.3735029256973446392121937058e-2,
+	4.5186204385675541280512599737e-2, 4.6665086336880074162641317745e-2, 4.8171824226889399195462284053e-2, 4.9706565984127211485521053163e-2,
+	5.1269458374043215616805563907e-2, 5.2860647023180246439991743153e-2, 5.4480276442442346150358701344e-2, 5.6128490049600068280327360480e-2,
+	5.7805430191067201583601610531e-2, 5.9511238162981172246752693693e-2, 6.1246054231617579954019745445e-2, 6.3010017653167641622507766544e-2,
+	6.4803266692905746628585157291e-2, 6.6625938643772860418369285583e-2, 6.8478169844400141653244184954e-2, 7.0360095696595854289135825948e-2,
+	7.2271850682317453648943196732e-2, 7.4213568380149598604006020143e-2, 7.6185381481307784922139605707e-2, 7.8187421805186302614673012090e-2,
+	8.0219820314468288087164140462e-2, 8.2282707129814796844969628910e-2, 8.4376211544148781651766732854e-2, 8.6500462036549734387774719406e-2,
+	8.8655586285772939944152597599e-2, 9.0841711183407679080073276652e-2, 9.3058962846687423005920947814e-2, 9.5307466630964664299480791972e-2,
+	9.7587347141862419724088721367e-2, 9.9898728247113894034840163134e-2, 1.0224173308810127728927043282e-1, 1.0461648409110415961127861825e-1,
+	1.0702310297826758501959295825e-1, 1.0946171077829932818077303674e-1, 1.1193242783690556325515466920e-1, 1.1443537382697370095392580716e-1,
+	1.1697066775851079719786599028e-1, 1.1953842798834558313607744911e-1, 1.2213877222960183060372248168e-1, 1.2477181756095044830681563949e-1,
+	1.2743768043564740112699929479e-1, 1.3013647669036425701402999034e-1, 1.3286832155381789211405815305e-1, 1.3563332965520562426030574431e-1,
+	1.3843161503245179697480565344e-1, 1.4126329114027159998972538575e-1, 1.4412847085805768733405572246e-1, 1.4702726649759493962777178900e-1,
+	1.4995978981060851280170057683e-1, 1.5292615199615012047427920365e-1, 1.5592646370782731115692640576e-1, 1.5896083506088032385002750808e-1,
+	1.6202937563911098206384054854e-1, 1.6513219450166760221595992480e-1, 1.6826940018969070213634192403e-1, 1.7144110073282254222718853752e-1,
+	1.7464740365558499284582181215e-1, 1.7788841598362912601168223010e-1, 1.8116424424986011941518256093e-1, 1.8447499450044089104263936224e-1,
+	1.8782077230067776389004634789e-1, 1.9120168274079139714217653947e-1, 1.9461783044157570506717590016e-1, 1.9806931955994885318204760594e-1,
+	2.0155625379439706431809936955e-1, 2.0507873639031692723455898083e-1, 2.0863687014525564171409064753e-1, 2.1223075741405512746891859723e-1,
+	2.1586050011389913958144434748e-1, 2.1952619972926921911078036227e-1, 2.2322795731680839318179725446e-1, 2.2696587351009836774823165805e-1,
+	2.3074004852434891082293380729e-1, 2.3455058216100509602692833955e-1, 2.3839757381227089852042213615e-1, 2.4228112246555475088783256848e-1,
+	2.4620132670783535512401349703e-1, 2.5015828472995330613899103044e-1, 2.5415209433082663594493978016e-1, 2.5818285292159579106994192971e-1,
+	2.6225065752969597351699861665e-1, 2.6635560480286232346154034473e-1, 2.7049779101306570258205569691e-1, 2.7467731206038452970007043200e-1,
+	2.7889426347681026297399449751e-1, 2.8314874042999196101854773299e-1, 2.8744083772691735873195129020e-1, 2.9177064981753587754720964931e-1,
+	2.9613827079832085308427183751e-1, 3.0054379441577639340206299820e-1, 3.0498731406988600319722626055e-1, 3.0946892281750838630503620114e-1,
+	3.1398871337571741895758630970e-1, 3.1854677812509171056275738086e-1, 3.2314320911295060590801862624e-1, 3.2777809805654205482771237569e-1,
+	3.3245153634617906866568263917e-1, 3.3716361504833020336362473410e-1, 3.4191442490866065758398251257e-1, 3.4670405635502944368615456474e-1,
+	3.5153259950043909239020898439e-1, 3.5640014414594337083957630099e-1, 3.6130677978350949753102738711e-1, 3.6625259559883932940831373074e-1,
+	3.7123768047414897508954252825e-1, 3.7626212299090617230245949144e-1, 3.8132601143252996575340564127e-1, 3.8642943378704886716337551094e-1,
+	3.9157247774972308089035684306e-1, 3.9675523072562671648713515651e-1, 4.0197777983219560807315788630e-1, 4.0724021190173654838467422565e-1,
+	4.1254261348390359652456128803e-1, 4.1788507084813715572095105125e-1, 4.2326766998607152177534034920e-1, 4.2869049661390648872825538651e-1,
+	4.3415363617474875644514148389e-1, 4.3965717384091861850028391473e-1, 4.4520119451622772130442370049e-1, 4.5078578283822326620251258420e-1,
+	4.5641102318040449382052055102e-1, 4.6207699965440671711380929730e-1, 4.6778379611215879269874702212e-1, 4.7353149614800919291159557749e-1,
+	4.7932018310082662033701427139e-1, 4.8514994005607022440386412062e-1, 4.9102084984783541570598209983e-1, 4.9693299506087023586600953791e-1,
+	5.0288645803256833417432130320e-1, 5.0888132085493340802015318626e-1, 5.1491766537652121549180237083e-1, 5.2099557320435391725913278903e-1,
+	5.2711512570581291474836024435e-1, 5.3327640401050502728781044131e-1, 5.3947948901210694274645336316e-1, 5.4572446137018656611559596802e-1,
+	5.5201140151199978176030824749e-1, 5.5834038963426767387140517552e-1, 5.6471150570492880074817906999e-1, 5.7112482946487290580411329413e-1,
+	5.7758044042965038204740576963e-1, 5.8407841789116393738909940990e-1, 5.9061884091933668135269233038e-1, 5.9720178836376314612828842553e-1,
+	6.0382733885533736686275383115e-1, 6.1049557080786460079750125062e-1, 6.1720656241965071491227150748e-1, 6.2396039167507588938543452414e-1,
+	6.3075713634614657170241201856e-1, 6.3759687399403239740720059814e-1, 6.4447968197058191786818135868e-1, 6.5140563741982392068135998431e-1,
+	6.5837481727944808895095410413e-1, 6.6538729828227185560321280724e-1, 6.7244315695768710513662225333e-1, 6.7954246963309365036507720603e-1,
+	6.8668531243531304298264679063e-1, 6.9387176129198971774086765485e-1, 7.0110189193297293572482914539e-1, 7.0837577989168659955485539929e-1,
+	7.1569350050648031286180379041e-1, 7.2305512892196883067003365180e-1, 7.3046074009035318007577734740e-1, 7.3791040877273067240530795999e-1,
+	7.4540420954038721791685030916e-1, 7.5294221677607766811678333531e-1, 7.6052450467529222086535611273e-1, 7.6815114724750681388142439719e-1,
+	7.7582221831742336436012727821e-1, 7.8353779152619303164016412693e-1, 7.9129794033262999051373790324e-1, 7.9910273801440857782986659354e-1,
+	8.0695225766925137757178299089e-1, 8.1484657221610101468199485344e-1, 8.2278575439628330101864036666e-1, 8.3076987677465441138488604947e-1,
+	8.3879901174073981181414968664e-1, 8.4687323150985752575064115393e-1, 8.5499260812423353968543845294e-1, 8.6315721345410184160018329421e-1,
+	8.7136711919879697371739887824e-1, 8.7962239688783150062316702853e-1, 8.8792311788196635474530919899e-1, 8.9626935337426636795461503137e-1,
+	9.0466117439114903228664776099e-1, 9.1309865179341870622954052966e-1, 9.2158185627729439110564992706e-1, 9.3011085837542320163508839121e-1,
+	9.3868572845788773724177013584e-1, 9.4730653673319938578672287326e-1, 9.5597335324928584881169908516e-1, 9.6468624789446482751874430339e-1,
+	9.7344529039841224156865988306e-1, 9.8225055033311682739977102776e-1, 9.9110209711382957161585174784e-1, 9.9999999999999973354647408996e-1
+};
+
 static double rgb8_to_linear(uint8_t c)
 {
-	return c >= 11 ? pow(c * (40.0 / 10761.0) + (11.0 / 211.0), 2.4) : c * (5.0 / 16473.0);
+	// c >= 11 ? pow(c * (40.0 / 10761.0) + (11.0 / 211.0), 2.4) : c * (5.0 / 16473.0)
+	return color_rgb8_linear_tbl[c];
 }
 
 static void color_RGB8_to_LinearRGB(struct color *c, uint8_t extra)
@@ -127,6 +203,30 @@ static void color_RGB8_to_LinearRGB(struct color *c, uint8_t extra)
 	c->type = COLOR_LINEAR_RGB;
 }
 
+static void color_RGB8_to_LinearRGB_batch(struct color *c, size_t count, uint8_t extra)
+{
+	double const *tbl = color_rgb8_linear_tbl;
+	size_t i;
+
+	assert(c != NULL || count == 0);
+
+	for(i = 0; i < count; ++i)
+	{
+		double R, G, B;
+
+		assert(c[i].type == COLOR_RGB8);
+
+		R = tbl[c[i].RGB8.R];
+		G = tbl[c[i].RGB8.G];
+		B = tbl[c[i].RGB8.B];
+
+		c[i].LinearRGB.R = R;
+		c[i].LinearRGB.G = G;
+		c[i].LinearRGB.B = B;
+		c[i].type = COLOR_LINEAR_RGB;
+	}
+}
+
 static void color_RGB_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -178,6 +278,79 @@ static void color_RGB_to_LinearRGB(struct color *c, uint8_t extra)
 	c->type = COLOR_LINEAR_RGB;
 }
 
+#ifdef COLOR_SSE2
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#endif
+
+// SIMD batch kernels work on two colors at a time, one vector per component. they use the
+// same operations in the same order as the scalar code, so give the same results.
+
+static __inline void load2(__m128d *a, __m128d *b, __m128d *c, struct color const *p)
+{
+	__m128d ab0 = _mm_loadu_pd(&p[0].RGB.R), ab1 = _mm_loadu_pd(&p[1].RGB.R);
+
+	*a = _mm_unpacklo_pd(ab0, ab1);
+	*b = _mm_unpackhi_pd(ab0, ab1);
+	*c = _mm_loadh_pd(_mm_load_sd(&p[0].RGB.B), &p[1].RGB.B);
+}
+
+static __inline void store2(struct color *p, __m128d a, __m128d b, __m128d c)
+{
+	_mm_storeu_pd(&p[0].RGB.R, _mm_unpacklo_pd(a, b));
+	_mm_storeu_pd(&p[1].RGB.R, _mm_unpackhi_pd(a, b));
+	_mm_storel_pd(&p[0].RGB.B, c);
+	_mm_storeh_pd(&p[1].RGB.B, c);
+}
+
+static __inline __m128d select_pd(__m128d mask, __m128d a, __m128d b)
+{
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+static __inline __m128d abs_pd(__m128d x)
+{
+	return _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+}
+
+static __inline __m128d floor_pd(__m128d x)
+{
+#if defined(__SSE4_1__) || defined(__AVX__)
+	return _mm_floor_pd(x);
+#else
+	// round |x| to an integer by adding and removing 2^52, restore the sign, and step down
+	// where that rounded up. values of 2^52 and up are integers already.
+
+	__m128d magic = _mm_set1_pd(4503599627370496.0);
+	__m128d ax = abs_pd(x);
+	__m128d r = _mm_or_pd(_mm_sub_pd(_mm_add_pd(ax, magic), magic), _mm_and_pd(_mm_set1_pd(-0.0), x));
+
+	r = _mm_sub_pd(r, _mm_and_pd(_mm_cmpgt_pd(r, x), _mm_set1_pd(1.0)));
+	return select_pd(_mm_cmplt_pd(ax, magic), r, x);
+#endif
+}
+
+// min, max, delta and hue as color_RGB_to_HSL and color_RGB_to_HSV find them. hue is 0 where delta is.
+
+static __inline void rgb_hue2(__m128d *hue, __m128d *min, __m128d *max, __m128d *delta, __m128d *chroma, __m128d R, __m128d G, __m128d B)
+{
+	__m128d hr, hg, hb;
+
+	*min = _mm_min_pd(B, _mm_min_pd(R, G));
+	*max = _mm_max_pd(B, _mm_max_pd(R, G));
+	*delta = _mm_sub_pd(*max, *min);
+	*chroma = _mm_cmpgt_pd(abs_pd(*delta), _mm_setzero_pd());
+
+	hr = _mm_div_pd(_mm_sub_pd(G, B), *delta);
+	hg = _mm_add_pd(_mm_div_pd(_mm_sub_pd(B, R), *delta), _mm_set1_pd(2.0));
+	hb = _mm_add_pd(_mm_div_pd(_mm_sub_pd(R, G), *delta), _mm_set1_pd(4.0));
+
+	*hue = _mm_and_pd(*chroma, select_pd(_mm_cmpeq_pd(*max, R), hr, select_pd(_mm_cmpeq_pd(*max, G), hg, hb)));
+}
+
+#endif
+
 static void color_RGB_to_HSL(struct color *c, uint8_t extra)
 {
 	double R, G, B, min, max, delta, L;
@@ -220,6 +393,40 @@ static void color_RGB_to_HSL(struct color *c, uint8_t extra)
 	c->HSL.H = 0.0;
 }
 
+static void color_RGB_to_HSL_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d R, G, B, H, S, L, min, max, delta, chroma, sum;
+
+		assert(c[i].type == COLOR_RGB && c[i + 1].type == COLOR_RGB);
+
+		load2(&R, &G, &B, c + i);
+		rgb_hue2(&H, &min, &max, &delta, &chroma, R, G, B);
+
+		sum = _mm_add_pd(max, min);
+		L = _mm_mul_pd(sum, _mm_set1_pd(0.5));
+		S = select_pd(_mm_cmplt_pd(L, _mm_set1_pd(0.5)),
+			_mm_div_pd(delta, sum),
+			_mm_div_pd(delta, _mm_sub_pd(_mm_sub_pd(_mm_set1_pd(2.0), max), min)));
+
+		store2(c + i, H, _mm_and_pd(chroma, S), L);
+		c[i].type = COLOR_HSL;
+		c[i + 1].type = COLOR_HSL;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_RGB_to_HSL(&c[i], extra);
+	}
+}
+
 static void color_RGB_to_HSV(struct color *c, uint8_t extra)
 {
 	double R, G, B, min, max, delta;
@@ -258,6 +465,34 @@ static void color_RGB_to_HSV(struct color *c, uint8_t extra)
 	c->HSV.H = 0.0;
 }
 
+static void color_RGB_to_HSV_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d R, G, B, H, min, max, delta, chroma;
+
+		assert(c[i].type == COLOR_RGB && c[i + 1].type == COLOR_RGB);
+
+		load2(&R, &G, &B, c + i);
+		rgb_hue2(&H, &min, &max, &delta, &chroma, R, G, B);
+
+		store2(c + i, H, _mm_and_pd(chroma, _mm_div_pd(delta, max)), max);
+		c[i].type = COLOR_HSV;
+		c[i + 1].type = COLOR_HSV;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_RGB_to_HSV(&c[i], extra);
+	}
+}
+
 static void color_RGB_to_YUV(struct color *c, uint8_t extra)
 {
 	double R, G, B;
@@ -334,6 +569,77 @@ static uint8_t linear_to_rgb8(double c)
 	return 255;
 }
 
+// thresholds for linear_to_rgb8: entry k is the smallest value that encodes to k.
+// found by bisecting the function above, so a search over them gives identical results.
+
+COLOR_ALIGN(64) double const color_linear_rgb8_thresholds[256] =
+{
+	0.0, 0.00015176349177441873, 0.00045529047532325625, 0.00075881745887209371,
+	0.0010623444424209313, 0.0013658714259697686, 0.0016693984095186062, 0.001972925393067444,
+	0.0022764523766162811, 0.0025799793601651187, 0.0028835063437139563, 0.0031883009044305329,
+	0.003509259349581231, 0.0038483149330964272, 0.0042057480301049477, 0.00458183274052838,
+	0.004976837250274025, 0.0053910241598063794, 0.0058246507840408971, 0.0062779694269141061,
+	0.0067512276334986228, 0.007244668422128917, 0.0077585304986678592, 0.0082930484547623241,
+	0.0088484529516984975, 0.00942497089126609, 0.010022825574869037, 0.010642236851973576,
+	0.011283421258858298, 0.011946592148522128, 0.012631959812511863, 0.013339731595349033,
+	0.014070112002164467, 0.014823302800086414, 0.015599503113873271, 0.016398909516233677,
+	0.017221716113234101, 0.018068114625156385, 0.018938294463134074, 0.01983244280186686,
+	0.02075074464868551, 0.021693382909216241, 0.022660538449872064, 0.023652390157379504,
+	0.024669114995532006, 0.025710888059345766, 0.026777882626779784, 0.027870270208169259,
+	0.028988220593509972, 0.030131901897720907, 0.031301480604002875, 0.032497121605402225,
+	0.033718988244681086, 0.034967242352587954, 0.03624204428461638, 0.037543552956333104,
+	0.038871925877351575, 0.040227319184021858, 0.041609887670902901, 0.043019784821079425,
+	0.044457162835380939, 0.045922172660557474, 0.047414964016462814, 0.048935685422292992,
+	0.050484484221924891, 0.052061506608397215, 0.053666897647573389, 0.055300801301023855,
+	0.056963360448162956, 0.058654716907673564, 0.060375011458250832, 0.062124383858694739,
+	0.06390297286737924, 0.065710916261124616, 0.067548350853498071, 0.069415412512566096,
+	0.071312236178121421, 0.07323895587840544, 0.075195704746346695, 0.077182615035334329,
+	0.079199818134545019, 0.081247444583840395, 0.083325624088251699, 0.085434485532067048,
+	0.087574156992536845, 0.089744765753210651, 0.091946438316919801, 0.094179300418418418,
+	0.096443477036695063, 0.098739092406966961, 0.10106627003236783, 0.10342513269534026,
+	0.10581580246874273, 0.10823840072668102, 0.11069304815507366, 0.11317986476196007,
+	0.11569896988756012, 0.11825048221409344, 0.12083451977536609, 0.12345119996613246,
+	0.12610063955123937, 0.12878295467455944, 0.13149826086772051, 0.13424667305863719,
+	0.13702830557985107, 0.13984327217668513, 0.14269168601521831, 0.14557365969008562,
+	0.14848930523210874, 0.15143873411576275, 0.15442205726648328, 0.15743938506781896,
+	0.16049082736843376, 0.16357649348896344, 0.1666964922287304, 0.16985093187232053,
+	0.17303992019602685, 0.1762635644741625, 0.17952197148524762, 0.18281524751807332,
+	0.18614349837764563, 0.18950682939101376, 0.19290534541298462, 0.1963391508317269,
+	0.19980834957426896, 0.20331304511189063, 0.20685334046541506, 0.21042933821039972,
+	0.21404114048223252, 0.21768884898113219, 0.22137256497705876, 0.22509238931453274,
+	0.22884842241736911, 0.23264076429332445, 0.23646951453866299, 0.24033477234264,
+	0.24423663649190827, 0.24817520537484555, 0.25215057698580889, 0.25616284892931374,
+	0.26021211842414338, 0.26429848230738645, 0.26842203703840828, 0.27258287870275338,
+	0.27678110301598524, 0.28101680532745976, 0.28529008062403888, 0.28960102353374234,
+	0.29394972832933941, 0.29833628893188446, 0.30276079891419327, 0.30722335150426622,
+	0.31172403958865508, 0.31626295571577845, 0.32084019209918363, 0.32545584062075927,
+	0.33010999283389647, 0.33480273996660298, 0.33953417292456811, 0.34430438229418259,
+	0.34911345834551083, 0.35396149103522068, 0.35884857000946702, 0.3637747846067349,
+	0.36874022386063804, 0.37374497650267885, 0.37878913096496569, 0.38387277538289255,
+	0.38899599759777825, 0.39415888515946967, 0.39936152532890551, 0.40460400508064537,
+	0.40988641110536284, 0.41520882981230189, 0.42057134733170154, 0.42597404951718393,
+	0.43141702194811216, 0.4369003499319129, 0.44242411850636981, 0.4479884124418832,
+	0.45359331624370164, 0.45923891415412071, 0.46492529015465517, 0.47065252796817914,
+	0.47642071106104084, 0.48222992264514675, 0.48808024568002045, 0.49397176287483291,
+	0.4999045566904079, 0.50587870934119961, 0.51189430279724712, 0.51795141878610118,
+	0.52405013879472884, 0.53019054407139188, 0.53637271562750366, 0.54259673423945987,
+	0.54886268045044906, 0.55517063457223936, 0.56152067668694228, 0.56791288664875739,
+	0.57434734408569166, 0.58082412840126196, 0.58734331877617363, 0.59390499416998077,
+	0.60050923332272477, 0.60715611475655573, 0.61384571677733113, 0.62057811747619884,
+	0.62735339473115892, 0.63417162620860901, 0.64103288936486924, 0.64793726144769226,
+	0.65488481949775268, 0.66187564035012236, 0.66890980063572569, 0.67598737678278087,
+	0.68310844501822221, 0.69027308136910925, 0.69748136166401642, 0.70473336153441057,
+	0.71202915641601028, 0.71936882155013115, 0.72675243198501704, 0.73418006257715407,
+	0.74165178799257336, 0.74916768270813594, 0.75672782101280733, 0.7643322770089146,
+	0.77198112461339297, 0.77967443755901644, 0.78741228939561725, 0.79519475349129032,
+	0.80302190303358689, 0.81089381103069325, 0.81881055031259975, 0.82677219353225395,
+	0.83477881316670588, 0.84283048151823681, 0.85092727071548069, 0.85906925271453016,
+	0.86725649930003423, 0.87548908208628173, 0.88376707251827713, 0.89209054187280146,
+	0.90045956125946547, 0.9088742016217517, 0.91733453373804408, 0.92584062822264901,
+	0.93439255552680689, 0.94299038593969042, 0.95163418958939705, 0.9603240364439275,
+	0.96905999631215911, 0.97784213884480464, 0.98667053353536649, 0.99554524972107783
+};
+
 static void color_LinearRGB_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -362,6 +668,29 @@ static void color_LinearRGB_to_RGB8(struct color *c, uint8_t extra)
 	c->type = COLOR_RGB8;
 }
 
+static void color_LinearRGB_to_RGB8_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i;
+
+	assert(c != NULL || count == 0);
+
+	for(i = 0; i < count; ++i)
+	{
+		uint8_t R, G, B;
+
+		assert(c[i].type == COLOR_LINEAR_RGB);
+
+		R = color_linear_to_rgb8_fast(c[i].LinearRGB.R);
+		G = color_linear_to_rgb8_fast(c[i].LinearRGB.G);
+		B = color_linear_to_rgb8_fast(c[i].LinearRGB.B);
+
+		c[i].RGB8.R = R;
+		c[i].RGB8.G = G;
+		c[i].RGB8.B = B;
+		c[i].type = COLOR_RGB8;
+	}
+}
+
 static double linear_to_rgb(double c)
 {
 	return c > 0.0031308 ? pow(c, 1.0 / 2.4) * 1.055 - 0.055 : c * 12.92;
@@ -401,13 +730,36 @@ static void color_LinearRGB_to_XYZ(struct color *c, uint8_t extra)
 	c->type = COLOR_XYZ;
 }
 
-static double xyz_to_lab(double c)
+// linear sRGB -> XYZ relative to the white point, and back, as the Lab conversions use them.
+// color_code8.c builds its fixed-point matrices from these.
+
+double const color_linear_to_xyzw[9] =
+{
+	10135552.0/23359437.0, 8788810.0/23359437.0, 4435075.0/23359437.0,
+	871024.0/4096299.0,    8788810.0/12288897.0, 887015.0/12288897.0,
+	158368.0/8920923.0,    8788810.0/80288307.0, 70074185.0/80288307.0
+};
+
+double const color_xyzw_to_linear[9] =
+{
+	1219569.0/395920.0,     -608687.0/395920.0,    -107481.0/197960.0,
+	-80960619.0/87888100.0, 82435961.0/43944050.0, 3976797.0/87888100.0,
+	93813.0/1774030.0,      -180961.0/887015.0,    107481.0/93370.0
+};
+
+double color_lab_f(double t)
+{
+	return t > 216.0 / 24389.0 ? pow(t, 1.0 / 3.0) : t * (841.0/108.0) + (4.0/29.0);
+}
+
+double color_lab_f_inv(double f)
 {
-	return c > 216.0 / 24389.0 ? pow(c, 1.0 / 3.0) : c * (841.0/108.0) + (4.0/29.0);
+	return f > 6.0 / 29.0 ? f * f * f : f * (108.0/841.0) - 432.0/24389.0;
 }
 
 static void color_LinearRGB_to_Lab(struct color *c, uint8_t extra)
 {
+	double const *m = color_linear_to_xyzw;
 	double R, G, B, X, Y, Z;
 
 	assert(c != NULL);
@@ -419,9 +771,9 @@ static void color_LinearRGB_to_Lab(struct color *c, uint8_t extra)
 	
 	// linear sRGB -> normalized XYZ (X,Y,Z are all in 0...1)
 	
-	X = xyz_to_lab(R * (10135552.0/23359437.0) + G * (8788810.0/23359437.0) + B * (4435075.0/23359437.0));
-	Y = xyz_to_lab(R * (871024.0/4096299.0)    + G * (8788810.0/12288897.0) + B * (887015.0/12288897.0));
-	Z = xyz_to_lab(R * (158368.0/8920923.0)    + G * (8788810.0/80288307.0) + B * (70074185.0/80288307.0));
+	X = color_lab_f(R * m[0] + G * m[1] + B * m[2]);
+	Y = color_lab_f(R * m[3] + G * m[4] + B * m[5]);
+	Z = color_lab_f(R * m[6] + G * m[7] + B * m[8]);
 
 	// normalized XYZ -> Lab
 
@@ -431,6 +783,56 @@ static void color_LinearRGB_to_Lab(struct color *c, uint8_t extra)
 	c->type = COLOR_LAB;
 }
 
+// per-channel terms of Y' in each YUV matrix ([0] to [3]) and of the luminance Y ([4]), from RGB8.
+// each is the conversion of a color with the other two channels 0, so summing a color's three
+// terms in R, G, B order gives the same result as the full conversion.
+
+static double g_luma[COLOR_YUV_MAT_MASK + 2][3][256];
+static long volatile g_luma_state;
+
+static void color_luma_build(void)
+{
+	int m, k, v;
+
+	for(k = 0; k < 3; ++k)
+	{
+		for(v = 0; v < 256; ++v)
+		{
+			struct color c;
+
+			c.type = COLOR_RGB8;
+			c.RGB8.R = c.RGB8.G = c.RGB8.B = 0;
+			(&c.RGB8.R)[k] = (uint8_t)v;
+
+			for(m = 0; m <= COLOR_YUV_MAT_MASK; ++m)
+			{
+				struct color tmp = c;
+
+				color_RGB8_to_RGB(&tmp, 0);
+				color_RGB_to_YUV(&tmp, (uint8_t)m);
+				g_luma[m][k][v] = tmp.YUV.Y;
+			}
+
+			color_RGB8_to_LinearRGB(&c, 0);
+			color_LinearRGB_to_XYZ(&c, 0);
+			g_luma[COLOR_YUV_MAT_MASK + 1][k][v] = c.XYZ.Y;
+		}
+	}
+}
+
+double const (*color_luma_tables(int luminance, uint8_t extra))[256]
+{
+	color_call_once(&g_luma_state, color_luma_build);
+	return g_luma[luminance ? COLOR_YUV_MAT_MASK + 1 : extra & COLOR_YUV_MAT_MASK];
+}
+
+// L* of a luminance, as color_LinearRGB_to_Lab computes it.
+
+double color_luminance_to_lightness(double Y)
+{
+	return color_lab_f(Y) * 116.0 - 16.0;
+}
+
 static void color_HSL_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -487,6 +889,45 @@ static void finish_HSL_to_RGB(struct color *c, double h, double C, double m)
 	c->RGB.B = vars[rgb_tbl[idx][2]];
 }
 
+#ifdef COLOR_SSE2
+
+// finish_HSL_to_RGB for two colors. the table lookup becomes a pick between the three
+// values by masks: each sextant puts C + m, m and the ramp in a different order.
+
+static __inline void finish_HSL_to_RGB2(__m128d *R, __m128d *G, __m128d *B, __m128d h, __m128d C, __m128d m)
+{
+	__m128d one = _mm_set1_pd(1.0), six = _mm_set1_pd(6.0), zero = _mm_setzero_pd();
+	__m128d absh, neg, h2, idx, v0, v2, e[6];
+	int k;
+
+	absh = abs_pd(h);
+	neg = _mm_cmplt_pd(h, zero);
+
+	h2 = select_pd(_mm_cmpge_pd(absh, _mm_set1_pd(2.0)),
+		_mm_sub_pd(_mm_add_pd(_mm_mul_pd(floor_pd(_mm_mul_pd(h, _mm_set1_pd(0.5))), _mm_set1_pd(-2.0)), h), one),
+		select_pd(neg, _mm_add_pd(h, one), _mm_sub_pd(h, one)));
+	h2 = _mm_sub_pd(one, abs_pd(h2));
+
+	idx = select_pd(_mm_cmpge_pd(absh, six),
+		_mm_add_pd(_mm_mul_pd(floor_pd(_mm_mul_pd(h, _mm_set1_pd(1.0 / 6.0))), _mm_set1_pd(-6.0)), h),
+		select_pd(neg, _mm_add_pd(h, six), h));
+	idx = _mm_cvtepi32_pd(_mm_cvttpd_epi32(idx));
+
+	for(k = 0; k < 6; ++k)
+	{
+		e[k] = _mm_cmpeq_pd(idx, _mm_set1_pd((double)k));
+	}
+
+	v0 = _mm_add_pd(C, m);
+	v2 = _mm_add_pd(_mm_mul_pd(C, h2), m);
+
+	*R = select_pd(_mm_or_pd(e[0], e[5]), v0, select_pd(_mm_or_pd(e[1], e[4]), v2, m));
+	*G = select_pd(_mm_or_pd(e[1], e[2]), v0, select_pd(_mm_or_pd(e[0], e[3]), v2, m));
+	*B = select_pd(_mm_or_pd(e[3], e[4]), v0, select_pd(_mm_or_pd(e[2], e[5]), v2, m));
+}
+
+#endif
+
 static void color_HSL_to_RGB(struct color *c, uint8_t extra)
 {
 	double H, S, L, C, m;
@@ -512,6 +953,39 @@ static void color_HSL_to_RGB(struct color *c, uint8_t extra)
 	c->RGB.R = L; c->RGB.G = L; c->RGB.B = L;
 }
 
+static void color_HSL_to_RGB_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d H, S, L, C, m, R, G, B, chroma, one = _mm_set1_pd(1.0);
+
+		assert(c[i].type == COLOR_HSL && c[i + 1].type == COLOR_HSL);
+
+		load2(&H, &S, &L, c + i);
+
+		chroma = _mm_cmpgt_pd(abs_pd(S), _mm_setzero_pd());
+		C = _mm_mul_pd(_mm_sub_pd(one, abs_pd(_mm_sub_pd(_mm_mul_pd(L, _mm_set1_pd(2.0)), one))), S);
+		m = _mm_add_pd(_mm_mul_pd(C, _mm_set1_pd(-0.5)), L);
+
+		finish_HSL_to_RGB2(&R, &G, &B, H, C, m);
+
+		store2(c + i, select_pd(chroma, R, L), select_pd(chroma, G, L), select_pd(chroma, B, L));
+		c[i].type = COLOR_RGB;
+		c[i + 1].type = COLOR_RGB;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_HSL_to_RGB(&c[i], extra);
+	}
+}
+
 static void color_HSV_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -548,6 +1022,39 @@ static void color_HSV_to_RGB(struct color *c, uint8_t extra)
 	c->RGB.R = V; c->RGB.G = V; c->RGB.B = V;
 }
 
+static void color_HSV_to_RGB_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d H, S, V, C, m, R, G, B, chroma;
+
+		assert(c[i].type == COLOR_HSV && c[i + 1].type == COLOR_HSV);
+
+		load2(&H, &S, &V, c + i);
+
+		chroma = _mm_cmpgt_pd(abs_pd(S), _mm_setzero_pd());
+		C = _mm_mul_pd(V, S);
+		m = _mm_sub_pd(V, C);
+
+		finish_HSL_to_RGB2(&R, &G, &B, H, C, m);
+
+		store2(c + i, select_pd(chroma, R, V), select_pd(chroma, G, V), select_pd(chroma, B, V));
+		c[i].type = COLOR_RGB;
+		c[i + 1].type = COLOR_RGB;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_HSV_to_RGB(&c[i], extra);
+	}
+}
+
 static void color_YUV_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -592,9 +1099,27 @@ static void color_YUV_to_YUV(struct color *c, uint8_t extra)
 	assert(c->extra == extra);
 }
 
+// YUV scaled to YCbCr code values, before truncation and clamping.
+
+static void ycbcr_codes(double *dst, double Y, double U, double V, uint8_t extra)
+{
+	if(extra & COLOR_YCBCR_FULL_RANGE)
+	{
+		dst[0] = Y * 255.0 + 0.5;
+		dst[1] = U * (31875.0/109.0) + 128;
+		dst[2] = V * (8500.0/41.0) + 128;
+	}
+	else
+	{
+		dst[0] = Y * 219.0 + 16.5;
+		dst[1] = U * (28000.0/109.0) + 144;
+		dst[2] = V * (22400.0/123.0) + 144;
+	}
+}
+
 static void color_YUV_to_YCbCr(struct color *c, uint8_t extra)
 {
-	double Y, U, V;
+	double Y, U, V, v[3];
 
 	assert(c != NULL);
 	assert(c->type == COLOR_YUV);
@@ -604,22 +1129,10 @@ static void color_YUV_to_YCbCr(struct color *c, uint8_t extra)
 		color_YUV_to_YUV(c, extra);
 	}
 
-	Y = c->YUV.Y;
-	U = c->YUV.U;
-	V = c->YUV.V;
-
-	if(extra & COLOR_YCBCR_FULL_RANGE)
-	{
-		Y = Y * 255.0 + 0.5;
-		U = U * (31875.0/109.0) + 128;
-		V = V * (8500.0/41.0) + 128;
-	}
-	else
-	{
-		Y = Y * 219.0 + 16.5;
-		U = U * (28000.0/109.0) + 144;
-		V = V * (22400.0/123.0) + 144;
-	}
+	ycbcr_codes(v, c->YUV.Y, c->YUV.U, c->YUV.V, extra);
+	Y = v[0];
+	U = v[1];
+	V = v[2];
 	
 	c->YCbCr.Y = Y < 0.0 ? 0 : Y > 255.0 ? 255 : (int)Y;
 	c->YCbCr.Cb = U < 0.0 ? 0 : U > 255.0 ? 255 : (int)U;
@@ -688,6 +1201,131 @@ static void color_YCbCr_to_YCbCr(struct color *c, uint8_t extra)
 	assert(c->extra == extra);
 }
 
+// with the matrix kept, a range change maps each channel on its own, so it is a table lookup.
+// [0] is limited -> full, [1] full -> limited. filled from color_YCbCr_to_YCbCr, so the same rounding.
+
+static uint8_t g_ycbcr_range[2][3][256];
+static long volatile g_ycbcr_range_state;
+
+static void color_ycbcr_range_build(void)
+{
+	int from_full, v;
+
+	for(from_full = 0; from_full < 2; ++from_full)
+	{
+		for(v = 0; v < 256; ++v)
+		{
+			struct color c;
+
+			c.type = COLOR_YCBCR;
+			c.extra = from_full ? COLOR_YCBCR_FULL_RANGE : 0;
+			c.YCbCr.Y = c.YCbCr.Cb = c.YCbCr.Cr = (uint8_t)v;
+
+			color_YCbCr_to_YCbCr(&c, from_full ? 0 : COLOR_YCBCR_FULL_RANGE);
+
+			g_ycbcr_range[from_full][0][v] = c.YCbCr.Y;
+			g_ycbcr_range[from_full][1][v] = c.YCbCr.Cb;
+			g_ycbcr_range[from_full][2][v] = c.YCbCr.Cr;
+		}
+	}
+}
+
+uint8_t const (*color_ycbcr_range_tables(int from_full))[256]
+{
+	color_call_once(&g_ycbcr_range_state, color_ycbcr_range_build);
+	return g_ycbcr_range[from_full != 0];
+}
+
+// the codes color_YCbCr_to_YCbCr truncates, as a function of the input codes.
+
+static void ycbcr_probe(double *dst, int Y, int Cb, int Cr, uint8_t from_extra, uint8_t to_extra)
+{
+	struct color c;
+
+	c.type = COLOR_YCBCR;
+	c.extra = from_extra;
+	c.YCbCr.Y = (uint8_t)Y;
+	c.YCbCr.Cb = (uint8_t)Cb;
+	c.YCbCr.Cr = (uint8_t)Cr;
+
+	color_YCbCr_to_YUV(&c, to_extra);
+	ycbcr_codes(dst, c.YUV.Y, c.YUV.U, c.YUV.V, to_extra);
+}
+
+void color_ycbcr_fixed(int32_t *m, uint8_t from_extra, uint8_t to_extra)
+{
+	double zero[3], unit[3][3], scale = (double)(1 << COLOR_YCBCR_FIXED_BITS);
+	int j, k;
+
+	// the map is affine: probe the origin, and each input at 255 for the slopes.
+
+	ycbcr_probe(zero, 0, 0, 0, from_extra, to_extra);
+	ycbcr_probe(unit[0], 255, 0, 0, from_extra, to_extra);
+	ycbcr_probe(unit[1], 0, 255, 0, from_extra, to_extra);
+	ycbcr_probe(unit[2], 0, 0, 255, from_extra, to_extra);
+
+	for(k = 0; k < 3; ++k)
+	{
+		double bound;
+
+		m[k * 4 + 3] = (int32_t)floor(zero[k] * scale + 0.5);
+		bound = fabs(zero[k]);
+
+		for(j = 0; j < 3; ++j)
+		{
+			double slope = (unit[j][k] - zero[k]) * (1.0 / 255.0);
+
+			m[k * 4 + j] = (int32_t)floor(slope * scale + 0.5);
+			bound += fabs(slope) * 255.0;
+		}
+
+		// sums must fit in 32 bits for every input.
+		assert(bound * scale < 2147483647.0);
+	}
+}
+
+static void color_YCbCr_to_YCbCr_batch(struct color *c, size_t count, uint8_t extra)
+{
+	uint8_t const (*tbl)[256];
+	uint8_t from_extra;
+	size_t i;
+
+	assert(c != NULL || count == 0);
+
+	if(count == 0)
+	{
+		return;
+	}
+
+	// a plan's colors all share one extra, so this is decided once.
+
+	from_extra = c[0].extra;
+
+	if(((from_extra ^ extra) & COLOR_YUV_MAT_MASK) != 0)
+	{
+		for(i = 0; i < count; ++i)
+		{
+			color_YCbCr_to_YCbCr(&c[i], extra);
+		}
+
+		return;
+	}
+
+	tbl = color_ycbcr_range_tables(from_extra & COLOR_YCBCR_FULL_RANGE);
+
+	for(i = 0; i < count; ++i)
+	{
+		assert(c[i].type == COLOR_YCBCR);
+		assert(c[i].extra == from_extra);
+		assert(from_extra != extra);
+
+		c[i].YCbCr.Y = tbl[0][c[i].YCbCr.Y];
+		c[i].YCbCr.Cb = tbl[1][c[i].YCbCr.Cb];
+		c[i].YCbCr.Cr = tbl[2][c[i].YCbCr.Cr];
+		c[i].extra = extra;
+	}
+}
+
 static void color_YDbDr_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -833,6 +1471,38 @@ static void color_XYZ_to_xyY(struct color *c, uint8_t extra)
 	c->xyY.y = Y;
 }
 
+// black, with a zero denominator, is masked rather than branched on in the batch kernels.
+
+static void color_XYZ_to_xyY_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d X, Y, Z, div, nonzero;
+
+		assert(c[i].type == COLOR_XYZ && c[i + 1].type == COLOR_XYZ);
+
+		load2(&X, &Y, &Z, c + i);
+
+		div = _mm_add_pd(_mm_add_pd(X, Y), Z);
+		nonzero = _mm_cmpgt_pd(abs_pd(div), _mm_setzero_pd());
+
+		store2(c + i, select_pd(nonzero, _mm_div_pd(X, div), X), select_pd(nonzero, _mm_div_pd(Y, div), Y), Y);
+		c[i].type = COLOR_XYY;
+		c[i + 1].type = COLOR_XYY;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_XYZ_to_xyY(&c[i], extra);
+	}
+}
+
 static void color_XYZ_to_Lab(struct color *c, uint8_t extra)
 {
 	double X, Y, Z;
@@ -881,16 +1551,59 @@ static void color_XYZ_to_Luv(struct color *c, uint8_t extra)
 	c->type = COLOR_LUV;
 }
 
-static void color_xyY_extract(double *dst, struct color const *src)
+static void color_XYZ_to_Luv_batch(struct color *c, size_t count, uint8_t extra)
 {
-	assert(dst != NULL);
-	assert(src != NULL);
-	assert(src->type == COLOR_XYY);
+	size_t i = 0;
 
-	dst[0] = src->xyY.x;
-	dst[1] = src->xyY.y;
-	dst[2] = src->xyY.Y;
-}
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d X, Y, Z, L, div, nonzero;
+		double L0, L1;
+
+		assert(c[i].type == COLOR_XYZ && c[i + 1].type == COLOR_XYZ);
+
+		// the cube root stays libm's, so L matches the scalar conversion.
+
+		L0 = c[i].XYZ.Y > 216.0/24389.0 ? pow(c[i].XYZ.Y, 1.0 / 3.0) * 116.0 - 16.0 : c[i].XYZ.Y * (24389.0/27.0);
+		L1 = c[i + 1].XYZ.Y > 216.0/24389.0 ? pow(c[i + 1].XYZ.Y, 1.0 / 3.0) * 116.0 - 16.0 : c[i + 1].XYZ.Y * (24389.0/27.0);
+		L = _mm_setr_pd(L0, L1);
+
+		load2(&X, &Y, &Z, c + i);
+
+		div = _mm_add_pd(_mm_add_pd(X, _mm_mul_pd(Y, _mm_set1_pd(15.0))), _mm_mul_pd(Z, _mm_set1_pd(3.0)));
+		nonzero = _mm_cmpgt_pd(abs_pd(div), _mm_setzero_pd());
+		div = _mm_div_pd(_mm_set1_pd(1.0), div);
+
+		X = select_pd(nonzero, _mm_mul_pd(X, div), X);
+		Y = select_pd(nonzero, _mm_mul_pd(Y, div), Y);
+
+		store2(c + i, L,
+			_mm_mul_pd(_mm_sub_pd(_mm_mul_pd(X, _mm_set1_pd(52.0)), _mm_set1_pd(COLOR_REF_U13)), L),
+			_mm_mul_pd(_mm_sub_pd(_mm_mul_pd(Y, _mm_set1_pd(117.0)), _mm_set1_pd(COLOR_REF_V13)), L));
+		c[i].type = COLOR_LUV;
+		c[i + 1].type = COLOR_LUV;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_XYZ_to_Luv(&c[i], extra);
+	}
+}
+
+static void color_xyY_extract(double *dst, struct color const *src)
+{
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(src->type == COLOR_XYY);
+
+	dst[0] = src->xyY.x;
+	dst[1] = src->xyY.y;
+	dst[2] = src->xyY.Y;
+}
 
 static void color_xyY_to_XYZ(struct color *c, uint8_t extra)
 {
@@ -921,6 +1634,39 @@ static void color_xyY_to_XYZ(struct color *c, uint8_t extra)
 	c->XYZ.Z = 0.0;
 }
 
+static void color_xyY_to_XYZ_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d x, y, Y, mul, nonzero;
+
+		assert(c[i].type == COLOR_XYY && c[i + 1].type == COLOR_XYY);
+
+		load2(&x, &y, &Y, c + i);
+
+		nonzero = _mm_cmpgt_pd(abs_pd(y), _mm_setzero_pd());
+		mul = _mm_div_pd(Y, y);
+
+		store2(c + i,
+			_mm_and_pd(nonzero, _mm_mul_pd(x, mul)),
+			_mm_and_pd(nonzero, Y),
+			_mm_and_pd(nonzero, _mm_mul_pd(_mm_sub_pd(_mm_sub_pd(_mm_set1_pd(1.0), x), y), mul)));
+		c[i].type = COLOR_XYZ;
+		c[i + 1].type = COLOR_XYZ;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_xyY_to_XYZ(&c[i], extra);
+	}
+}
+
 static void color_Lab_extract(double *dst, struct color const *src)
 {
 	assert(dst != NULL);
@@ -934,6 +1680,7 @@ static void color_Lab_extract(double *dst, struct color const *src)
 
 static void color_Lab_to_LinearRGB(struct color *c, uint8_t extra)
 {
+	double const *m = color_xyzw_to_linear;
 	double X, Y, Z;
 
 	assert(c != NULL);
@@ -945,15 +1692,15 @@ static void color_Lab_to_LinearRGB(struct color *c, uint8_t extra)
 	X = c->Lab.a * (1.0/500.0) + Y;
 	Z = c->Lab.b * (-1.0/200.0) + Y;
 
-	X = X > 6.0/29.0 ? X * X * X : X * (108.0/841.0) - 432.0/24389.0;
+	X = color_lab_f_inv(X);
 	Y = c->Lab.L > 8.0 ? Y * Y * Y : c->Lab.L * (27.0/24389.0);
-	Z = Z > 6.0/29.0 ? Z * Z * Z : Z * (108.0/841.0) - 432.0/24389.0;
+	Z = color_lab_f_inv(Z);
 
 	// normalized XYZ -> linear sRGB
 
-	c->LinearRGB.R = X * (1219569.0/395920.0)     + Y * (-608687.0/395920.0)    + Z * (-107481.0/197960.0);
-	c->LinearRGB.G = X * (-80960619.0/87888100.0) + Y * (82435961.0/43944050.0) + Z * (3976797.0/87888100.0);
-	c->LinearRGB.B = X * (93813.0/1774030.0)      + Y * (-180961.0/887015.0)    + Z * (107481.0/93370.0);
+	c->LinearRGB.R = X * m[0] + Y * m[1] + Z * m[2];
+	c->LinearRGB.G = X * m[3] + Y * m[4] + Z * m[5];
+	c->LinearRGB.B = X * m[6] + Y * m[7] + Z * m[8];
 	c->type = COLOR_LINEAR_RGB;
 }
 
@@ -977,9 +1724,228 @@ static void color_Lab_to_XYZ(struct color *c, uint8_t extra)
 	c->type = COLOR_XYZ;
 }
 
+#ifdef COLOR_SSE2
+
+// vector atan2 and sincos for the polar batch kernels. these are not libm's, so batch results
+// differ from color_convert: hue by at most 8.9e-16 radians, a and b by about that times C.
+// chroma is the same. steps after the polar one amplify the difference, most near L = 0 where
+// they are ill-conditioned: over 10^6 random colors, check.c sees up to 7.1e-6 in C for
+// LCHuv -> LCHab and 1.1e-6 in S for LSHuv -> HSL. polynomials are Cephes'.
+
+static __inline __m128d polevl2(__m128d x, double const *coef, int n)
+{
+	__m128d r = _mm_set1_pd(coef[0]);
+	int i;
+
+	for(i = 1; i <= n; ++i)
+	{
+		r = _mm_add_pd(_mm_mul_pd(r, x), _mm_set1_pd(coef[i]));
+	}
+
+	return r;
+}
+
+// all ones where x's sign bit is set.
+
+static __inline __m128d signmask_pd(__m128d x)
+{
+	return _mm_castsi128_pd(_mm_shuffle_epi32(_mm_srai_epi32(_mm_castpd_si128(x), 31), _MM_SHUFFLE(3, 3, 1, 1)));
+}
+
+static __inline __m128d atan2_pd(__m128d y, __m128d x)
+{
+	static double const P[] = { -8.750608600031904122785E-1, -1.615753718733365076637E1, -7.500855792314704667340E1, -1.228866684490136173410E2, -6.485021904942025371773E1 };
+	static double const Q[] = { 1.0, 2.485846490142306297962E1, 1.650270098316988542046E2, 4.328810604912902668951E2, 4.853903996359136964868E2, 1.945506571482613964425E2 };
+
+	__m128d sign = _mm_set1_pd(-0.0), one = _mm_set1_pd(1.0);
+	__m128d ax = abs_pd(x), ay = abs_pd(y), num, den, t, big, z, r, swap;
+
+	// atan of min/max in [0, 1], then reflected into the right octant.
+
+	swap = _mm_cmpgt_pd(ay, ax);
+	num = _mm_min_pd(ax, ay);
+	den = _mm_max_pd(ax, ay);
+	t = _mm_and_pd(_mm_cmpgt_pd(den, _mm_setzero_pd()), _mm_div_pd(num, den));
+
+	// above 0.66, atan(t) = pi/4 + atan((t - 1) / (t + 1)).
+
+	big = _mm_cmpgt_pd(t, _mm_set1_pd(0.66));
+	t = select_pd(big, _mm_div_pd(_mm_sub_pd(t, one), _mm_add_pd(t, one)), t);
+
+	z = _mm_mul_pd(t, t);
+	z = _mm_div_pd(_mm_mul_pd(z, polevl2(z, P, 4)), polevl2(z, Q, 5));
+	z = _mm_add_pd(_mm_mul_pd(t, z), t);
+	r = _mm_add_pd(_mm_and_pd(big, _mm_set1_pd(0.78539816339744830962)), _mm_add_pd(z, _mm_and_pd(big, _mm_set1_pd(0.5 * 6.123233995736765886130E-17))));
+
+	r = select_pd(swap, _mm_sub_pd(_mm_set1_pd(1.57079632679489661923), r), r);
+
+	// x < 0, including -0: pi - r. the result takes y's sign, as atan2's does.
+
+	r = select_pd(signmask_pd(x), _mm_sub_pd(_mm_set1_pd(3.14159265358979323846), r), r);
+
+	return _mm_or_pd(r, _mm_and_pd(sign, y));
+}
+
+// |h| must be at most POLAR_MAX_HUE, for the reduction by pi/2 to stay exact.
+
+#define POLAR_MAX_HUE 1e6
+
+static __inline void sincos_pd(__m128d *sin_h, __m128d *cos_h, __m128d h)
+{
+	static double const S[] = { 1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6, -1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1 };
+	static double const C[] = { -1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7, 2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2 };
+
+	__m128i n, swap, sin_sign, cos_sign, two = _mm_set1_epi32(2), zero = _mm_setzero_si128();
+	__m128d nd, r, z, s, c;
+
+	// h = n * pi/2 + r, with pi/2 in three parts so that r is exact. |r| <= pi/4.
+
+	n = _mm_cvtpd_epi32(_mm_mul_pd(h, _mm_set1_pd(0.63661977236758134308)));
+	nd = _mm_cvtepi32_pd(n);
+
+	r = _mm_sub_pd(h, _mm_mul_pd(nd, _mm_set1_pd(1.57079625129699707031)));
+	r = _mm_sub_pd(r, _mm_mul_pd(nd, _mm_set1_pd(7.54978941586159635336E-8)));
+	r = _mm_sub_pd(r, _mm_mul_pd(nd, _mm_set1_pd(5.39030285815811905290E-15)));
+
+	z = _mm_mul_pd(r, r);
+	s = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(r, z), polevl2(z, S, 5)), r);
+	c = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, _mm_set1_pd(0.5))), _mm_mul_pd(_mm_mul_pd(z, z), polevl2(z, C, 5)));
+
+	// by quadrant n & 3: sin is s, c, -s, -c and cos is c, -s, -c, s.
+
+	swap = _mm_shuffle_epi32(_mm_cmpeq_epi32(_mm_and_si128(n, _mm_set1_epi32(1)), _mm_set1_epi32(1)), _MM_SHUFFLE(1, 1, 0, 0));
+	sin_sign = _mm_unpacklo_epi32(zero, _mm_slli_epi32(_mm_and_si128(n, two), 30));
+	cos_sign = _mm_unpacklo_epi32(zero, _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(n, _mm_set1_epi32(1)), two), 30));
+
+	*sin_h = _mm_xor_pd(select_pd(_mm_castsi128_pd(swap), c, s), _mm_castsi128_pd(sin_sign));
+	*cos_h = _mm_xor_pd(select_pd(_mm_castsi128_pd(swap), s, c), _mm_castsi128_pd(cos_sign));
+}
+
+// stores a pair's converted components, except in the lanes set in bad, which go through
+// scalar instead. each color's result then depends only on that color.
+
+static void polar_store2(struct color *p, __m128d a, __m128d b, __m128d c, int bad, uint8_t extra, uint8_t to, conversion_func scalar)
+{
+	struct color out[2];
+	int k;
+
+	if(bad == 0)
+	{
+		store2(p, a, b, c);
+		p[0].type = to;
+		p[1].type = to;
+		return;
+	}
+
+	out[0] = p[0];
+	out[1] = p[1];
+	store2(out, a, b, c);
+
+	for(k = 0; k < 2; ++k)
+	{
+		if(bad & (1 << k))
+		{
+			scalar(&p[k], extra);
+		}
+		else
+		{
+			p[k] = out[k];
+			p[k].type = to;
+		}
+	}
+}
+
+// Lab -> LCHab and Luv -> LCHuv, which are the same conversion. colors with a non-finite
+// component go through scalar, which handles them as libm does.
+
+static void to_polar2(struct color *p, uint8_t extra, uint8_t to, conversion_func scalar)
+{
+	__m128d L, a, b, h;
+	int bad;
+
+	load2(&L, &a, &b, p);
+
+	bad = _mm_movemask_pd(_mm_cmpunord_pd(_mm_mul_pd(a, _mm_setzero_pd()), _mm_mul_pd(b, _mm_setzero_pd())));
+
+	// negative hues move up by pi*2, as in color_Lab_to_LCHab.
+	h = atan2_pd(b, a);
+	h = _mm_add_pd(h, _mm_and_pd(_mm_cmplt_pd(h, _mm_setzero_pd()), _mm_set1_pd(6.2831853071795864769252867666)));
+
+	polar_store2(p, L, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b))), h, bad, extra, to, scalar);
+}
+
+static void to_polar_batch(struct color *c, size_t count, uint8_t extra, uint8_t from, uint8_t to, conversion_func scalar)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+	for(; i + 2 <= count; i += 2)
+	{
+		assert(c[i].type == from && c[i + 1].type == from);
+
+		to_polar2(c + i, extra, to, scalar);
+	}
+
+	// an odd last color runs in both lanes, so it gets the same result it would in a pair.
+	if(i < count)
+	{
+		struct color pair[2];
+
+		assert(c[i].type == from);
+
+		pair[0] = c[i];
+		pair[1] = c[i];
+		to_polar2(pair, extra, to, scalar);
+		c[i] = pair[0];
+	}
+}
+
+static void from_polar2(struct color *p, uint8_t extra, uint8_t to, conversion_func scalar)
+{
+	__m128d L, C, h, sin_h, cos_h;
+	int bad;
+
+	load2(&L, &C, &h, p);
+
+	// also set for NaN. those lanes are reduced as well, but their results are not stored.
+	bad = _mm_movemask_pd(_mm_cmple_pd(abs_pd(h), _mm_set1_pd(POLAR_MAX_HUE))) ^ 3;
+	sincos_pd(&sin_h, &cos_h, h);
+
+	polar_store2(p, L, _mm_mul_pd(cos_h, C), _mm_mul_pd(sin_h, C), bad, extra, to, scalar);
+}
+
+static void from_polar_batch(struct color *c, size_t count, uint8_t extra, uint8_t from, uint8_t to, conversion_func scalar)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+	for(; i + 2 <= count; i += 2)
+	{
+		assert(c[i].type == from && c[i + 1].type == from);
+
+		from_polar2(c + i, extra, to, scalar);
+	}
+
+	if(i < count)
+	{
+		struct color pair[2];
+
+		assert(c[i].type == from);
+
+		pair[0] = c[i];
+		pair[1] = c[i];
+		from_polar2(pair, extra, to, scalar);
+		c[i] = pair[0];
+	}
+}
+
+#endif
+
 static void color_Lab_to_LCHab(struct color *c, uint8_t extra)
 {
-	double L, a, b;
+	double L, a, b, h;
 
 	assert(c != NULL);
 	assert(c->type == COLOR_LAB);
@@ -989,8 +1955,10 @@ static void color_Lab_to_LCHab(struct color *c, uint8_t extra)
 	b = c->Lab.b;
 
 	c->LCHab.L = L;
+	h = atan2(b, a);
+
 	c->LCHab.C = sqrt(a * a + b * b);
-	c->LCHab.h = atan2(b, a);
+	c->LCHab.h = h < 0.0 ? h + 6.2831853071795864769252867666 : h;
 	c->type = COLOR_LCHAB;
 }
 
@@ -1067,6 +2035,43 @@ static void color_Luv_to_XYZ(struct color *c, uint8_t extra)
 	c->type = COLOR_XYZ;
 }
 
+static void color_Luv_to_XYZ_batch(struct color *c, size_t count, uint8_t extra)
+{
+	size_t i = 0;
+
+	assert(c != NULL || count == 0);
+
+#ifdef COLOR_SSE2
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d L, u, v, y, y3, a, b, cc, x, third = _mm_set1_pd(1.0 / 3.0);
+
+		assert(c[i].type == COLOR_LUV && c[i + 1].type == COLOR_LUV);
+
+		load2(&L, &u, &v, c + i);
+
+		y3 = _mm_add_pd(_mm_mul_pd(L, _mm_set1_pd(1.0 / 116.0)), _mm_set1_pd(16.0 / 116.0));
+		y3 = _mm_mul_pd(_mm_mul_pd(y3, y3), y3);
+		y = select_pd(_mm_cmpgt_pd(L, _mm_set1_pd(8.0)), y3, _mm_mul_pd(L, _mm_set1_pd(27.0 / 24389.0)));
+
+		a = _mm_sub_pd(_mm_mul_pd(_mm_div_pd(L, _mm_add_pd(_mm_mul_pd(L, _mm_set1_pd(COLOR_REF_U13)), u)), _mm_set1_pd(52.0 / 3.0)), third);
+		b = _mm_mul_pd(_mm_set1_pd(5.0), y);
+		cc = _mm_mul_pd(_mm_sub_pd(_mm_mul_pd(_mm_div_pd(L, _mm_add_pd(_mm_mul_pd(L, _mm_set1_pd(COLOR_REF_V13)), v)), _mm_set1_pd(39.0)), _mm_set1_pd(5.0)), y);
+
+		x = _mm_div_pd(_mm_add_pd(cc, b), _mm_add_pd(a, third));
+
+		store2(c + i, x, y, _mm_sub_pd(_mm_mul_pd(x, a), b));
+		c[i].type = COLOR_XYZ;
+		c[i + 1].type = COLOR_XYZ;
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		color_Luv_to_XYZ(&c[i], extra);
+	}
+}
+
 static void color_Luv_to_LCHuv(struct color *c, uint8_t extra)
 {
 	assert(c != NULL);
@@ -1098,6 +2103,39 @@ static void color_LCHuv_to_Luv(struct color *c, uint8_t extra)
 	c->type = COLOR_LUV;
 }
 
+#ifdef COLOR_SSE2
+
+static void color_Lab_to_LCHab_batch(struct color *c, size_t count, uint8_t extra)
+{
+	to_polar_batch(c, count, extra, COLOR_LAB, COLOR_LCHAB, color_Lab_to_LCHab);
+}
+
+static void color_LCHab_to_Lab_batch(struct color *c, size_t count, uint8_t extra)
+{
+	from_polar_batch(c, count, extra, COLOR_LCHAB, COLOR_LAB, color_LCHab_to_Lab);
+}
+
+static void color_Luv_to_LCHuv_batch(struct color *c, size_t count, uint8_t extra)
+{
+	to_polar_batch(c, count, extra, COLOR_LUV, COLOR_LCHUV, color_Luv_to_LCHuv);
+}
+
+static void color_LCHuv_to_Luv_batch(struct color *c, size_t count, uint8_t extra)
+{
+	from_polar_batch(c, count, extra, COLOR_LCHUV, COLOR_LUV, color_LCHuv_to_Luv);
+}
+
+#else
+
+// without SSE2, polar conversions have no batch kernels.
+
+#define color_Lab_to_LCHab_batch NULL
+#define color_LCHab_to_Lab_batch NULL
+#define color_Luv_to_LCHuv_batch NULL
+#define color_LCHuv_to_Luv_batch NULL
+
+#endif
+
 static void color_LCHuv_to_LSHuv(struct color *c, uint8_t extra)
 {
 	double L, C, h;
@@ -1143,14 +2181,12 @@ static void color_LSHuv_to_LCHuv(struct color *c, uint8_t extra)
 	c->type = COLOR_LCHUV;
 }
 
-typedef void (*conversion_func)(struct color*, uint8_t);
-
 static struct color_descriptor
 {
 	char const *name;
 	void (*extract)(double*,struct color const*);
 	conversion_func conversions[COLOR_DUMMY_END - 1];
-	uint8_t proxy_conversions[COLOR_DUMMY_END - 1];
+	batch_conversion_func batch_conversions[COLOR_DUMMY_END - 1]; // optional, same results as conversions except for the polar kernels, see atan2_pd.
 } const g_descriptors[] =
 {
 	{
@@ -1163,22 +2199,9 @@ static struct color_descriptor
 			color_RGB8_to_LinearRGB // Linear RGB
 		},
 		{
-			COLOR_NONE, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_NONE, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_RGB, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_RGB, // YDbDr
-			COLOR_RGB, // YIQ
-			COLOR_LINEAR_RGB, // XYZ
-			COLOR_LINEAR_RGB, // xyY
-			COLOR_LINEAR_RGB, // Lab
-			COLOR_LINEAR_RGB, // Luv
-			COLOR_LINEAR_RGB, // LCHab
-			COLOR_LINEAR_RGB, // LCHuv
-			COLOR_LINEAR_RGB // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			color_RGB8_to_LinearRGB_batch // Linear RGB
 		}
 	},
 	{
@@ -1197,22 +2220,11 @@ static struct color_descriptor
 			color_RGB_to_YIQ
 		},
 		{
-			COLOR_NONE, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_NONE, // Linear RGB
-			COLOR_NONE, // HSL
-			COLOR_NONE, // HSV
-			COLOR_NONE, // YUV
-			COLOR_YUV, // YCbCr
-			COLOR_NONE, // YDbDr
-			COLOR_NONE, // YIQ
-			COLOR_LINEAR_RGB, // XYZ
-			COLOR_LINEAR_RGB, // xyY
-			COLOR_LINEAR_RGB, // Lab
-			COLOR_LINEAR_RGB, // Luv
-			COLOR_LINEAR_RGB, // LCHab
-			COLOR_LINEAR_RGB, // LCHuv
-			COLOR_LINEAR_RGB // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			color_RGB_to_HSL_batch, // HSL
+			color_RGB_to_HSV_batch // HSV
 		}
 	},
 	{
@@ -1234,22 +2246,7 @@ static struct color_descriptor
 			color_LinearRGB_to_Lab, // Lab
 		},
 		{
-			COLOR_NONE, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_NONE, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_RGB, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_RGB, // YDbDr
-			COLOR_RGB, // YIQ
-			COLOR_NONE, // XYZ
-			COLOR_XYZ, // xyY
-			COLOR_NONE, // Lab
-			COLOR_XYZ, // Luv
-			COLOR_LAB, // LCHab
-			COLOR_XYZ, // LCHuv
-			COLOR_XYZ // LSHuv
+			color_LinearRGB_to_RGB8_batch // RGB8
 		}
 	},
 	{
@@ -1261,22 +2258,8 @@ static struct color_descriptor
 			color_HSL_to_RGB // RGB
 		},
 		{
-			COLOR_RGB, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_RGB, // Linear RGB
-			COLOR_NONE, // HSL
-			COLOR_RGB, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_RGB, // YDbDr
-			COLOR_RGB, // YIQ
-			COLOR_RGB, // XYZ
-			COLOR_RGB, // xyY
-			COLOR_RGB, // Lab
-			COLOR_RGB, // Luv
-			COLOR_RGB, // LCHab
-			COLOR_RGB, // LCHuv
-			COLOR_RGB // LSHuv
+			NULL, // RGB8
+			color_HSL_to_RGB_batch // RGB
 		}
 	},
 	{
@@ -1288,22 +2271,8 @@ static struct color_descriptor
 			color_HSV_to_RGB // RGB
 		},
 		{
-			COLOR_RGB, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_RGB, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_NONE, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_RGB, // YDbDr
-			COLOR_RGB, // YIQ
-			COLOR_RGB, // XYZ
-			COLOR_RGB, // xyY
-			COLOR_RGB, // Lab
-			COLOR_RGB, // Luv
-			COLOR_RGB, // LCHab
-			COLOR_RGB, // LCHuv
-			COLOR_RGB // LSHuv
+			NULL, // RGB8
+			color_HSV_to_RGB_batch // RGB
 		}
 	},
 	{
@@ -1318,24 +2287,6 @@ static struct color_descriptor
 			NULL, // HSV
 			color_YUV_to_YUV, // YUV
 			color_YUV_to_YCbCr // YCbCr
-		},
-		{
-			COLOR_RGB, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_RGB, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_RGB, // HSV
-			COLOR_NONE, // YUV
-			COLOR_NONE, // YCbCr
-			COLOR_RGB, // YDbDr
-			COLOR_RGB, // YIQ
-			COLOR_RGB, // XYZ
-			COLOR_RGB, // xyY
-			COLOR_RGB, // Lab
-			COLOR_RGB, // Luv
-			COLOR_RGB, // LCHab
-			COLOR_RGB, // LCHuv
-			COLOR_RGB // LSHuv
 		}
 	},
 	{
@@ -1352,22 +2303,13 @@ static struct color_descriptor
 			color_YCbCr_to_YCbCr, // YCbCr
 		},
 		{
-			COLOR_YUV, // RGB8
-			COLOR_YUV, // RGB
-			COLOR_YUV, // Linear RGB
-			COLOR_YUV, // HSL
-			COLOR_YUV, // HSV
-			COLOR_NONE, // YUV
-			COLOR_NONE, // YCbCr
-			COLOR_YUV, // YDbDr
-			COLOR_YUV, // YIQ
-			COLOR_YUV, // XYZ
-			COLOR_YUV, // xyY
-			COLOR_YUV, // Lab
-			COLOR_YUV, // Luv
-			COLOR_YUV, // LCHab
-			COLOR_YUV, // LCHuv
-			COLOR_YUV // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			color_YCbCr_to_YCbCr_batch // YCbCr
 		}
 	},
 	{
@@ -1384,24 +2326,6 @@ static struct color_descriptor
 			NULL, // YCbCr
 			NULL, // YDbDr
 			color_YDbDr_to_YIQ
-		},
-		{
-			COLOR_RGB, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_RGB, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_RGB, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_NONE, // YDbDr
-			COLOR_NONE, // YIQ
-			COLOR_RGB, // XYZ
-			COLOR_RGB, // xyY
-			COLOR_RGB, // Lab
-			COLOR_RGB, // Luv
-			COLOR_RGB, // LCHab
-			COLOR_RGB, // LCHuv
-			COLOR_RGB // LSHuv
 		}
 	},
 	{
@@ -1417,24 +2341,6 @@ static struct color_descriptor
 			NULL, // YUV
 			NULL, // YCbCr
 			color_YIQ_to_YDbDr, // YDbDr
-		},
-		{
-			COLOR_RGB, // RGB8
-			COLOR_NONE, // RGB
-			COLOR_RGB, // Linear RGB
-			COLOR_RGB, // HSL
-			COLOR_RGB, // HSV
-			COLOR_RGB, // YUV
-			COLOR_RGB, // YCbCr
-			COLOR_NONE, // YDbDr
-			COLOR_NONE, // YIQ
-			COLOR_RGB, // XYZ
-			COLOR_RGB, // xyY
-			COLOR_RGB, // Lab
-			COLOR_RGB, // Luv
-			COLOR_RGB, // LCHab
-			COLOR_RGB, // LCHuv
-			COLOR_RGB // LSHuv
 		}
 	},
 	{
@@ -1457,22 +2363,19 @@ static struct color_descriptor
 			color_XYZ_to_Luv, // Luv
 		},
 		{
-			COLOR_LINEAR_RGB, // RGB8
-			COLOR_LINEAR_RGB, // RGB
-			COLOR_NONE, // Linear RGB
-			COLOR_LINEAR_RGB, // HSL
-			COLOR_LINEAR_RGB, // HSV
-			COLOR_LINEAR_RGB, // YUV
-			COLOR_LINEAR_RGB, // YCbCr
-			COLOR_LINEAR_RGB, // YDbDr
-			COLOR_LINEAR_RGB, // YIQ
-			COLOR_NONE, // XYZ
-			COLOR_NONE, // xyY
-			COLOR_NONE, // Lab
-			COLOR_NONE, // Luv
-			COLOR_LAB, // LCHab
-			COLOR_LUV, // LCHuv
-			COLOR_LUV // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			NULL, // XYZ
+			color_XYZ_to_xyY_batch, // xyY
+			NULL, // Lab
+			color_XYZ_to_Luv_batch // Luv
 		}
 	},
 	{
@@ -1492,22 +2395,16 @@ static struct color_descriptor
 			color_xyY_to_XYZ, // XYZ
 		},
 		{
-			COLOR_XYZ, // RGB8
-			COLOR_XYZ, // RGB
-			COLOR_XYZ, // Linear RGB
-			COLOR_XYZ, // HSL
-			COLOR_XYZ, // HSV
-			COLOR_XYZ, // YUV
-			COLOR_XYZ, // YCbCr
-			COLOR_XYZ, // YDbDr
-			COLOR_XYZ, // YIQ
-			COLOR_NONE, // XYZ
-			COLOR_NONE, // xyY
-			COLOR_XYZ, // Lab
-			COLOR_XYZ, // Luv
-			COLOR_XYZ, // LCHab
-			COLOR_XYZ, // LCHuv
-			COLOR_XYZ // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			color_xyY_to_XYZ_batch // XYZ
 		}
 	},
 	{
@@ -1531,22 +2428,20 @@ static struct color_descriptor
 			color_Lab_to_LCHab // LCHab
 		},
 		{
-			COLOR_LINEAR_RGB, // RGB8
-			COLOR_LINEAR_RGB, // RGB
-			COLOR_NONE, // Linear RGB
-			COLOR_LINEAR_RGB, // HSL
-			COLOR_LINEAR_RGB, // HSV
-			COLOR_LINEAR_RGB, // YUV
-			COLOR_LINEAR_RGB, // YCbCr
-			COLOR_LINEAR_RGB, // YDbDr
-			COLOR_LINEAR_RGB, // YIQ
-			COLOR_NONE, // XYZ
-			COLOR_XYZ, // xyY
-			COLOR_NONE, // Lab
-			COLOR_XYZ, // Luv
-			COLOR_NONE, // LCHab
-			COLOR_XYZ, // LCHuv
-			COLOR_XYZ // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			NULL, // XYZ
+			NULL, // xyY
+			NULL, // Lab
+			NULL, // Luv
+			color_Lab_to_LCHab_batch // LCHab
 		}
 	},
 	{
@@ -1571,22 +2466,21 @@ static struct color_descriptor
 			color_Luv_to_LCHuv // LCHuv
 		},
 		{
-			COLOR_XYZ, // RGB8
-			COLOR_XYZ, // RGB
-			COLOR_XYZ, // Linear RGB
-			COLOR_XYZ, // HSL
-			COLOR_XYZ, // HSV
-			COLOR_XYZ, // YUV
-			COLOR_XYZ, // YCbCr
-			COLOR_XYZ, // YDbDr
-			COLOR_XYZ, // YIQ
-			COLOR_NONE, // XYZ
-			COLOR_XYZ, // xyY
-			COLOR_XYZ, // Lab
-			COLOR_NONE, // Luv
-			COLOR_XYZ, // LCHab
-			COLOR_NONE, // LCHuv
-			COLOR_LCHUV // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			color_Luv_to_XYZ_batch, // XYZ
+			NULL, // xyY
+			NULL, // Lab
+			NULL, // Luv
+			NULL, // LCHab
+			color_Luv_to_LCHuv_batch // LCHuv
 		}
 	},
 	{
@@ -1608,22 +2502,18 @@ static struct color_descriptor
 			color_LCHab_to_Lab // Lab
 		},
 		{
-			COLOR_LAB, // RGB8
-			COLOR_LAB, // RGB
-			COLOR_LAB, // Linear RGB
-			COLOR_LAB, // HSL
-			COLOR_LAB, // HSV
-			COLOR_LAB, // YUV
-			COLOR_LAB, // YCbCr
-			COLOR_LAB, // YDbDr
-			COLOR_LAB, // YIQ
-			COLOR_LAB, // XYZ
-			COLOR_LAB, // xyY
-			COLOR_NONE, // Lab
-			COLOR_LAB, // Luv
-			COLOR_NONE, // LCHab
-			COLOR_LAB, // LCHuv
-			COLOR_LAB // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			NULL, // XYZ
+			NULL, // xyY
+			color_LCHab_to_Lab_batch // Lab
 		}
 	},
 	{
@@ -1649,22 +2539,19 @@ static struct color_descriptor
 			color_LCHuv_to_LSHuv // LSHuv
 		},
 		{
-			COLOR_LUV, // RGB8
-			COLOR_LUV, // RGB
-			COLOR_LUV, // Linear RGB
-			COLOR_LUV, // HSL
-			COLOR_LUV, // HSV
-			COLOR_LUV, // YUV
-			COLOR_LUV, // YCbCr
-			COLOR_LUV, // YDbDr
-			COLOR_LUV, // YIQ
-			COLOR_LUV, // XYZ
-			COLOR_LUV, // xyY
-			COLOR_LUV, // Lab
-			COLOR_NONE, // Luv
-			COLOR_LUV, // LCHab
-			COLOR_NONE, // LCHuv
-			COLOR_NONE // LSHuv
+			NULL, // RGB8
+			NULL, // RGB
+			NULL, // Linear RGB
+			NULL, // HSL
+			NULL, // HSV
+			NULL, // YUV
+			NULL, // YCbCr
+			NULL, // YDbDr
+			NULL, // YIQ
+			NULL, // XYZ
+			NULL, // xyY
+			NULL, // Lab
+			color_LCHuv_to_Luv_batch // Luv
 		}
 	},
 	{
@@ -1687,32 +2574,174 @@ static struct color_descriptor
 			NULL, // Luv
 			NULL, // LCHab
 			color_LSHuv_to_LCHuv, // LCHuv
-		},
-		{
-			COLOR_LCHUV, // RGB8
-			COLOR_LCHUV, // RGB
-			COLOR_LCHUV, // Linear RGB
-			COLOR_LCHUV, // HSL
-			COLOR_LCHUV, // HSV
-			COLOR_LCHUV, // YUV
-			COLOR_LCHUV, // YCbCr
-			COLOR_LCHUV, // YDbDr
-			COLOR_LCHUV, // YIQ
-			COLOR_LCHUV, // XYZ
-			COLOR_LCHUV, // xyY
-			COLOR_LCHUV, // Lab
-			COLOR_LCHUV, // Luv
-			COLOR_LCHUV, // LCHab
-			COLOR_NONE, // LCHuv
-			COLOR_NONE // LSHuv
 		}
 	}
 };
 
-void COLOR_CALL color_convert(struct color *c, enum color_type new_type, uint8_t new_extra)
+// measured cost of each conversion, from color_costs.h.
+
+static struct edge_cost
+{
+	uint8_t from, to;
+	uint16_t cost;
+} const g_edge_costs[] =
+{
+#define COLOR_EDGE_COST(from, to, cost) { from, to, cost },
+#include "color_costs.h"
+};
+
+static uint32_t const step_cost = COLOR_STEP_COST;
+
+static uint8_t g_routes[COLOR_DUMMY_END - 1][COLOR_DUMMY_END - 1]; // next type on the way from -> to.
+static uint32_t g_route_costs[COLOR_DUMMY_END - 1][COLOR_DUMMY_END - 1];
+static long volatile g_routes_state;
+
+// the cost of a conversion, including step_cost, or 0 when color_costs.h doesn't list it.
+
+static uint32_t edge_cost(int from, int to)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof g_edge_costs / sizeof g_edge_costs[0]; ++i)
+	{
+		if(g_edge_costs[i].from == from && g_edge_costs[i].to == to)
+		{
+			return g_edge_costs[i].cost + step_cost;
+		}
+	}
+
+	return 0;
+}
+
+// finds the cheapest route from every type to every other with Dijkstra's
+// algorithm, over the conversions in g_descriptors. RGB8 and YCbCr quantize,
+// so a route may start or end on them but never pass through them.
+
+static void color_routes_build(void)
+{
+	int from, to, i;
+
+	for(from = 1; from < COLOR_DUMMY_END; ++from)
+	{
+		uint32_t dist[COLOR_DUMMY_END], hops[COLOR_DUMMY_END];
+		uint8_t first[COLOR_DUMMY_END], done[COLOR_DUMMY_END];
+
+		for(i = 1; i < COLOR_DUMMY_END; ++i)
+		{
+			dist[i] = UINT32_MAX;
+			hops[i] = UINT32_MAX;
+			first[i] = COLOR_NONE;
+			done[i] = 0;
+		}
+
+		dist[from] = 0;
+		hops[from] = 0;
+
+		for(;;)
+		{
+			int cur = COLOR_NONE;
+
+			// ties go to the route with fewer steps, then to the lower type.
+
+			for(i = 1; i < COLOR_DUMMY_END; ++i)
+			{
+				if(!done[i] && dist[i] != UINT32_MAX &&
+					(cur == COLOR_NONE || dist[i] < dist[cur] || (dist[i] == dist[cur] && hops[i] < hops[cur])))
+				{
+					cur = i;
+				}
+			}
+
+			if(cur == COLOR_NONE)
+			{
+				break;
+			}
+
+			done[cur] = 1;
+
+			if(cur != from && (cur == COLOR_RGB8 || cur == COLOR_YCBCR))
+			{
+				continue;
+			}
+
+			for(to = 1; to < COLOR_DUMMY_END; ++to)
+			{
+				uint32_t cost, d;
+
+				if(to == cur || !g_descriptors[cur - 1].conversions[to - 1] || done[to])
+				{
+					continue;
+				}
+
+				cost = edge_cost(cur, to);
+
+				// every conversion needs a line in color_costs.h, or color.hpp would route differently.
+				assert(cost != 0);
+
+				d = dist[cur] + (cost ? cost : COLOR_DEFAULT_EDGE_COST + step_cost);
+
+				if(d < dist[to] || (d == dist[to] && hops[cur] + 1 < hops[to]))
+				{
+					dist[to] = d;
+					hops[to] = hops[cur] + 1;
+					first[to] = cur == from ? (uint8_t)to : first[cur];
+				}
+			}
+		}
+
+		for(to = 1; to < COLOR_DUMMY_END; ++to)
+		{
+			assert(to == from || first[to] != COLOR_NONE);
+
+			g_routes[from - 1][to - 1] = to == from ? (uint8_t)to : first[to];
+			g_route_costs[from - 1][to - 1] = dist[to];
+		}
+	}
+}
+
+static void color_routes_init(void)
+{
+	color_call_once(&g_routes_state, color_routes_build);
+}
+
+static conversion_func color_next_step(enum color_type type, enum color_type new_type, enum color_type *tmp_type, batch_conversion_func *batch)
 {
 	struct color_descriptor const *desc;
+	conversion_func func;
 
+	assert(type > COLOR_NONE);
+	assert(type < COLOR_DUMMY_END);
+
+	desc = &g_descriptors[type - 1];
+
+	// same type, different extra: only YUV and YCbCr have these.
+
+	if(type == new_type)
+	{
+		*tmp_type = new_type;
+	}
+	else
+	{
+		color_routes_init();
+		*tmp_type = (enum color_type)g_routes[type - 1][new_type - 1];
+	}
+
+	assert(*tmp_type > COLOR_NONE);
+	assert(*tmp_type < COLOR_DUMMY_END);
+
+	func = desc->conversions[*tmp_type - 1];
+	assert(func != NULL);
+
+	if(batch)
+	{
+		*batch = desc->batch_conversions[*tmp_type - 1];
+	}
+
+	return func;
+}
+
+void COLOR_CALL color_convert(struct color *c, enum color_type new_type, uint8_t new_extra)
+{
 	assert(c != NULL);
 	assert(new_type > COLOR_NONE);
 	assert(new_type < COLOR_DUMMY_END);
@@ -1722,25 +2751,19 @@ void COLOR_CALL color_convert(struct color *c, enum color_type new_type, uint8_t
 		conversion_func func;
 		enum color_type tmp_type;
 
-		assert(c->type > COLOR_NONE);
-		assert(c->type < COLOR_DUMMY_END);
-
-		desc = &g_descriptors[c->type - 1];
-		func = desc->conversions[new_type - 1];
-		tmp_type = new_type;
+		func = color_next_step((enum color_type)c->type, new_type, &tmp_type, NULL);
 
-		if(!func)
+#ifdef COLOR_INSTRUMENT
 		{
-			tmp_type = (enum color_type)desc->proxy_conversions[new_type - 1];
-
-			assert(tmp_type > COLOR_NONE);
-			assert(tmp_type < COLOR_DUMMY_END);
+			struct color_edge_stats *edge = color_instrument_edge(c->type, tmp_type);
+			uint64_t start = color_instrument_begin(edge);
 
-			func = desc->conversions[tmp_type - 1];
-			assert(func != NULL);
+			func(c, new_extra);
+			color_instrument_end(edge, start, 1);
 		}
-
+#else
 		func(c, new_extra);
+#endif
 
 		assert(c->type == tmp_type);
 	}
@@ -1765,3 +2788,207 @@ COLOR_EXPORT void COLOR_CALL color_extract_components(double *dst, struct color
 
 	g_descriptors[src->type - 1].extract(dst, src);
 }
+
+COLOR_EXPORT enum color_type COLOR_CALL color_route_next(enum color_type from, enum color_type to)
+{
+	assert(from > COLOR_NONE);
+	assert(from < COLOR_DUMMY_END);
+	assert(to > COLOR_NONE);
+	assert(to < COLOR_DUMMY_END);
+
+	color_routes_init();
+	return (enum color_type)g_routes[from - 1][to - 1];
+}
+
+COLOR_EXPORT double COLOR_CALL color_route_cost(enum color_type from, enum color_type to)
+{
+	assert(from > COLOR_NONE);
+	assert(from < COLOR_DUMMY_END);
+	assert(to > COLOR_NONE);
+	assert(to < COLOR_DUMMY_END);
+
+	color_routes_init();
+	return g_route_costs[from - 1][to - 1] * 0.1;
+}
+
+COLOR_EXPORT void COLOR_CALL color_set_components(struct color *dst, enum color_type type, uint8_t extra, double const *src)
+{
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(type > COLOR_NONE);
+	assert(type < COLOR_DUMMY_END);
+
+	dst->type = (uint8_t)type;
+	dst->extra = extra;
+
+	if(type == COLOR_RGB8 || type == COLOR_YCBCR)
+	{
+		int i;
+
+		for(i = 0; i < 3; ++i)
+		{
+			double v = src[i] + 0.5;
+			(&dst->RGB8.R)[i] = v < 0.0 ? 0 : v > 255.0 ? 255 : (uint8_t)v;
+		}
+
+		return;
+	}
+
+	// every other type is three doubles, in the same order color_extract_components gives them.
+
+	dst->RGB.R = src[0];
+	dst->RGB.G = src[1];
+	dst->RGB.B = src[2];
+}
+
+COLOR_EXPORT void COLOR_CALL color_component_range(double *lo, double *hi, enum color_type type)
+{
+	// nominal extents of colors inside the sRGB gamut. hues are given as produced
+	// by the conversions: HSL/HSV in [0, 6), polar hues in [0, pi*2).
+
+	static double const ranges[][6] =
+	{
+		{ 0.0, 0.0, 0.0, 256.0, 256.0, 256.0 }, // RGB8
+		{ 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 }, // RGB
+		{ 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 }, // Linear RGB
+		{ 0.0, 0.0, 0.0, 6.0, 1.0, 1.0 }, // HSL
+		{ 0.0, 0.0, 0.0, 6.0, 1.0, 1.0 }, // HSV
+		{ 0.0, -0.436, -0.615, 1.0, 0.436, 0.615 }, // YUV
+		{ 0.0, 0.0, 0.0, 256.0, 256.0, 256.0 }, // YCbCr
+		{ 0.0, -1.333, -1.333, 1.0, 1.333, 1.333 }, // YDbDr
+		{ 0.0, -0.5957, -0.5226, 1.0, 0.5957, 0.5226 }, // YIQ
+		{ 0.0, 0.0, 0.0, 31271.0/32902.0, 1.0, 35827.0/32902.0 }, // XYZ
+		{ 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 }, // xyY
+		{ 0.0, -128.0, -128.0, 100.0, 128.0, 128.0 }, // Lab
+		{ 0.0, -100.0, -140.0, 100.0, 180.0, 110.0 }, // Luv
+		{ 0.0, 0.0, 0.0, 100.0, 140.0, 6.2831853071795864769252867666 }, // LCHab
+		{ 0.0, 0.0, 0.0, 100.0, 180.0, 6.2831853071795864769252867666 }, // LCHuv
+		{ 0.0, 0.0, 0.0, 100.0, 5.0, 6.2831853071795864769252867666 } // LSHuv
+	};
+
+	double const *r;
+
+	assert(lo != NULL);
+	assert(hi != NULL);
+	assert(type > COLOR_NONE);
+	assert(type < COLOR_DUMMY_END);
+
+	r = ranges[type - 1];
+
+	lo[0] = r[0]; lo[1] = r[1]; lo[2] = r[2];
+	hi[0] = r[3]; hi[1] = r[4]; hi[2] = r[5];
+}
+
+COLOR_EXPORT void COLOR_CALL color_plan_init(struct color_plan *plan, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra)
+{
+	struct color c;
+
+	assert(plan != NULL);
+	assert(from > COLOR_NONE);
+	assert(from < COLOR_DUMMY_END);
+	assert(to > COLOR_NONE);
+	assert(to < COLOR_DUMMY_END);
+
+	plan->src_type = (uint8_t)from;
+	plan->src_extra = from_extra;
+	plan->dst_type = (uint8_t)to;
+	plan->dst_extra = to_extra;
+	plan->count = 0;
+	plan->route[0] = (uint8_t)from;
+
+	// the route only depends on type and extra, never on the components, so it
+	// is found by running a black placeholder through color_convert's walk.
+
+	memset(&c, 0, sizeof c);
+	c.type = (uint8_t)from;
+	c.extra = from_extra;
+
+	while(c.type != to || c.extra != to_extra)
+	{
+		conversion_func func;
+		batch_conversion_func batch;
+		enum color_type tmp_type;
+
+		func = color_next_step((enum color_type)c.type, to, &tmp_type, &batch);
+		func(&c, to_extra);
+
+		assert(c.type == tmp_type);
+		assert(plan->count < COLOR_PLAN_MAX_STEPS);
+
+		plan->steps[plan->count] = func;
+		plan->batch[plan->count] = batch;
+		plan->route[++plan->count] = c.type;
+	}
+}
+
+COLOR_EXPORT void COLOR_CALL color_plan_execute(struct color_plan const *plan, struct color *c, size_t count)
+{
+	size_t i, j, n;
+	unsigned s;
+
+	assert(plan != NULL);
+	assert(c != NULL || count == 0);
+
+	// each step is run over a chunk before moving to the next, so the indirect
+	// call is predictable and the chunk stays in cache between steps.
+
+	for(i = 0; i < count; i += n)
+	{
+		n = count - i < COLOR_CHUNK ? count - i : COLOR_CHUNK;
+
+		for(s = 0; s < plan->count; ++s)
+		{
+			conversion_func func = plan->steps[s];
+
+#ifdef COLOR_INSTRUMENT
+			struct color_edge_stats *edge = color_instrument_edge(plan->route[s], plan->route[s + 1]);
+			uint64_t start = color_instrument_begin(edge);
+#endif
+
+			if(plan->batch[s])
+			{
+				plan->batch[s](c + i, n, plan->dst_extra);
+			}
+			else
+			{
+				for(j = 0; j < n; ++j)
+				{
+					assert(s != 0 || (c[i + j].type == plan->src_type && c[i + j].extra == plan->src_extra));
+					func(&c[i + j], plan->dst_extra);
+				}
+			}
+
+#ifdef COLOR_INSTRUMENT
+			color_instrument_end(edge, start, n);
+#endif
+		}
+	}
+}
+
+void color_call_once_slow(long volatile *state, void (*init)(void))
+{
+	// 0: not started, 1: running, 2: done.
+
+#ifdef _MSC_VER
+	if(_InterlockedCompareExchange(state, 1, 0) == 0)
+	{
+		init();
+		_InterlockedExchange(state, 2);
+	}
+#else
+	long expected = 0;
+
+	if(__atomic_compare_exchange_n(state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		init();
+		// a release store, so the tables init wrote are visible before state reads 2.
+		__atomic_store_n(state, 2, __ATOMIC_RELEASE);
+	}
+#endif
+
+	// init is short, so waiters spin, but politely.
+	while(color_load_acquire(state) != 2)
+	{
+		color_pause();
+	}
+}
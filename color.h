@@ -25,19 +25,26 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
-#ifdef COLOR_STATIC
+#if defined(COLOR_STATIC)
 #define COLOR_EXPORT
-#else
+#elif defined(_WIN32)
 #ifdef COLOR_EXPORTS
 #define COLOR_EXPORT __declspec(dllexport)
 #else
 #define COLOR_EXPORT __declspec(dllimport)
 #endif
+#else
+#define COLOR_EXPORT __attribute__((visibility("default")))
 #endif
 
-#define COLOR_CALL _cdecl
+#ifdef _WIN32
+#define COLOR_CALL __cdecl
+#else
+#define COLOR_CALL
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -98,9 +105,206 @@ struct color
 	};
 };
 
+#define COLOR_PLAN_MAX_STEPS 8
+
+// a conversion route resolved once, for converting many colors of the same type and extra.
+struct color_plan
+{
+	uint8_t src_type, src_extra;
+	uint8_t dst_type, dst_extra;
+	uint8_t count;
+	uint8_t route[COLOR_PLAN_MAX_STEPS + 1]; // type before the first step and after each step.
+	void (*steps[COLOR_PLAN_MAX_STEPS])(struct color*, uint8_t);
+	void (*batch[COLOR_PLAN_MAX_STEPS])(struct color*, size_t, uint8_t); // NULL where a step has no batch kernel.
+};
+
+// packed storage, for arrays where struct color would be mostly padding. type and extra are
+// not stored: they come from the plan the colors are converted with. c[3] is padding, written as 0.
+struct color_packed8 { uint8_t c[4]; }; // COLOR_RGB8 and COLOR_YCBCR.
+struct color_packed24 { uint8_t c[3]; }; // COLOR_RGB8 and COLOR_YCBCR, without padding, as in raw image files.
+struct color_packedf { float c[4]; }; // any other type.
+struct color_packedh { uint16_t c[4]; }; // any other type, as IEEE 754 half floats.
+struct color_packedlab16 { uint16_t c[3]; }; // COLOR_LAB in ICC's 16-bit encoding: L * 655.35, (a + 128) * 257, (b + 128) * 257.
+
+enum color_format
+{
+	COLOR_FORMAT_COLOR, // struct color
+	COLOR_FORMAT_PACKED8, // struct color_packed8
+	COLOR_FORMAT_FLOAT, // struct color_packedf
+	COLOR_FORMAT_HALF, // struct color_packedh
+	COLOR_FORMAT_PACKED24, // struct color_packed24
+	COLOR_FORMAT_LAB16 // struct color_packedlab16
+};
+
+// a view over a 2D array of colors. stride is in colors, and is >= width.
+struct color_image
+{
+	struct color *pixels;
+	size_t width, height, stride;
+};
+
+// a rectangle of pixels in a struct color_image.
+struct color_rect
+{
+	size_t x, y, width, height;
+};
+
+enum color_dither
+{
+	COLOR_DITHER_ORDERED, // 8x8 Bayer matrix.
+	COLOR_DITHER_BLUE_NOISE, // 32x32 blue noise mask.
+	COLOR_DITHER_FLOYD_STEINBERG, // error diffusion, rows run in parallel as a wavefront.
+	COLOR_DITHER_FLOYD_STEINBERG_SERPENTINE // error diffusion, alternating row direction. single-threaded.
+};
+
+enum color_hue_mode
+{
+	COLOR_HUE_SHORTER,
+	COLOR_HUE_LONGER,
+	COLOR_HUE_INCREASING,
+	COLOR_HUE_DECREASING
+};
+
+// per-edge counters, collected only when the library is built with COLOR_INSTRUMENT.
+// cycles are sampled on some calls; cycles / sampled_colors estimates the cost per color.
+struct color_edge_stats
+{
+	uint64_t calls, colors;
+	uint64_t cycles, sampled_colors;
+};
+
+// the one component color_rgb8_luma computes.
+enum color_luma
+{
+	COLOR_LUMA_Y, // Y' of COLOR_YUV, in the matrix given by extra.
+	COLOR_LUMA_LUMINANCE, // Y of COLOR_XYZ.
+	COLOR_LUMA_LIGHTNESS // L of COLOR_LAB.
+};
+
+enum color_filter
+{
+	COLOR_FILTER_BOX,
+	COLOR_FILTER_BILINEAR,
+	COLOR_FILTER_LANCZOS3
+};
+
+struct color_stats
+{
+	// in: histogram layout. histogram holds bins * 3 counters, component-major, and may be NULL.
+	// values outside of [lo, hi) are counted in the edge bins.
+	unsigned bins;
+	double lo[3], hi[3];
+	uint64_t *histogram;
+
+	// out: population mean/variance, and extents.
+	uint64_t count;
+	double mean[3], variance[3];
+	double min[3], max[3];
+};
+
+// sRGB transfer tables: RGB8 -> linear for every 8-bit value, correctly rounded on every platform, and the
+// smallest linear value that encodes to each.
+COLOR_EXPORT extern double const color_rgb8_linear_tbl[256];
+COLOR_EXPORT extern double const color_linear_rgb8_thresholds[256];
+
 COLOR_EXPORT void COLOR_CALL color_convert(struct color *c, enum color_type new_type, uint8_t new_extra);
 COLOR_EXPORT char const* COLOR_CALL color_name(enum color_type type);
 COLOR_EXPORT void COLOR_CALL color_extract_components(double *dst, struct color const *src);
+// the conversion router. routes are the cheapest by measured cost, and are found on first use.
+// color_route_next gives the next type on the way from -> to; color_route_cost the estimated ns per color.
+COLOR_EXPORT enum color_type COLOR_CALL color_route_next(enum color_type from, enum color_type to);
+COLOR_EXPORT double COLOR_CALL color_route_cost(enum color_type from, enum color_type to);
+
+COLOR_EXPORT void COLOR_CALL color_set_components(struct color *dst, enum color_type type, uint8_t extra, double const *src);
+COLOR_EXPORT void COLOR_CALL color_component_range(double *lo, double *hi, enum color_type type);
+
+COLOR_EXPORT void COLOR_CALL color_plan_init(struct color_plan *plan, enum color_type from, uint8_t from_extra, enum color_type to, uint8_t to_extra);
+COLOR_EXPORT void COLOR_CALL color_plan_execute(struct color_plan const *plan, struct color *c, size_t count);
+// converts count colors of any mix of types and extras in place, each as a plan from its own type and
+// extra would. returns 0 when out of memory, leaving c untouched.
+COLOR_EXPORT int COLOR_CALL color_convert_mixed(struct color *c, size_t count, enum color_type to, uint8_t to_extra);
+
+// the size in bytes of one color stored in format.
+COLOR_EXPORT size_t COLOR_CALL color_format_size(enum color_format format);
+
+// runs a plan from src, holding colors of the plan's source type, to dst. src and dst may be the same
+// buffer when both formats have the same size. converts in parallel when count is large.
+COLOR_EXPORT void COLOR_CALL color_plan_execute_packed(struct color_plan const *plan, void *dst, enum color_format dst_format, void const *src, enum color_format src_format, size_t count);
+
+// changes count 8-bit YCbCr colors between limited and full range, keeping the matrix, by per-channel
+// tables with the same rounding as color_convert. format is COLOR_FORMAT_PACKED8 or COLOR_FORMAT_PACKED24.
+// dst may be src.
+COLOR_EXPORT void COLOR_CALL color_ycbcr_range(void *dst, void const *src, enum color_format format, size_t count, int to_full);
+// color_ycbcr_convert also changes the matrix, by one affine map in fixed point. results can differ
+// from color_convert's by one code value where it rounds near a half; check.c counts them.
+COLOR_EXPORT void COLOR_CALL color_ycbcr_convert(void *dst, void const *src, enum color_format format, size_t count, uint8_t from_extra, uint8_t to_extra);
+
+// writes one component of count RGB8 colors to dst, for grayscale: the same value as converting the
+// colors to YUV, XYZ or Lab and keeping that component, without computing the other two.
+// src_format is COLOR_FORMAT_COLOR, COLOR_FORMAT_PACKED8 or COLOR_FORMAT_PACKED24.
+COLOR_EXPORT void COLOR_CALL color_rgb8_luma(double *dst, void const *src, enum color_format src_format, size_t count, enum color_luma luma, uint8_t extra);
+
+// 8-bit HSV and Lab as OpenCV stores them: H is the hue in degrees / 2, in [0, 180), S and V are scaled
+// to 255, L is scaled to 255 and a, b are offset by 128. converted in integers, within one code value of
+// color_convert's result rounded; check.c counts the differences. H from 180 up wraps around.
+// format is COLOR_FORMAT_PACKED8 or COLOR_FORMAT_PACKED24 on both sides, and dst may be src.
+COLOR_EXPORT void COLOR_CALL color_rgb8_to_hsv8(void *dst, void const *src, enum color_format format, size_t count);
+COLOR_EXPORT void COLOR_CALL color_hsv8_to_rgb8(void *dst, void const *src, enum color_format format, size_t count);
+COLOR_EXPORT void COLOR_CALL color_rgb8_to_lab8(void *dst, void const *src, enum color_format format, size_t count);
+COLOR_EXPORT void COLOR_CALL color_lab8_to_rgb8(void *dst, void const *src, enum color_format format, size_t count);
+
+// converts the file at src_path, a headerless array of colors in src_format, to a new file at dst_path.
+// both files are memory mapped a window at a time, and each window is converted in parallel. the
+// source size must be a whole number of colors. returns 0 when a file can't be opened, sized or mapped,
+// or when both paths name the same file. a failure removes dst_path if the call created it or had
+// started to overwrite it; a destination that existed before is otherwise left untouched.
+COLOR_EXPORT int COLOR_CALL color_convert_file(char const *dst_path, enum color_format dst_format, char const *src_path, enum color_format src_format, struct color_plan const *plan);
+
+// converts each pixel of img to type/extra, leaving img untouched, and fills the out fields of stats
+// with the mean, population variance, minimum and maximum of each component. when stats->histogram is
+// not NULL, it receives bins counters for each component, component-major, each component's [lo, hi)
+// split evenly; values outside it are counted in the edge bins. all pixels must share the type and
+// extra of pixels[0]. an empty image gives a count, mean and variance of 0, a minimum of HUGE_VAL and
+// a maximum of -HUGE_VAL, and an all-zero histogram. returns 0 when out of memory.
+COLOR_EXPORT int COLOR_CALL color_image_stats(struct color_stats *stats, struct color_image const *img, enum color_type type, uint8_t extra);
+
+// converts part of img in place through one plan, leaving the rest untouched. the
+// converted pixels must share one type and extra; only asserts check it, and a release build
+// silently misconverts pixels of another. mask holds a bit per pixel, least significant bit
+// first, with rows mask_stride bytes apart. rects may overlap, and each pixel inside any is converted once.
+// color_image_convert_rects returns 0 when out of memory, with nothing converted.
+COLOR_EXPORT void COLOR_CALL color_image_convert_masked(struct color_image const *img, uint8_t const *mask, size_t mask_stride, enum color_type new_type, uint8_t new_extra);
+COLOR_EXPORT int COLOR_CALL color_image_convert_rects(struct color_image const *img, struct color_rect const *rects, size_t count, enum color_type new_type, uint8_t new_extra);
+
+// builds a palette of at most *colors (<= 256) colors in space, which is COLOR_LAB or COLOR_LINEAR_RGB.
+// *colors receives the palette size. indices may be NULL, or receive width * height palette indices.
+// k-means stops after max_iterations, or once no palette entry moves further than threshold.
+COLOR_EXPORT int COLOR_CALL color_quantize(struct color *palette, unsigned *colors, uint8_t *indices, struct color_image const *img, enum color_type space, unsigned max_iterations, double threshold);
+
+// dithering is done in linear light. color_dither_rgb8 converts img to COLOR_RGB8 in place.
+// color_dither_palette leaves img untouched and writes width * height palette indices.
+COLOR_EXPORT int COLOR_CALL color_dither_rgb8(struct color_image const *img, enum color_dither method);
+COLOR_EXPORT int COLOR_CALL color_dither_palette(uint8_t *indices, struct color_image const *img, struct color const *palette, unsigned colors, enum color_dither method);
+
+// resampling and compositing of COLOR_RGB8 images, done in linear light.
+// color_blend_over_rgb8 puts src over dst using one straight alpha value per pixel.
+COLOR_EXPORT int COLOR_CALL color_resample_rgb8(struct color_image const *dst, struct color_image const *src, enum color_filter filter);
+COLOR_EXPORT void COLOR_CALL color_blend_over_rgb8(struct color_image const *dst, struct color_image const *src, uint8_t const *alpha, size_t alpha_stride);
+
+// fills dst, in dst_format, with samples evenly spaced across the stops, interpolated in space and
+// converted to out_type/out_extra. COLOR_FORMAT_PACKED8 or PACKED24 write RGB8 straight into a pixel
+// buffer. positions may be NULL for evenly spaced stops, or give an increasing position in [0, 1]
+// for each stop. hue_mode applies to the hue of HSL, HSV, LCHab, LCHuv and LSHuv.
+COLOR_EXPORT int COLOR_CALL color_gradient(void *dst, enum color_format dst_format, size_t samples, struct color const *stops, double const *positions, size_t count,
+	enum color_type space, enum color_hue_mode hue_mode, enum color_type out_type, uint8_t out_extra);
+
+// instrumentation. dst receives (COLOR_DUMMY_END - 1)^2 edges, indexed by [(from - 1) * (COLOR_DUMMY_END - 1) + to - 1].
+// counts from all threads are summed; they are approximate while other threads are converting.
+// color_instrument_format writes a text table of the non-empty edges, and returns the length it needed.
+COLOR_EXPORT int COLOR_CALL color_instrument_enabled(void);
+COLOR_EXPORT void COLOR_CALL color_instrument_snapshot(struct color_edge_stats *dst);
+COLOR_EXPORT void COLOR_CALL color_instrument_reset(void);
+COLOR_EXPORT size_t COLOR_CALL color_instrument_format(char *dst, size_t size);
 
 #ifdef __cplusplus
 }
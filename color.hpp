@@ -0,0 +1,1110 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	C++17 interface. Routes are resolved at compile time with the same costs and
+	tie-breaking as the C router, so convert<From, To> inlines to straight-line
+	code and gives the same results as color_convert.
+
+	The namespace is "colors" because "color" is taken by struct color.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "color.h"
+#include "color_matrix.hpp"
+
+namespace colors
+{
+
+struct RGB8 { static constexpr color_type type = COLOR_RGB8; uint8_t R, G, B; };
+struct RGB { static constexpr color_type type = COLOR_RGB; double R, G, B; };
+struct LinearRGB { static constexpr color_type type = COLOR_LINEAR_RGB; double R, G, B; };
+struct HSL { static constexpr color_type type = COLOR_HSL; double H, S, L; }; // hue is in [0, 6)
+struct HSV { static constexpr color_type type = COLOR_HSV; double H, S, V; }; // hue is in [0, 6)
+struct YUV { static constexpr color_type type = COLOR_YUV; double Y, U, V; };
+struct YCbCr { static constexpr color_type type = COLOR_YCBCR; uint8_t Y, Cb, Cr; };
+struct YDbDr { static constexpr color_type type = COLOR_YDBDR; double Y, Db, Dr; };
+struct YIQ { static constexpr color_type type = COLOR_YIQ; double Y, I, Q; };
+struct XYZ { static constexpr color_type type = COLOR_XYZ; double X, Y, Z; };
+struct xyY { static constexpr color_type type = COLOR_XYY; double x, y, Y; };
+struct Lab { static constexpr color_type type = COLOR_LAB; double L, a, b; };
+struct Luv { static constexpr color_type type = COLOR_LUV; double L, u, v; };
+struct LCHab { static constexpr color_type type = COLOR_LCHAB; double L, C, h; }; // hue is in [0, pi*2)
+struct LCHuv { static constexpr color_type type = COLOR_LCHUV; double L, C, h; }; // hue is in [0, pi*2)
+struct LSHuv { static constexpr color_type type = COLOR_LSHUV; double L, S, h; }; // hue is in [0, pi*2)
+
+namespace detail
+{
+
+template<color_type T> struct by_type;
+template<> struct by_type<COLOR_RGB8> { typedef RGB8 type; };
+template<> struct by_type<COLOR_RGB> { typedef RGB type; };
+template<> struct by_type<COLOR_LINEAR_RGB> { typedef LinearRGB type; };
+template<> struct by_type<COLOR_HSL> { typedef HSL type; };
+template<> struct by_type<COLOR_HSV> { typedef HSV type; };
+template<> struct by_type<COLOR_YUV> { typedef YUV type; };
+template<> struct by_type<COLOR_YCBCR> { typedef YCbCr type; };
+template<> struct by_type<COLOR_YDBDR> { typedef YDbDr type; };
+template<> struct by_type<COLOR_YIQ> { typedef YIQ type; };
+template<> struct by_type<COLOR_XYZ> { typedef XYZ type; };
+template<> struct by_type<COLOR_XYY> { typedef xyY type; };
+template<> struct by_type<COLOR_LAB> { typedef Lab type; };
+template<> struct by_type<COLOR_LUV> { typedef Luv type; };
+template<> struct by_type<COLOR_LCHAB> { typedef LCHab type; };
+template<> struct by_type<COLOR_LCHUV> { typedef LCHuv type; };
+template<> struct by_type<COLOR_LSHUV> { typedef LSHuv type; };
+
+// derived from the sRGB primaries, the white point and the luma coefficients. color.c has the
+// same values written out by hand. the static_asserts below pin the derivations; check.c holds
+// colors::convert to color_convert's results bit for bit, for every pair of types and extras.
+
+inline constexpr chromaticity D65 = { ratio(31271, 100000), ratio(32902, 100000) };
+inline constexpr vec3 WHITE = white_xyz(D65);
+inline constexpr vec3 WHITE_INV = { { ratio(1) / WHITE.v[0], ratio(1), ratio(1) / WHITE.v[2] } };
+
+inline constexpr chromaticity SRGB_R = { ratio(64, 100), ratio(33, 100) };
+inline constexpr chromaticity SRGB_G = { ratio(30, 100), ratio(60, 100) };
+inline constexpr chromaticity SRGB_B = { ratio(15, 100), ratio(6, 100) };
+
+inline constexpr matrix3 SRGB_TO_XYZ = rgb_to_xyz(SRGB_R, SRGB_G, SRGB_B, D65);
+inline constexpr matrix3 XYZ_TO_SRGB = xyz_to_rgb(SRGB_R, SRGB_G, SRGB_B, D65);
+
+// Lab works on XYZ normalized by the white point.
+inline constexpr matrix3 SRGB_TO_LAB_XYZ = scale_rows(SRGB_TO_XYZ, WHITE_INV);
+inline constexpr matrix3 LAB_XYZ_TO_SRGB = scale_columns(XYZ_TO_SRGB, WHITE);
+
+inline constexpr rational LUV_DIV = WHITE.v[0] + ratio(15) + WHITE.v[2] * ratio(3);
+
+constexpr matrix3 yuv_matrix(int mat)
+{
+	constexpr rational luma[][2] =
+	{
+		{ ratio(299, 1000), ratio(114, 1000) }, // Rec. 601
+		{ ratio(2126, 10000), ratio(722, 10000) }, // Rec. 709
+		{ ratio(212, 1000), ratio(87, 1000) }, // SMPTE 240M
+		{ ratio(3, 10), ratio(11, 100) } // FCC
+	};
+
+	return rgb_to_luma_chroma(luma[mat][0], luma[mat][1], ratio(436, 1000), ratio(615, 1000));
+}
+
+inline constexpr matrix3 YDBDR_MATRIX = rgb_to_luma_chroma(ratio(299, 1000), ratio(114, 1000), ratio(1333, 1000), ratio(1333, 1000));
+
+static_assert(exact(SRGB_TO_XYZ) && exact(XYZ_TO_SRGB) && exact(SRGB_TO_LAB_XYZ) && exact(LAB_XYZ_TO_SRGB), "sRGB matrices do not round exactly");
+static_assert(exact(YDBDR_MATRIX) && exact(inverse(YDBDR_MATRIX)), "YDbDr matrices do not round exactly");
+
+inline constexpr dmatrix3 LINEAR_RGB_TO_XYZ = as_double(SRGB_TO_XYZ);
+inline constexpr dmatrix3 XYZ_TO_LINEAR_RGB = as_double(XYZ_TO_SRGB);
+inline constexpr dmatrix3 LINEAR_RGB_TO_LAB_XYZ = as_double(SRGB_TO_LAB_XYZ);
+inline constexpr dmatrix3 LAB_XYZ_TO_LINEAR_RGB = as_double(LAB_XYZ_TO_SRGB);
+inline constexpr dmatrix3 RGB_TO_YUV[] = { as_double(yuv_matrix(0)), as_double(yuv_matrix(1)), as_double(yuv_matrix(2)), as_double(yuv_matrix(3)) };
+inline constexpr dmatrix3 YUV_TO_RGB[] = { as_double(inverse(yuv_matrix(0))), as_double(inverse(yuv_matrix(1))), as_double(inverse(yuv_matrix(2))), as_double(inverse(yuv_matrix(3))) };
+inline constexpr dmatrix3 RGB_TO_YDBDR = as_double(YDBDR_MATRIX);
+inline constexpr dmatrix3 YDBDR_TO_RGB = as_double(inverse(YDBDR_MATRIX));
+
+inline constexpr double REF_X = as_double(WHITE.v[0]);
+inline constexpr double REF_Xr = as_double(WHITE_INV.v[0]);
+inline constexpr double REF_Z = as_double(WHITE.v[2]);
+inline constexpr double REF_Zr = as_double(WHITE_INV.v[2]);
+inline constexpr double REF_U13 = as_double(WHITE.v[0] * ratio(4 * 13) / LUV_DIV);
+inline constexpr double REF_V13 = as_double(ratio(9 * 13) / LUV_DIV);
+
+// the linear segment of Lab's f(t) = t * 841/108 + 4/29 below (6/29)^3, moved onto unnormalized X and Z.
+inline constexpr double LAB_X_KNEE = as_double(ratio(216, 24389) * WHITE.v[0]);
+inline constexpr double LAB_Z_KNEE = as_double(ratio(216, 24389) * WHITE.v[2]);
+inline constexpr double LAB_X_SLOPE = as_double(ratio(841, 108) * WHITE_INV.v[0]);
+inline constexpr double LAB_Z_SLOPE = as_double(ratio(841, 108) * WHITE_INV.v[2]);
+inline constexpr double LAB_X_SLOPE_INV = as_double(ratio(108, 841) * WHITE.v[0]);
+inline constexpr double LAB_Z_SLOPE_INV = as_double(ratio(108, 841) * WHITE.v[2]);
+inline constexpr double LAB_X_OFFSET = as_double(ratio(432, 24389) * WHITE.v[0]);
+inline constexpr double LAB_Z_OFFSET = as_double(ratio(432, 24389) * WHITE.v[2]);
+
+static_assert(REF_X == 31271.0/32902.0 && REF_Xr == 32902.0/31271.0 && REF_Z == 35827.0/32902.0 && REF_Zr == 32902.0/35827.0, "");
+static_assert(REF_U13 == 813046.0/316141.0 && REF_V13 == 1924767.0/316141.0, "");
+static_assert(LAB_X_KNEE == 3377268.0/401223439.0 && LAB_Z_KNEE == 3869316.0/401223439.0, "");
+static_assert(LAB_X_SLOPE == 13835291.0/1688634.0 && LAB_Z_SLOPE == 13835291.0/1934658.0, "");
+static_assert(LAB_X_SLOPE_INV == 1688634.0/13835291.0 && LAB_Z_SLOPE_INV == 1934658.0/13835291.0, "");
+static_assert(LAB_X_OFFSET == 6754536.0/401223439.0 && LAB_Z_OFFSET == 7738632.0/401223439.0, "");
+
+static_assert(LINEAR_RGB_TO_XYZ == dmatrix3{ {
+	{ 5067776.0/12288897.0, 4394405.0/12288897.0, 4435075.0/24577794.0 },
+	{ 871024.0/4096299.0, 8788810.0/12288897.0, 887015.0/12288897.0 },
+	{ 79184.0/4096299.0, 4394405.0/36866691.0, 70074185.0/73733382.0 } } }, "");
+
+static_assert(XYZ_TO_LINEAR_RGB == dmatrix3{ {
+	{ 641589.0/197960.0, -608687.0/395920.0, -49353.0/98980.0 },
+	{ -42591639.0/43944050.0, 82435961.0/43944050.0, 1826061.0/43944050.0 },
+	{ 49353.0/887015.0, -180961.0/887015.0, 49353.0/46685.0 } } }, "");
+
+static_assert(LINEAR_RGB_TO_LAB_XYZ == dmatrix3{ {
+	{ 10135552.0/23359437.0, 8788810.0/23359437.0, 4435075.0/23359437.0 },
+	{ 871024.0/4096299.0, 8788810.0/12288897.0, 887015.0/12288897.0 },
+	{ 158368.0/8920923.0, 8788810.0/80288307.0, 70074185.0/80288307.0 } } }, "");
+
+static_assert(LAB_XYZ_TO_LINEAR_RGB == dmatrix3{ {
+	{ 1219569.0/395920.0, -608687.0/395920.0, -107481.0/197960.0 },
+	{ -80960619.0/87888100.0, 82435961.0/43944050.0, 3976797.0/87888100.0 },
+	{ 93813.0/1774030.0, -180961.0/887015.0, 107481.0/93370.0 } } }, "");
+
+static_assert(RGB_TO_YUV[0] == dmatrix3{ {
+	{ 0.299, 0.587, 0.114 },
+	{ -32591.0/221500.0, -63983.0/221500.0, 0.436 },
+	{ 0.615, -72201.0/140200.0, -7011.0/70100.0 } } }, "");
+
+static_assert(RGB_TO_YUV[1] == dmatrix3{ {
+	{ 0.2126, 0.7152, 0.0722 },
+	{ -115867.0/1159750.0, -194892.0/579875.0, 0.436 },
+	{ 0.615, -54981.0/98425.0, -44403.0/787400.0 } } }, "");
+
+static_assert(RGB_TO_YUV[2] == dmatrix3{ {
+	{ 0.212, 0.701, 0.087 },
+	{ -11554.0/114125.0, -76409.0/228250.0, 0.436 },
+	{ 0.615, -86223.0/157600.0, -10701.0/157600.0 } } }, "");
+
+static_assert(RGB_TO_YUV[3] == dmatrix3{ {
+	{ 0.3, 0.59, 0.11 },
+	{ -327.0/2225.0, -6431.0/22250.0, 0.436 },
+	{ 0.615, -7257.0/14000.0, -1353.0/14000.0 } } }, "");
+
+static_assert(YUV_TO_RGB[0] == dmatrix3{ {
+	{ 1.0, 0.0, 701.0/615.0 },
+	{ 1.0, -25251.0/63983.0, -209599.0/361005.0 },
+	{ 1.0, 443.0/218.0, 0.0 } } }, "");
+
+static_assert(YUV_TO_RGB[1] == dmatrix3{ {
+	{ 1.0, 0.0, 3937.0/3075.0 },
+	{ 1.0, -1674679.0/7795680.0, -4185031.0/10996200.0 },
+	{ 1.0, 4639.0/2180.0, 0.0 } } }, "");
+
+static_assert(YUV_TO_RGB[2] == dmatrix3{ {
+	{ 1.0, 0.0, 788.0/615.0 },
+	{ 1.0, -79431.0/305636.0, -167056.0/431115.0 },
+	{ 1.0, 913.0/436.0, 0.0 } } }, "");
+
+static_assert(YUV_TO_RGB[3] == dmatrix3{ {
+	{ 1.0, 0.0, 140.0/123.0 },
+	{ 1.0, -4895.0/12862.0, -1400.0/2419.0 },
+	{ 1.0, 445.0/218.0, 0.0 } } }, "");
+
+static_assert(RGB_TO_YDBDR == dmatrix3{ {
+	{ 299.0/1000.0, 587.0/1000.0, 57.0/500.0 },
+	{ -398567.0/886000.0, -782471.0/886000.0, 1333.0/1000.0 },
+	{ 1333.0/1000.0, -782471.0/701000.0, -75981.0/350500.0 } } }, "");
+
+static_assert(YDBDR_TO_RGB == dmatrix3{ {
+	{ 1.0, 0.0, 701.0/1333.0 },
+	{ 1.0, -101004.0/782471.0, -209599.0/782471.0 },
+	{ 1.0, 886.0/1333.0, 0.0 } } }, "");
+
+inline uint8_t linear_to_rgb8(double c)
+{
+	double const *t = color_linear_rgb8_thresholds;
+	unsigned k = 0;
+
+	k += c >= t[k + 128] ? 128 : 0;
+	k += c >= t[k + 64] ? 64 : 0;
+	k += c >= t[k + 32] ? 32 : 0;
+	k += c >= t[k + 16] ? 16 : 0;
+	k += c >= t[k + 8] ? 8 : 0;
+	k += c >= t[k + 4] ? 4 : 0;
+	k += c >= t[k + 2] ? 2 : 0;
+	k += c >= t[k + 1] ? 1 : 0;
+
+	return c == c ? (uint8_t)k : 255;
+}
+
+inline double rgb_to_linear(double c)
+{
+	return c > (0.0031308 * 12.92) ? std::pow(c * (1.0 / 1.055) + (0.055 / 1.055), 2.4) : c * (1.0 / 12.92);
+}
+
+inline double linear_to_rgb(double c)
+{
+	return c > 0.0031308 ? std::pow(c, 1.0 / 2.4) * 1.055 - 0.055 : c * 12.92;
+}
+
+inline double xyz_to_lab(double c)
+{
+	return c > 216.0 / 24389.0 ? std::pow(c, 1.0 / 3.0) : c * (841.0/108.0) + (4.0/29.0);
+}
+
+// atan2's hue moved into [0, pi*2), as color.c does.
+inline double positive_hue(double h)
+{
+	return h < 0.0 ? h + 6.2831853071795864769252867666 : h;
+}
+
+inline RGB finish_HSL_to_RGB(double h, double C, double m)
+{
+	static constexpr unsigned char rgb_tbl[][3] =
+	{
+		{ 0, 2, 1 },
+		{ 2, 0, 1 },
+		{ 1, 0, 2 },
+		{ 1, 2, 0 },
+		{ 2, 1, 0 },
+		{ 0, 1, 2 }
+	};
+
+	double absh, h2, vars[3];
+	int idx;
+
+	absh = std::fabs(h);
+
+	h2 =
+		absh >= 2.0 ? std::floor(h * 0.5) * -2.0 + h - 1.0 :
+		h < 0.0 ? h + 1.0 :
+		h - 1.0;
+	h2 = 1.0 - std::fabs(h2);
+
+	idx = (int)
+		(absh >= 6.0 ? std::floor(h * (1.0 / 6.0)) * -6.0 + h :
+		h < 0.0 ? h + 6.0 :
+		h);
+
+	vars[0] = C + m;
+	vars[1] = m;
+	vars[2] = C * h2 + m;
+
+	return { vars[rgb_tbl[idx][0]], vars[rgb_tbl[idx][1]], vars[rgb_tbl[idx][2]] };
+}
+
+// one conversion step. Extra is the extra of the input, NewExtra the one being converted to.
+
+template<color_type From, color_type To> struct edge;
+
+template<> struct edge<COLOR_RGB8, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(RGB8 const &c)
+	{
+		return { c.R * (1.0 / 255.0), c.G * (1.0 / 255.0), c.B * (1.0 / 255.0) };
+	}
+};
+
+template<> struct edge<COLOR_RGB8, COLOR_LINEAR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LinearRGB apply(RGB8 const &c)
+	{
+		double const *tbl = color_rgb8_linear_tbl;
+		return { tbl[c.R], tbl[c.G], tbl[c.B] };
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_RGB8>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB8 apply(RGB const &c)
+	{
+		double R = c.R * 255.0 + 0.5;
+		double G = c.G * 255.0 + 0.5;
+		double B = c.B * 255.0 + 0.5;
+
+		return {
+			(uint8_t)(R < 0.0 ? 0 : R > 255.0 ? 255 : (uint8_t)R),
+			(uint8_t)(G < 0.0 ? 0 : G > 255.0 ? 255 : (uint8_t)G),
+			(uint8_t)(B < 0.0 ? 0 : B > 255.0 ? 255 : (uint8_t)B)
+		};
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_LINEAR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LinearRGB apply(RGB const &c)
+	{
+		return { rgb_to_linear(c.R), rgb_to_linear(c.G), rgb_to_linear(c.B) };
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_HSL>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static HSL apply(RGB const &c)
+	{
+		double R = c.R, G = c.G, B = c.B, min, max, delta, L;
+
+		min = R < G ? R : G;
+		if(B < min) min = B;
+
+		max = R > G ? R : G;
+		if(B > max) max = B;
+
+		delta = max - min;
+
+		L = (max + min) * 0.5;
+
+		if(std::fabs(delta) > 0.0)
+		{
+			return {
+				max == R ? (G - B) / delta :
+				max == G ? (B - R) / delta + 2.0 :
+				(R - G) / delta + 4.0,
+				L < 0.5 ? delta / (max + min) :
+				delta / (2.0 - max - min),
+				L
+			};
+		}
+
+		return { 0.0, 0.0, L };
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_HSV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static HSV apply(RGB const &c)
+	{
+		double R = c.R, G = c.G, B = c.B, min, max, delta;
+
+		min = R < G ? R : G;
+		if(B < min) min = B;
+
+		max = R > G ? R : G;
+		if(B > max) max = B;
+
+		delta = max - min;
+
+		if(std::fabs(delta) > 0.0)
+		{
+			return {
+				max == R ? (G - B) / delta :
+				max == G ? (B - R) / delta + 2.0 :
+				(R - G) / delta + 4.0,
+				delta / max,
+				max
+			};
+		}
+
+		return { 0.0, 0.0, max };
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_YUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YUV apply(RGB const &c)
+	{
+		constexpr dmatrix3 const &mat = RGB_TO_YUV[NewExtra & COLOR_YUV_MAT_MASK];
+		double R = c.R, G = c.G, B = c.B;
+
+		return {
+			R * mat.m[0][0] + G * mat.m[0][1] + B * mat.m[0][2],
+			R * mat.m[1][0] + G * mat.m[1][1] + B * mat.m[1][2],
+			R * mat.m[2][0] + G * mat.m[2][1] + B * mat.m[2][2]
+		};
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_YDBDR>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YDbDr apply(RGB const &c)
+	{
+		double R = c.R, G = c.G, B = c.B;
+
+		constexpr dmatrix3 const &mat = RGB_TO_YDBDR;
+
+		return {
+			R * mat.m[0][0] + G * mat.m[0][1] + B * mat.m[0][2],
+			R * mat.m[1][0] + G * mat.m[1][1] + B * mat.m[1][2],
+			R * mat.m[2][0] + G * mat.m[2][1] + B * mat.m[2][2]
+		};
+	}
+};
+
+template<> struct edge<COLOR_RGB, COLOR_YIQ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YIQ apply(RGB const &c)
+	{
+		double R = c.R, G = c.G, B = c.B;
+
+		return {
+			R *  0.299                          + G *  0.587                          + B *  0.114,
+			R *  0.5957                         + G * -0.2744766323826577035751015648 + B * -0.3212233676173422964248984352,
+			R * -0.2114956266791979792324116478 + G *  0.5226                         + B * -0.3111043733208020207675883522
+		};
+	}
+};
+
+template<> struct edge<COLOR_LINEAR_RGB, COLOR_RGB8>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB8 apply(LinearRGB const &c)
+	{
+		return { linear_to_rgb8(c.R), linear_to_rgb8(c.G), linear_to_rgb8(c.B) };
+	}
+};
+
+template<> struct edge<COLOR_LINEAR_RGB, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(LinearRGB const &c)
+	{
+		return { linear_to_rgb(c.R), linear_to_rgb(c.G), linear_to_rgb(c.B) };
+	}
+};
+
+template<> struct edge<COLOR_LINEAR_RGB, COLOR_XYZ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static XYZ apply(LinearRGB const &c)
+	{
+		double R = c.R, G = c.G, B = c.B;
+
+		constexpr dmatrix3 const &mat = LINEAR_RGB_TO_XYZ;
+
+		return {
+			R * mat.m[0][0] + G * mat.m[0][1] + B * mat.m[0][2],
+			R * mat.m[1][0] + G * mat.m[1][1] + B * mat.m[1][2],
+			R * mat.m[2][0] + G * mat.m[2][1] + B * mat.m[2][2]
+		};
+	}
+};
+
+template<> struct edge<COLOR_LINEAR_RGB, COLOR_LAB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static Lab apply(LinearRGB const &c)
+	{
+		constexpr dmatrix3 const &mat = LINEAR_RGB_TO_LAB_XYZ;
+		double R = c.R, G = c.G, B = c.B, X, Y, Z;
+
+		X = xyz_to_lab(R * mat.m[0][0] + G * mat.m[0][1] + B * mat.m[0][2]);
+		Y = xyz_to_lab(R * mat.m[1][0] + G * mat.m[1][1] + B * mat.m[1][2]);
+		Z = xyz_to_lab(R * mat.m[2][0] + G * mat.m[2][1] + B * mat.m[2][2]);
+
+		return { Y * 116.0 - 16.0, (X - Y) * 500.0, (Y - Z) * 200.0 };
+	}
+};
+
+template<> struct edge<COLOR_HSL, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(HSL const &c)
+	{
+		double H = c.H, S = c.S, L = c.L, C, m;
+
+		if(std::fabs(S) > 0.0)
+		{
+			C = (1.0 - std::fabs(L * 2.0 - 1.0)) * S;
+			m = C * -0.5 + L;
+
+			return finish_HSL_to_RGB(H, C, m);
+		}
+
+		return { L, L, L };
+	}
+};
+
+template<> struct edge<COLOR_HSV, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(HSV const &c)
+	{
+		double H = c.H, S = c.S, V = c.V, C, m;
+
+		if(std::fabs(S) > 0.0)
+		{
+			C = V * S;
+			m = V - C;
+
+			return finish_HSL_to_RGB(H, C, m);
+		}
+
+		return { V, V, V };
+	}
+};
+
+template<> struct edge<COLOR_YUV, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(YUV const &c)
+	{
+		constexpr dmatrix3 const &mat = YUV_TO_RGB[Extra & COLOR_YUV_MAT_MASK];
+		double Y = c.Y, U = c.U, V = c.V;
+
+		return {
+			Y                   + V * mat.m[0][2],
+			Y + U * mat.m[1][1] + V * mat.m[1][2],
+			Y + U * mat.m[2][1]
+		};
+	}
+};
+
+template<> struct edge<COLOR_YUV, COLOR_YUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YUV apply(YUV const &c)
+	{
+		return edge<COLOR_RGB, COLOR_YUV>::apply<0, NewExtra>(edge<COLOR_YUV, COLOR_RGB>::apply<Extra, NewExtra>(c));
+	}
+};
+
+template<> struct edge<COLOR_YUV, COLOR_YCBCR>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YCbCr apply(YUV const &c)
+	{
+		if constexpr((Extra & COLOR_YUV_MAT_MASK) != (NewExtra & COLOR_YUV_MAT_MASK))
+		{
+			return apply<NewExtra, NewExtra>(edge<COLOR_YUV, COLOR_YUV>::apply<Extra, NewExtra>(c));
+		}
+		else
+		{
+			double Y = c.Y, U = c.U, V = c.V;
+
+			if constexpr((NewExtra & COLOR_YCBCR_FULL_RANGE) != 0)
+			{
+				Y = Y * 255.0 + 0.5;
+				U = U * (31875.0/109.0) + 128;
+				V = V * (8500.0/41.0) + 128;
+			}
+			else
+			{
+				Y = Y * 219.0 + 16.5;
+				U = U * (28000.0/109.0) + 144;
+				V = V * (22400.0/123.0) + 144;
+			}
+
+			return {
+				(uint8_t)(Y < 0.0 ? 0 : Y > 255.0 ? 255 : (int)Y),
+				(uint8_t)(U < 0.0 ? 0 : U > 255.0 ? 255 : (int)U),
+				(uint8_t)(V < 0.0 ? 0 : V > 255.0 ? 255 : (int)V)
+			};
+		}
+	}
+};
+
+template<> struct edge<COLOR_YCBCR, COLOR_YUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YUV apply(YCbCr const &c)
+	{
+		constexpr uint8_t yuv_extra = Extra & ~(uint8_t)COLOR_YCBCR_FULL_RANGE;
+		double Y = c.Y, U = c.Cb, V = c.Cr;
+
+		if constexpr((Extra & COLOR_YCBCR_FULL_RANGE) != 0)
+		{
+			Y *= (1.0 / 255.0);
+			U = U * (109.0/31875.0) - 0.436;
+			V = V * (41.0/8500.0) - 0.615;
+		}
+		else
+		{
+			Y = Y * (1.0/219.0) - (16.0/219.0);
+			U = U * (109.0/28000.0) - 0.558625;
+			V = V * (123.0/22400.0) - 0.78796875;
+		}
+
+		if constexpr((yuv_extra & COLOR_YUV_MAT_MASK) != (NewExtra & COLOR_YUV_MAT_MASK))
+		{
+			return edge<COLOR_YUV, COLOR_YUV>::apply<yuv_extra, NewExtra>(YUV{ Y, U, V });
+		}
+		else
+		{
+			return { Y, U, V };
+		}
+	}
+};
+
+template<> struct edge<COLOR_YCBCR, COLOR_YCBCR>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YCbCr apply(YCbCr const &c)
+	{
+		// the YUV step already leaves NewExtra's matrix behind when it differs.
+		constexpr uint8_t yuv_extra = (Extra & COLOR_YUV_MAT_MASK) != (NewExtra & COLOR_YUV_MAT_MASK) ? NewExtra : Extra & ~(uint8_t)COLOR_YCBCR_FULL_RANGE;
+
+		return edge<COLOR_YUV, COLOR_YCBCR>::apply<yuv_extra, NewExtra>(edge<COLOR_YCBCR, COLOR_YUV>::apply<Extra, NewExtra>(c));
+	}
+};
+
+template<> struct edge<COLOR_YDBDR, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(YDbDr const &c)
+	{
+		constexpr dmatrix3 const &mat = YDBDR_TO_RGB;
+		double Y = c.Y, Db = c.Db, Dr = c.Dr;
+
+		return {
+			Y                    + Dr * mat.m[0][2],
+			Y + Db * mat.m[1][1] + Dr * mat.m[1][2],
+			Y + Db * mat.m[2][1]
+		};
+	}
+};
+
+template<> struct edge<COLOR_YDBDR, COLOR_YIQ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YIQ apply(YDbDr const &c)
+	{
+		double Y = c.Y, Db = c.Db, Dr = c.Dr;
+
+		return {
+			Y,
+			Db * -1.780759334211551067290090872e-1 + Dr *  3.867911188667345780375729105e-1,
+			Y * 3.155443620884047221646914261e-30 + Db * -2.742395246410785275938007739e-1 + Dr * -2.512094867865302853146089398e-1
+		};
+	}
+};
+
+template<> struct edge<COLOR_YIQ, COLOR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static RGB apply(YIQ const &c)
+	{
+		double Y = c.Y, I = c.I, Q = c.Q;
+
+		return {
+			Y + I *  9.563000521420394701478042310e-1 + Q * -6.209682015704038246103012680e-1,
+			Y + I * -2.720883840788609953919979558e-1 + Q *  6.473748500336683799608873068e-1,
+			Y + I * -1.107173983650687695430619869e0  + Q * -1.704732848247478907706673421e0
+		};
+	}
+};
+
+template<> struct edge<COLOR_YIQ, COLOR_YDBDR>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static YDbDr apply(YIQ const &c)
+	{
+		double Y = c.Y, I = c.I, Q = c.Q;
+
+		return {
+			Y                                      + I *  6.310887241768094443293828522e-30,
+			I * -1.665759503618924038384894227e0 + Q * -2.564795583198520749405186986e0,
+			Y * 1.009741958682895110927012564e-28  + I *  1.818470712561110718554954408e0 + Q * -1.180813998136017543802470171e0
+		};
+	}
+};
+
+template<> struct edge<COLOR_XYZ, COLOR_LINEAR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LinearRGB apply(XYZ const &c)
+	{
+		constexpr dmatrix3 const &mat = XYZ_TO_LINEAR_RGB;
+		double X = c.X, Y = c.Y, Z = c.Z;
+
+		return {
+			X * mat.m[0][0] + Y * mat.m[0][1] + Z * mat.m[0][2],
+			X * mat.m[1][0] + Y * mat.m[1][1] + Z * mat.m[1][2],
+			X * mat.m[2][0] + Y * mat.m[2][1] + Z * mat.m[2][2]
+		};
+	}
+};
+
+template<> struct edge<COLOR_XYZ, COLOR_XYY>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static xyY apply(XYZ const &c)
+	{
+		double X = c.X, Y = c.Y, div;
+
+		div = X + Y + c.Z;
+
+		if(std::fabs(div) > 0.0)
+		{
+			return { X / div, Y / div, Y };
+		}
+
+		return { X, Y, Y };
+	}
+};
+
+template<> struct edge<COLOR_XYZ, COLOR_LAB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static Lab apply(XYZ const &c)
+	{
+		double X = c.X, Y = c.Y, Z = c.Z;
+
+		X = X > LAB_X_KNEE ? std::pow(X * REF_Xr, 1.0/3.0) : X * LAB_X_SLOPE + (4.0/29.0);
+		Y = Y > 216.0/24389.0 ? std::pow(Y, 1.0/3.0) : Y * (841.0/108.0) + (4.0/29.0);
+		Z = Z > LAB_Z_KNEE ? std::pow(Z * REF_Zr, 1.0/3.0) : Z * LAB_Z_SLOPE + (4.0/29.0);
+
+		return { Y * 116.0 - 16.0, (X - Y) * 500.0, (Y - Z) * 200.0 };
+	}
+};
+
+template<> struct edge<COLOR_XYZ, COLOR_LUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static Luv apply(XYZ const &c)
+	{
+		double X = c.X, Y = c.Y, div, L;
+
+		div = X + Y * 15.0 + c.Z * 3.0;
+		L = Y > 216.0/24389.0 ? std::pow(Y, 1.0 / 3.0) * 116.0 - 16.0 : Y * (24389.0/27.0);
+
+		if(std::fabs(div) > 0.0)
+		{
+			div = 1.0 / div;
+			X *= div;
+			Y *= div;
+		}
+
+		return { L, (X * 52.0 - REF_U13) * L, (Y * 117.0 - REF_V13) * L };
+	}
+};
+
+template<> struct edge<COLOR_XYY, COLOR_XYZ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static XYZ apply(xyY const &c)
+	{
+		double x = c.x, y = c.y, Y = c.Y;
+
+		if(std::fabs(y) > 0.0)
+		{
+			double mul = Y / y;
+			return { x * mul, Y, (1.0 - x - y) * mul };
+		}
+
+		return { 0.0, 0.0, 0.0 };
+	}
+};
+
+template<> struct edge<COLOR_LAB, COLOR_LINEAR_RGB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LinearRGB apply(Lab const &c)
+	{
+		double X, Y, Z;
+
+		Y = c.L * (1.0/116.0) + 16.0/116.0;
+		X = c.a * (1.0/500.0) + Y;
+		Z = c.b * (-1.0/200.0) + Y;
+
+		X = X > 6.0/29.0 ? X * X * X : X * (108.0/841.0) - 432.0/24389.0;
+		Y = c.L > 8.0 ? Y * Y * Y : c.L * (27.0/24389.0);
+		Z = Z > 6.0/29.0 ? Z * Z * Z : Z * (108.0/841.0) - 432.0/24389.0;
+
+		constexpr dmatrix3 const &mat = LAB_XYZ_TO_LINEAR_RGB;
+
+		return {
+			X * mat.m[0][0] + Y * mat.m[0][1] + Z * mat.m[0][2],
+			X * mat.m[1][0] + Y * mat.m[1][1] + Z * mat.m[1][2],
+			X * mat.m[2][0] + Y * mat.m[2][1] + Z * mat.m[2][2]
+		};
+	}
+};
+
+template<> struct edge<COLOR_LAB, COLOR_XYZ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static XYZ apply(Lab const &c)
+	{
+		double L = c.L, X, Y, Z;
+
+		Y = L * (1.0/116.0) + 16.0/116.0;
+		X = c.a * (1.0/500.0) + Y;
+		Z = c.b * (-1.0/200.0) + Y;
+
+		return {
+			X > 6.0/29.0 ? X * X * X * REF_X : X * LAB_X_SLOPE_INV - LAB_X_OFFSET,
+			L > 8.0 ? Y * Y * Y : L * (27.0/24389.0),
+			Z > 6.0/29.0 ? Z * Z * Z * REF_Z : Z * LAB_Z_SLOPE_INV - LAB_Z_OFFSET
+		};
+	}
+};
+
+template<> struct edge<COLOR_LAB, COLOR_LCHAB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LCHab apply(Lab const &c)
+	{
+		return { c.L, std::sqrt(c.a * c.a + c.b * c.b), positive_hue(std::atan2(c.b, c.a)) };
+	}
+};
+
+template<> struct edge<COLOR_LCHAB, COLOR_LAB>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static Lab apply(LCHab const &c)
+	{
+		return { c.L, std::cos(c.h) * c.C, std::sin(c.h) * c.C };
+	}
+};
+
+template<> struct edge<COLOR_LUV, COLOR_XYZ>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static XYZ apply(Luv const &c)
+	{
+		double L = c.L, u = c.u, v = c.v, y, a, b, cc, x, z;
+
+		if(L > 8.0)
+		{
+			y = L * (1.0 / 116.0) + 16.0 / 116.0;
+			y = y * y * y;
+		}
+		else
+		{
+			y = L * (27.0 / 24389.0);
+		}
+
+		a = L / (L * REF_U13 + u) * (52.0 / 3.0) - 1.0 / 3.0;
+		b = 5.0 * y;
+		cc = (L / (L * REF_V13 + v) * 39.0 - 5.0) * y;
+
+		x = (cc + b) / (a + 1.0 / 3.0);
+		z = x * a - b;
+
+		return { x, y, z };
+	}
+};
+
+template<> struct edge<COLOR_LUV, COLOR_LCHUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LCHuv apply(Luv const &c)
+	{
+		return { c.L, std::sqrt(c.u * c.u + c.v * c.v), positive_hue(std::atan2(c.v, c.u)) };
+	}
+};
+
+template<> struct edge<COLOR_LCHUV, COLOR_LUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static Luv apply(LCHuv const &c)
+	{
+		return { c.L, std::cos(c.h) * c.C, std::sin(c.h) * c.C };
+	}
+};
+
+template<> struct edge<COLOR_LCHUV, COLOR_LSHUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LSHuv apply(LCHuv const &c)
+	{
+		return { c.L, c.C / c.L, c.h };
+	}
+};
+
+template<> struct edge<COLOR_LSHUV, COLOR_LCHUV>
+{
+	template<uint8_t Extra, uint8_t NewExtra> static LCHuv apply(LSHuv const &c)
+	{
+		return { c.L, c.S * c.L, c.h };
+	}
+};
+
+// the edges above with their costs, from the same list color.c routes with.
+
+struct edge_cost
+{
+	uint8_t from, to;
+	uint16_t cost;
+};
+
+inline constexpr edge_cost edge_costs[] =
+{
+#define COLOR_EDGE_COST(from, to, cost) { from, to, cost },
+#include "color_costs.h"
+};
+
+inline constexpr uint32_t step_cost = COLOR_STEP_COST;
+inline constexpr uint32_t no_edge = 0xFFFFFFFF;
+
+constexpr uint32_t find_edge_cost(int from, int to)
+{
+	for(edge_cost const &e : edge_costs)
+	{
+		if(e.from == from && e.to == to)
+		{
+			return e.cost + step_cost;
+		}
+	}
+
+	return no_edge;
+}
+
+// the first step from -> to. this is color_routes_build for a single source.
+
+constexpr int next_type(int from, int target)
+{
+	uint32_t dist[COLOR_DUMMY_END] = {}, hops[COLOR_DUMMY_END] = {};
+	int first[COLOR_DUMMY_END] = {};
+	bool done[COLOR_DUMMY_END] = {};
+
+	for(int i = 1; i < COLOR_DUMMY_END; ++i)
+	{
+		dist[i] = no_edge;
+		hops[i] = no_edge;
+	}
+
+	dist[from] = 0;
+	hops[from] = 0;
+
+	for(;;)
+	{
+		int cur = COLOR_NONE;
+
+		for(int i = 1; i < COLOR_DUMMY_END; ++i)
+		{
+			if(!done[i] && dist[i] != no_edge &&
+				(cur == COLOR_NONE || dist[i] < dist[cur] || (dist[i] == dist[cur] && hops[i] < hops[cur])))
+			{
+				cur = i;
+			}
+		}
+
+		if(cur == COLOR_NONE)
+		{
+			break;
+		}
+
+		done[cur] = true;
+
+		if(cur != from && (cur == COLOR_RGB8 || cur == COLOR_YCBCR))
+		{
+			continue;
+		}
+
+		for(int to = 1; to < COLOR_DUMMY_END; ++to)
+		{
+			uint32_t cost = find_edge_cost(cur, to);
+
+			if(to == cur || cost == no_edge || done[to])
+			{
+				continue;
+			}
+
+			uint32_t d = dist[cur] + cost;
+
+			if(d < dist[to] || (d == dist[to] && hops[cur] + 1 < hops[to]))
+			{
+				dist[to] = d;
+				hops[to] = hops[cur] + 1;
+				first[to] = cur == from ? to : first[cur];
+			}
+		}
+	}
+
+	return first[target];
+}
+
+// the extra left behind by each step, as color.c's conversions set it.
+
+constexpr uint8_t next_extra(int from, int to, uint8_t extra, uint8_t new_extra)
+{
+	if(from == COLOR_YCBCR && to == COLOR_YUV)
+	{
+		extra &= ~(uint8_t)COLOR_YCBCR_FULL_RANGE;
+		return (extra & COLOR_YUV_MAT_MASK) != (new_extra & COLOR_YUV_MAT_MASK) ? new_extra : extra;
+	}
+
+	if(to == COLOR_YUV || to == COLOR_YCBCR)
+	{
+		return new_extra;
+	}
+
+	return from == COLOR_YUV ? 0 : extra;
+}
+
+struct route
+{
+	int count; // -1 if there is no route.
+	uint8_t types[COLOR_PLAN_MAX_STEPS + 1];
+	uint8_t extras[COLOR_PLAN_MAX_STEPS + 1];
+};
+
+// the walk color_convert takes.
+
+constexpr route find_route(int from, uint8_t from_extra, int to, uint8_t to_extra)
+{
+	route r = {};
+	int type = from;
+	uint8_t extra = from_extra;
+
+	r.types[0] = (uint8_t)type;
+	r.extras[0] = extra;
+
+	while(type != to || extra != to_extra)
+	{
+		int next = type == to ? to : next_type(type, to);
+
+		// only YUV and YCbCr convert to themselves, to change extras.
+		bool ok = type == next ? type == COLOR_YUV || type == COLOR_YCBCR : next != COLOR_NONE;
+
+		if(r.count == COLOR_PLAN_MAX_STEPS || !ok)
+		{
+			r.count = -1;
+			break;
+		}
+
+		extra = next_extra(type, next, extra, to_extra);
+		type = next;
+
+		++r.count;
+		r.types[r.count] = (uint8_t)type;
+		r.extras[r.count] = extra;
+	}
+
+	return r;
+}
+
+template<color_type From, uint8_t FromExtra, color_type To, uint8_t ToExtra>
+struct path
+{
+	static constexpr route value = find_route(From, FromExtra, To, ToExtra);
+};
+
+template<class Path, uint8_t NewExtra, int I, class T>
+inline auto run(T const &c)
+{
+	if constexpr(I == Path::value.count)
+	{
+		return c;
+	}
+	else
+	{
+		constexpr color_type from = (color_type)Path::value.types[I];
+		constexpr color_type to = (color_type)Path::value.types[I + 1];
+
+		return run<Path, NewExtra, I + 1>(edge<from, to>::template apply<Path::value.extras[I], NewExtra>(c));
+	}
+}
+
+}
+
+// converts c, with extra FromExtra, to To with extra ToExtra. extras only apply to YUV and YCbCr.
+
+template<class From, class To, uint8_t FromExtra = 0, uint8_t ToExtra = 0>
+inline To convert(From const &c)
+{
+	typedef detail::path<From::type, FromExtra, To::type, ToExtra> path;
+
+	static_assert(path::value.count >= 0, "no route between these types and extras");
+
+	if constexpr(path::value.count >= 0)
+	{
+		return detail::run<path, ToExtra, 0>(c);
+	}
+	else
+	{
+		return To();
+	}
+}
+
+// moves a typed color in and out of the C API's struct color. the layouts match the union members.
+
+template<class T, uint8_t Extra = 0>
+inline struct color to_c(T const &c)
+{
+	struct color ret;
+
+	ret.type = T::type;
+	ret.extra = Extra;
+	std::memcpy(&ret.RGB, &c, sizeof c);
+
+	return ret;
+}
+
+template<class T>
+inline T from_c(struct color const &c)
+{
+	T ret;
+
+	assert(c.type == T::type);
+	std::memcpy(&ret, &c.RGB, sizeof ret);
+
+	return ret;
+}
+
+}
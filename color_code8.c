@@ -0,0 +1,363 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	8-bit HSV and Lab as OpenCV stores them, converted from and to RGB8 in
+	integers: H is the hue in degrees / 2, in [0, 180), S and V are scaled to
+	255, L is scaled to 255, and a and b are offset by 128.
+
+	HSV is exact rational arithmetic, rounded half up, with divisions by the
+	chroma or value done by reciprocal tables. Lab goes through fixed point:
+	linear light in Q16 from a table, XYZ by an integer matrix whose rows sum
+	to one so that grays keep a = b = 128, Lab's cube root and its inverse by
+	interpolated tables, and linear light back to RGB8 by a 64 KiB table.
+
+	Against the double path, rounded half up, no result is more than one code
+	value off. HSV differs only where the double path rounds an exact half,
+	Lab also where it lands within a few thousandths of one. check.c counts
+	them.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <assert.h>
+#include "color_internal.h"
+
+// fractional bits of linear light, of XYZ and Lab's f(t) on the way to Lab, and of the matrix.
+#define LIN_BITS 16
+#define XYZ_BITS 30
+#define F_BITS 16
+#define MAT_BITS 14
+
+// Lab's f(t) is interpolated over t in [0, 1], at 2^CBRT_BITS intervals.
+#define CBRT_BITS 12
+
+// its inverse, over f in [-1, 2) in Q20 at intervals of 2^-10, covers every Lab8 code.
+#define INV_BITS 20
+#define INV_STEP_BITS 10
+#define INV_SIZE (3 << INV_STEP_BITS)
+
+static uint32_t g_recip[511]; // ceil(2^32 / d), for exact division of numbers below 2^17 by d in [1, 510].
+static int32_t g_lin[256]; // rgb8 -> linear, Q16.
+static int32_t g_to_xyz[9]; // linear -> XYZ / white, rows summing to 1 << MAT_BITS.
+static int32_t g_cbrt[(1 << CBRT_BITS) + 2]; // f(t), Q16.
+static int32_t g_fy[256], g_fa[256], g_fb[256]; // L8 -> f(Y), a8 -> a / 500 and b8 -> -b / 200, Q20.
+static int32_t g_y[256]; // L8 -> Y / white, Q20.
+static int32_t g_inv[INV_SIZE + 2]; // f -> t, Q20.
+static int64_t g_to_rgb[9]; // XYZ / white -> linear, Q20.
+static uint8_t g_rgb8[(1 << LIN_BITS) + 1]; // linear in Q16 -> RGB8.
+static long volatile g_code8_state;
+
+static void code8_build(void)
+{
+	double const *to_xyz = color_linear_to_xyzw, *to_rgb = color_xyzw_to_linear;
+	int i, j;
+
+	for(i = 1; i < 511; ++i)
+	{
+		g_recip[i] = (uint32_t)((((uint64_t)1 << 32) + (uint64_t)i - 1) / (uint64_t)i);
+	}
+
+	for(i = 0; i < 256; ++i)
+	{
+		double L = i * (100.0 / 255.0);
+
+		g_lin[i] = (int32_t)floor(color_rgb8_linear_tbl[i] * (1 << LIN_BITS) + 0.5);
+
+		g_fy[i] = (int32_t)floor((L + 16.0) * (1.0 / 116.0) * (1 << INV_BITS) + 0.5);
+		g_fa[i] = (int32_t)floor((i - 128) * (1.0 / 500.0) * (1 << INV_BITS) + 0.5);
+		g_fb[i] = (int32_t)floor((i - 128) * (-1.0 / 200.0) * (1 << INV_BITS) + 0.5);
+		g_y[i] = (int32_t)floor((L > 8.0 ? color_lab_f_inv((L + 16.0) * (1.0 / 116.0)) : L * (27.0/24389.0)) * (1 << INV_BITS) + 0.5);
+	}
+
+	// rounded rows would not sum to one exactly; the diagonal, each row's largest entry, takes up the difference.
+
+	for(i = 0; i < 3; ++i)
+	{
+		int32_t sum = 0;
+
+		for(j = 0; j < 3; ++j)
+		{
+			g_to_xyz[i * 3 + j] = (int32_t)floor(to_xyz[i * 3 + j] * (1 << MAT_BITS) + 0.5);
+			sum += g_to_xyz[i * 3 + j];
+		}
+
+		g_to_xyz[i * 4] += (1 << MAT_BITS) - sum;
+	}
+
+	for(i = 0; i < 9; ++i)
+	{
+		g_to_rgb[i] = (int64_t)floor(to_rgb[i] * (1 << INV_BITS) + 0.5);
+	}
+
+	for(i = 0; i < (1 << CBRT_BITS) + 2; ++i)
+	{
+		g_cbrt[i] = (int32_t)floor(color_lab_f(i * (1.0 / (1 << CBRT_BITS))) * (1 << F_BITS) + 0.5);
+	}
+
+	for(i = 0; i < INV_SIZE + 2; ++i)
+	{
+		g_inv[i] = (int32_t)floor(color_lab_f_inv(i * (1.0 / (1 << INV_STEP_BITS)) - 1.0) * (1 << INV_BITS) + 0.5);
+	}
+
+	for(i = 0; i <= (1 << LIN_BITS); ++i)
+	{
+		g_rgb8[i] = color_linear_to_rgb8_fast(i * (1.0 / (1 << LIN_BITS)));
+	}
+}
+
+// x / d for x < 2^17 and d in [1, 510], exactly.
+
+static __inline uint32_t recip_div(uint32_t x, uint32_t d)
+{
+	assert(x < (1u << 17) && d >= 1 && d <= 510);
+	return (uint32_t)(((uint64_t)x * g_recip[d]) >> 32);
+}
+
+static void rgb8_to_hsv8_run(uint8_t *d, uint8_t const *s, size_t size, size_t n)
+{
+	size_t i;
+
+	for(i = 0; i < n; ++i, s += size, d += size)
+	{
+		int32_t R = s[0], G = s[1], B = s[2];
+		int32_t max = R > G ? R : G;
+		int32_t min = R < G ? R : G;
+		int32_t C, T;
+		uint32_t H;
+
+		if(B > max) max = B;
+		if(B < min) min = B;
+
+		C = max - min;
+
+		d[2] = (uint8_t)max;
+
+		if(C == 0)
+		{
+			d[0] = 0;
+			d[1] = 0;
+		}
+		else
+		{
+			// hue * 30 * C, in [-30 C, 270 C) before wrapping, as color_RGB_to_HSV picks the sector.
+
+			T =
+				max == R ? (G - B) * 30 :
+				max == G ? (B - R) * 30 + C * 60 :
+				(R - G) * 30 + C * 120;
+
+			if(T < 0)
+			{
+				T += C * 180;
+			}
+
+			H = recip_div((uint32_t)(T * 2 + C), (uint32_t)C * 2);
+
+			d[0] = (uint8_t)(H == 180 ? 0 : H);
+			d[1] = (uint8_t)recip_div((uint32_t)(C * 510 + max), (uint32_t)max * 2);
+		}
+
+		if(size == 4)
+		{
+			d[3] = 0;
+		}
+	}
+}
+
+static void hsv8_to_rgb8_run(uint8_t *d, uint8_t const *s, size_t size, size_t n)
+{
+	// which of max, min and the rising or falling middle value go to R, G and B, per 60 degree sector.
+	static uint8_t const order[6][3] =
+	{
+		{ 0, 2, 1 },
+		{ 2, 0, 1 },
+		{ 1, 0, 2 },
+		{ 1, 2, 0 },
+		{ 2, 1, 0 },
+		{ 0, 1, 2 }
+	};
+
+	size_t i;
+
+	for(i = 0; i < n; ++i, s += size, d += size)
+	{
+		uint32_t H = s[0] >= 180 ? s[0] - 180u : s[0];
+		uint32_t S = s[1], V = s[2];
+		uint32_t sector = H / 30, r = H - sector * 30;
+		uint8_t vars[3];
+
+		if(sector & 1)
+		{
+			r = 30 - r;
+		}
+
+		// min is V (1 - S), the middle value is min + V S r / 30, all scaled to 255.
+
+		vars[0] = (uint8_t)V;
+		vars[1] = (uint8_t)((V * (255 - S) * 2 + 255) / 510);
+		vars[2] = (uint8_t)((V * (7650 - S * 30 + S * r) * 2 + 7650) / 15300);
+
+		d[0] = vars[order[sector][0]];
+		d[1] = vars[order[sector][1]];
+		d[2] = vars[order[sector][2]];
+
+		if(size == 4)
+		{
+			d[3] = 0;
+		}
+	}
+}
+
+// Lab's f(t) for t in [0, 1] in Q30, as Q16.
+
+static __inline int32_t cbrt_q(int32_t t)
+{
+	int32_t const shift = XYZ_BITS - CBRT_BITS;
+	int32_t k = t >> shift, frac = t & ((1 << shift) - 1);
+
+	assert(t >= 0 && t <= (1 << XYZ_BITS));
+	return g_cbrt[k] + (int32_t)(((int64_t)(g_cbrt[k + 1] - g_cbrt[k]) * frac) >> shift);
+}
+
+static __inline uint8_t clamp8(int32_t v)
+{
+	return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static void rgb8_to_lab8_run(uint8_t *d, uint8_t const *s, size_t size, size_t n)
+{
+	int32_t const *m = g_to_xyz;
+	size_t i;
+
+	for(i = 0; i < n; ++i, s += size, d += size)
+	{
+		int32_t R = g_lin[s[0]], G = g_lin[s[1]], B = g_lin[s[2]];
+		int32_t fx = cbrt_q(R * m[0] + G * m[1] + B * m[2]);
+		int32_t fy = cbrt_q(R * m[3] + G * m[4] + B * m[5]);
+		int32_t fz = cbrt_q(R * m[6] + G * m[7] + B * m[8]);
+
+		// L8 = (116 fy - 16) * 255 / 100 = (2958 fy - 408) / 10, and f(0) is 4 / 29, so this stays positive.
+
+		d[0] = (uint8_t)((fy * 2958 - (408 << F_BITS) + (5 << F_BITS)) / (10 << F_BITS));
+		d[1] = clamp8(((fx - fy) * 500 + (128 << F_BITS) + (1 << (F_BITS - 1))) >> F_BITS);
+		d[2] = clamp8(((fy - fz) * 200 + (128 << F_BITS) + (1 << (F_BITS - 1))) >> F_BITS);
+
+		if(size == 4)
+		{
+			d[3] = 0;
+		}
+	}
+}
+
+// the inverse of Lab's f for f in [-1, 2) in Q20, as Q20.
+
+static __inline int32_t cube_q(int32_t f)
+{
+	int32_t const shift = INV_BITS - INV_STEP_BITS;
+	int32_t k, frac;
+
+	f += 1 << INV_BITS;
+	k = f >> shift;
+	frac = f & ((1 << shift) - 1);
+
+	assert(k >= 0 && k <= INV_SIZE);
+	return g_inv[k] + (int32_t)(((int64_t)(g_inv[k + 1] - g_inv[k]) * frac) >> shift);
+}
+
+// linear light in Q40 to RGB8, clamped.
+
+static __inline uint8_t linear_q_to_rgb8(int64_t v)
+{
+	int64_t const one = (int64_t)1 << (INV_BITS * 2);
+	int const shift = INV_BITS * 2 - LIN_BITS;
+
+	return g_rgb8[v <= 0 ? 0 : v >= one ? 1 << LIN_BITS : (v + ((int64_t)1 << (shift - 1))) >> shift];
+}
+
+static void lab8_to_rgb8_run(uint8_t *d, uint8_t const *s, size_t size, size_t n)
+{
+	int64_t const *m = g_to_rgb;
+	size_t i;
+
+	for(i = 0; i < n; ++i, s += size, d += size)
+	{
+		int32_t fy = g_fy[s[0]];
+		int64_t X = cube_q(fy + g_fa[s[1]]);
+		int64_t Y = g_y[s[0]];
+		int64_t Z = cube_q(fy + g_fb[s[2]]);
+
+		d[0] = linear_q_to_rgb8(X * m[0] + Y * m[1] + Z * m[2]);
+		d[1] = linear_q_to_rgb8(X * m[3] + Y * m[4] + Z * m[5]);
+		d[2] = linear_q_to_rgb8(X * m[6] + Y * m[7] + Z * m[8]);
+
+		if(size == 4)
+		{
+			d[3] = 0;
+		}
+	}
+}
+
+static void code8_execute(void *dst, void const *src, enum color_format format, size_t count, void (*run)(uint8_t*, uint8_t const*, size_t, size_t))
+{
+	size_t size;
+	ptrdiff_t chunks, k;
+
+	assert((dst != NULL && src != NULL) || count == 0);
+	assert(format == COLOR_FORMAT_PACKED8 || format == COLOR_FORMAT_PACKED24);
+
+	color_call_once(&g_code8_state, code8_build);
+
+	size = color_format_size(format);
+	chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		size_t i = (size_t)k * COLOR_CHUNK;
+		size_t n = count - i < COLOR_CHUNK ? count - i : COLOR_CHUNK;
+
+		run((uint8_t*)dst + i * size, (uint8_t const*)src + i * size, size, n);
+	}
+}
+
+COLOR_EXPORT void COLOR_CALL color_rgb8_to_hsv8(void *dst, void const *src, enum color_format format, size_t count)
+{
+	code8_execute(dst, src, format, count, rgb8_to_hsv8_run);
+}
+
+COLOR_EXPORT void COLOR_CALL color_hsv8_to_rgb8(void *dst, void const *src, enum color_format format, size_t count)
+{
+	code8_execute(dst, src, format, count, hsv8_to_rgb8_run);
+}
+
+COLOR_EXPORT void COLOR_CALL color_rgb8_to_lab8(void *dst, void const *src, enum color_format format, size_t count)
+{
+	code8_execute(dst, src, format, count, rgb8_to_lab8_run);
+}
+
+COLOR_EXPORT void COLOR_CALL color_lab8_to_rgb8(void *dst, void const *src, enum color_format format, size_t count)
+{
+	code8_execute(dst, src, format, count, lab8_to_rgb8_run);
+}
@@ -0,0 +1,86 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Measured cost of each conversion, in tenths of a ns per color (x86-64,
+	scalar steps, from bench). color.c and color.hpp both route from this list:
+	define COLOR_EDGE_COST(from, to, cost) before including it. Every
+	conversion in color.c's g_descriptors must have a line here, so that both
+	routers see the same edges; color_routes_build asserts it.
+*/
+
+#ifndef COLOR_COSTS_H
+#define COLOR_COSTS_H
+
+// added to every step for the call and the trip through memory. it also makes
+// the router prefer fused shortcuts when costs are close, as they are usually
+// more accurate.
+#define COLOR_STEP_COST 40
+
+// what color.c charges, in release builds, for a conversion missing from the list.
+#define COLOR_DEFAULT_EDGE_COST 200
+
+#endif
+
+#ifdef COLOR_EDGE_COST
+
+COLOR_EDGE_COST(COLOR_RGB8, COLOR_RGB, 33)
+COLOR_EDGE_COST(COLOR_RGB8, COLOR_LINEAR_RGB, 22)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_RGB8, 57)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_LINEAR_RGB, 543)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_HSL, 57)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_HSV, 35)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_YUV, 31)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_YDBDR, 27)
+COLOR_EDGE_COST(COLOR_RGB, COLOR_YIQ, 27)
+COLOR_EDGE_COST(COLOR_LINEAR_RGB, COLOR_RGB8, 621)
+COLOR_EDGE_COST(COLOR_LINEAR_RGB, COLOR_RGB, 563)
+COLOR_EDGE_COST(COLOR_LINEAR_RGB, COLOR_XYZ, 33)
+COLOR_EDGE_COST(COLOR_LINEAR_RGB, COLOR_LAB, 507)
+COLOR_EDGE_COST(COLOR_HSL, COLOR_RGB, 89)
+COLOR_EDGE_COST(COLOR_HSV, COLOR_RGB, 96)
+COLOR_EDGE_COST(COLOR_YUV, COLOR_RGB, 25)
+COLOR_EDGE_COST(COLOR_YUV, COLOR_YCBCR, 41)
+COLOR_EDGE_COST(COLOR_YCBCR, COLOR_YUV, 26)
+COLOR_EDGE_COST(COLOR_YDBDR, COLOR_RGB, 23)
+COLOR_EDGE_COST(COLOR_YDBDR, COLOR_YIQ, 22)
+COLOR_EDGE_COST(COLOR_YIQ, COLOR_RGB, 25)
+COLOR_EDGE_COST(COLOR_YIQ, COLOR_YDBDR, 26)
+COLOR_EDGE_COST(COLOR_XYZ, COLOR_LINEAR_RGB, 28)
+COLOR_EDGE_COST(COLOR_XYZ, COLOR_XYY, 22)
+COLOR_EDGE_COST(COLOR_XYZ, COLOR_LAB, 440)
+COLOR_EDGE_COST(COLOR_XYZ, COLOR_LUV, 156)
+COLOR_EDGE_COST(COLOR_XYY, COLOR_XYZ, 27)
+COLOR_EDGE_COST(COLOR_LAB, COLOR_LINEAR_RGB, 40)
+COLOR_EDGE_COST(COLOR_LAB, COLOR_XYZ, 33)
+COLOR_EDGE_COST(COLOR_LAB, COLOR_LCHAB, 255)
+COLOR_EDGE_COST(COLOR_LUV, COLOR_XYZ, 41)
+COLOR_EDGE_COST(COLOR_LUV, COLOR_LCHUV, 142)
+COLOR_EDGE_COST(COLOR_LCHAB, COLOR_LAB, 193)
+COLOR_EDGE_COST(COLOR_LCHUV, COLOR_LUV, 138)
+COLOR_EDGE_COST(COLOR_LCHUV, COLOR_LSHUV, 20)
+COLOR_EDGE_COST(COLOR_LSHUV, COLOR_LCHUV, 22)
+
+#undef COLOR_EDGE_COST
+#endif
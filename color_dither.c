@@ -0,0 +1,523 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Dithering output stages. Colors of any type are streamed through a plan to
+	linear RGB and quantized to RGB8 or to a palette there, so that the average
+	light output is preserved rather than the average encoded value.
+
+	Ordered and blue-noise dithering are independent per pixel. Floyd-Steinberg
+	processes rows as a wavefront: a row may advance over pixel x once the row
+	above it has finished pixel x + 1. Serpentine scanning needs each row to
+	finish before the next one starts, so it runs on one thread.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+// ranks 0..63 of the classic Bayer matrix.
+
+static uint8_t const bayer8[8][8] =
+{
+	{  0, 32,  8, 40,  2, 34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44,  4, 36, 14, 46,  6, 38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{  3, 35, 11, 43,  1, 33,  9, 41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47,  7, 39, 13, 45,  5, 37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+// ranks 0..1023 of a tileable blue noise mask, from void-and-cluster (sigma = 1.5).
+
+static uint16_t const blue_noise32[32][32] =
+{
+	{  229,  354,  101,  303,  909,   38,  513,  645,  415,   23,  858,  121,  990,  518,  724,  356,  811,   25,  534,  939,  253,  479,   41,  287,  623,  503,    4,  743,  966,  390,  279,   21 },
+	{  689,  851,  758,  570,  152,  772,  264,  971,  172,  786,  473,  669,  188,  593,  258,  102, 1001,  685,  184,  780,  113,  568,  751,  905,  138, 1022,  203,  434,  553,  148,  803,  492 },
+	{  420,  164,  497,  973,  382,  607,  870,  344,  715,  557,  305,  912,  380,  825,  936,  488,  615,  286,  463,  385,  637,  959,  208,  449,  359,  799,  596,  854,  319,  901,  612,  983 },
+	{   70,  906,  271,    6,  682,  218,   54,  501,   96,  997,  224,   80,  734,    8,  424,  169,  791,   60,  919,  838,   19,  314,  820,  546,   53,  709,  277,   95,  691,   36,  214,  332 },
+	{  644,  558,  742,  455,  832,  954,  435,  666,  816,  396,  628,  806,  533,  318,  700,  897,  375,  556,  693,  225,  514,  726,  127,  650,  975,  175,  478,  935,  393,  537,  765,  874 },
+	{  400,  204, 1018,  334,  118,  567,  302,  902,  244,  137,  934,  436,  196, 1017,  634,  116,  238,  962,   88,  348, 1012,  411,  888,  270,  397,  860,  575,  778,  237,  991,  467,  140 },
+	{  837,  672,   83,  526,  785,  178,  741,   69,  522,  763,  324,  576,  106,  844,  281,  505,  771,  432,  641,  853,  144,  598,   71,  490,  752,   15,  329,  135,  657,   59,  727,  294 },
+	{   27,  447,  879,  246,  949,  405,  599, 1006,  416,  652,   43,  885,  681,  454,   31,  595,  866,  176,  284,  532,  767,  242,  706,  957,  191,  640, 1011,  443,  890,  355,  597,  944 },
+	{  762,  578,  349,  714,  639,   16,  231,  339,  845,  193,  984,  261,  365,  789,  977,  336,   78,  717,  988,    9,  452,  928,  363,  560,  301,  819,  525,  212,  807,  115,  515,  195 },
+	{  262,  926,   97,  163,  461,  914,  793,  665,   77,  561,  481,  737,  150,  538,  228,  675,  921,  482,  369,  810,  664,  186,   46,  875,  123,  401,   64,  732,  290,  646,  980,  412 },
+	{  687,  499,  805, 1000,  268,  536,  133,  426,  950,  306,  809,    2,  638,  916,   99,  413,  569,  128,  226,  586,  298,  849,  422,  655,  754,  970,  602,  924,  475,    0,  855,  132 },
+	{  316,   34,  377,  616,  750,  330,  883,  711,  165,  619,  392,  963,  450,  312,  847,  755,  276,  831,  694,  938,   90,  540, 1003,  267,  480,  200,  338,  141,  695,  367,  566,  790 },
+	{  965,  549,  892,  202,   52,  587,   87,  487,  273,  899,   91,  235,  722,  173,  610,   24,  509, 1021,   55,  464,  357,  768,  143,  621,   17,  834,  552,  884,  250, 1007,  190,  459 },
+	{  241,  108,  696,  438,  967,  801,  386, 1014,  761,  541,  684,  857,  486,  996,  372,  889,  199,  402,  631,  177,  821,  234,  708,  387,  942,  728,  433,   45,  775,  624,   66,  725 },
+	{  881,  643,  828,  275,  517,  157,  659,  220,   20,  419,  155,  331,   48,  574,  130,  663,  787,  320,  738,  898,  494,  961,   73,  535,  291,  180,  658,  313,  520,  407,  932,  346 },
+	{  483,  171,  361,    7,  720,  925,  317,  852,  609,  945,  784,  524,  913,  748,  282,  472,  933,  110,  554,    5,  299,  604,  428,  759,  848,  109,  998,  894,  207,  826,  131,  588 },
+	{   56, 1020,  564,  896,  414,   93,  559,  466,  122,  360,  265,  674,  210,  406,  823,   35,  591,  263,  982,  409,  688,  158,  880,  219,  613,  489,  376,  590,   85,  677,  296,  764 },
+	{  248,  425,  777,  205,  617,  798,  254,  992,  654,  827,   37, 1005,  104,  620,  960,  187,  712,  440,  839,  227,  797, 1013,   40,  328,  951,   61,  782,  266,  465,  987,  542,  862 },
+	{  713,  635,  315,  125,  969,  352,   29,  735,  167,  410,  572,  477,  872,  353,  521,  310,  895,  134,  626,   75,  519,  364,  562,  730,  421,  679,  166,  868,  736,   10,  391,  146 },
+	{  943,   33,  836,  531,  697,  460,  886,  527,  325,  948,  757,  293,  153,  718,   50,  781,  543,  350,  955,  746,  272,  668,  114,  864,  257,  544,  972,  321,  627,  201,  900,  500 },
+	{  347,  457,  211,  911,   65,  233,  608,  112,  841,  216,   67,  636,  815,  439,  989,  230,  661,   26,  468,  183,  833,  437,  929,  189,  804,   30,  394,  100,  453,  788,  280,  606 },
+	{  119,  994,  649,  323,  779,  398,  979,  673,  441,  710,  507,  915,  236,  582,   89,  399,  813,  908,  601,  322,  995,   12,  583,  307,  485,  642,  893,  571,  703, 1008,   49,  817 },
+	{  245,  744,  498,  151,  563,  867,  181,  309,   14, 1015,  384,  117,  341,  941,  701,  495,  142,  252,  723,   84,  504,  776,  383,  707,  981,  160,  773,  240,  124,  362,  545,  671 },
+	{  887,  379,    1,  937,  692,   82,  511,  812,  585,  259,  859,  774,  551,  182,  850,  300, 1019,  548,  373,  861,  632,  239,  129,  877,   63,  445,  342,  947,  506,  876,  170,  430 },
+	{   92,  579,  842,  442,  274,  366,  731,  922,  470,  162,  611,   62,  686,  444,   42,  633,  756,   94,  930,  159,  427,  964,  660,  530,  283,  745,  630,   13,  808,  288,  733,  953 },
+	{  215,  311,  766,  168, 1002,  622,  206,   51,  343,  704,  952,  404,  278,  794,  958,  381,  223,  458,  676,  285,  818,   47,  345,  796,  185, 1016,  550,  222,  678,  474,   44,  625 },
+	{  523,  985,  667,  491,   98,  829,  423,  769,  978,  105,  508,  198,  907,  529,  145,  592,  878,   22,  770,  581,  516,  209,  920,  603,  388,   79,  835,  418,  139,  974,  374,  824 },
+	{  126,  358,   28,  249,  577,  903,  295,  539,  629,  251,  760,  856,    3,  351,  740,  260,  502,  976,  333,  120, 1004,  683,  451,  111,  882,  484,  699,  308,  869,  589,  247,  716 },
+	{  456,  873,  739,  931,  378,  690,  154,   18,  814,  371,  446,  647,  555, 1009,  103,  830,  662,  174,  417,  802,  269,   11,  753,  304,  653,  243,  940,   32,  749,  512,   68,  927 },
+	{  197,  600,  292,  528,   76,  783,  476, 1023,  194,  891,   72,  161,  297,  698,  471,  389,   57,  918,  614,  496,  904,  370,  840,  510,  986,  147,  573,  368,  192,  999,  326,  656 },
+	{  403,   58,  822,  179,  968,  232,  594,  327,  680,  493,  729,  946,  800,  221,  618,  956,  289,  747,  213,   81,  648,  149,  584,  217,   74,  792,  448,  670,  846,  469,  136,  795 },
+	{  547, 1010,  651,  462,  705,  395,  843,  107,  923,  255,  580,  340,  431,   39,  871,  156,  565,  429,  863,  337,  719,  993,  408,  865,  702,  335,  910,  256,   86,  605,  721,  917 }
+};
+
+struct dither_ctx
+{
+	struct color_image const *img;
+	struct color_plan plan;
+	enum color_dither method;
+
+	// palette output only.
+	uint8_t *indices;
+	double const *palette; // linear RGB, 3 per color.
+	unsigned colors;
+};
+
+static double dither_threshold(enum color_dither method, size_t x, size_t y)
+{
+	switch(method)
+	{
+	case COLOR_DITHER_ORDERED:
+		return (bayer8[y & 7][x & 7] + 0.5) * (1.0 / 64.0);
+	case COLOR_DITHER_BLUE_NOISE:
+		return (blue_noise32[y & 31][x & 31] + 0.5) * (1.0 / 1024.0);
+	default:
+		return 0.5;
+	}
+}
+
+// largest code whose linear value is <= c.
+
+static int linear_floor_rgb8(double c)
+{
+	int k = 0, step;
+
+	for(step = 128; step; step >>= 1)
+	{
+		if(k + step <= 255 && color_rgb8_linear_tbl[k + step] <= c)
+		{
+			k += step;
+		}
+	}
+
+	return k;
+}
+
+static uint8_t quantize_rgb8(double *v, double t)
+{
+	double lo, hi;
+	int k;
+
+	k = linear_floor_rgb8(*v);
+
+	if(k == 255)
+	{
+		*v -= 1.0;
+		return 255;
+	}
+
+	lo = color_rgb8_linear_tbl[k];
+	hi = color_rgb8_linear_tbl[k + 1];
+
+	// round up when v is further than t of the way between the two codes.
+
+	if(*v - lo > (hi - lo) * t)
+	{
+		*v -= hi;
+		return (uint8_t)(k + 1);
+	}
+
+	*v -= lo;
+	return (uint8_t)k;
+}
+
+// dithers between the nearest palette entry and the next nearest: v is projected onto the
+// segment between them, and the fraction of the way along it is compared against t as
+// quantize_rgb8 does per channel. the mean index then follows v in any direction, not only
+// along gray. v is never more than halfway along, so a threshold of 0.5 keeps the nearest.
+
+static uint8_t quantize_palette(struct dither_ctx const *ctx, double *v, double t)
+{
+	double best = DBL_MAX, second = DBL_MAX;
+	double const *pal = ctx->palette;
+	unsigned i, ret = 0, next = 0;
+
+	for(i = 0; i < ctx->colors; ++i)
+	{
+		double dx = pal[i * 3 + 0] - v[0];
+		double dy = pal[i * 3 + 1] - v[1];
+		double dz = pal[i * 3 + 2] - v[2];
+		double d = dx * dx + dy * dy + dz * dz;
+
+		if(d < best)
+		{
+			second = best;
+			next = ret;
+			best = d;
+			ret = i;
+		}
+		else if(d < second)
+		{
+			second = d;
+			next = i;
+		}
+	}
+
+	if(ctx->colors > 1)
+	{
+		double e[3], len, f;
+
+		e[0] = pal[next * 3 + 0] - pal[ret * 3 + 0];
+		e[1] = pal[next * 3 + 1] - pal[ret * 3 + 1];
+		e[2] = pal[next * 3 + 2] - pal[ret * 3 + 2];
+		len = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+
+		if(len > 0.0)
+		{
+			f = ((v[0] - pal[ret * 3 + 0]) * e[0] + (v[1] - pal[ret * 3 + 1]) * e[1] + (v[2] - pal[ret * 3 + 2]) * e[2]) / len;
+
+			if(f > t)
+			{
+				ret = next;
+			}
+		}
+	}
+
+	v[0] -= pal[ret * 3 + 0];
+	v[1] -= pal[ret * 3 + 1];
+	v[2] -= pal[ret * 3 + 2];
+
+	return (uint8_t)ret;
+}
+
+// dithers n pixels of row y starting at x0. for error diffusion, cur holds the
+// error carried into this row and next receives the error for the row below,
+// both offset by one pixel so that x - 1 and x + 1 are always valid. carry is
+// the error moving along the row.
+
+static void dither_span(struct dither_ctx const *ctx, size_t y, size_t x0, size_t n, double *cur, double *next, double *carry, int dir)
+{
+	struct color buf[COLOR_CHUNK];
+	struct color *row;
+	size_t i;
+
+	assert(n <= COLOR_CHUNK);
+
+	row = ctx->img->pixels + ctx->img->stride * y + x0;
+
+	memcpy(buf, row, n * sizeof(struct color));
+	color_plan_execute(&ctx->plan, buf, n);
+
+	for(i = 0; i < n; ++i)
+	{
+		size_t k = dir > 0 ? i : n - 1 - i;
+		size_t x = x0 + k;
+		double v[3], t;
+		int j;
+
+		v[0] = buf[k].LinearRGB.R;
+		v[1] = buf[k].LinearRGB.G;
+		v[2] = buf[k].LinearRGB.B;
+
+		if(cur)
+		{
+			for(j = 0; j < 3; ++j)
+			{
+				v[j] += cur[(x + 1) * 3 + j] + carry[j];
+			}
+		}
+
+		for(j = 0; j < 3; ++j)
+		{
+			v[j] = v[j] < 0.0 ? 0.0 : v[j] > 1.0 ? 1.0 : v[j];
+		}
+
+		t = dither_threshold(ctx->method, x, y);
+
+		if(ctx->indices)
+		{
+			ctx->indices[ctx->img->width * y + x] = quantize_palette(ctx, v, t);
+		}
+		else
+		{
+			row[k].type = COLOR_RGB8;
+			row[k].extra = 0;
+			row[k].RGB8.R = quantize_rgb8(&v[0], t);
+			row[k].RGB8.G = quantize_rgb8(&v[1], t);
+			row[k].RGB8.B = quantize_rgb8(&v[2], t);
+		}
+
+		if(cur)
+		{
+			// v now holds the quantization error.
+
+			for(j = 0; j < 3; ++j)
+			{
+				carry[j] = v[j] * (7.0 / 16.0);
+				next[(x + 1 - dir) * 3 + j] += v[j] * (3.0 / 16.0);
+				next[(x + 1) * 3 + j] += v[j] * (5.0 / 16.0);
+				next[(x + 1 + dir) * 3 + j] += v[j] * (1.0 / 16.0);
+			}
+		}
+	}
+}
+
+static void dither_ordered(struct dither_ctx const *ctx)
+{
+	struct color_image const *img = ctx->img;
+	ptrdiff_t y;
+
+#pragma omp parallel for schedule(dynamic, 1) if(img->width * img->height >= COLOR_PARALLEL_MIN)
+	for(y = 0; y < (ptrdiff_t)img->height; ++y)
+	{
+		size_t x, n;
+
+		for(x = 0; x < img->width; x += n)
+		{
+			n = img->width - x < COLOR_CHUNK ? img->width - x : COLOR_CHUNK;
+			dither_span(ctx, y, x, n, NULL, NULL, NULL, 1);
+		}
+	}
+}
+
+static int dither_serpentine(struct dither_ctx const *ctx)
+{
+	struct color_image const *img = ctx->img;
+	size_t row_size, x, y, n;
+	double *err, *cur, *next, *tmp, carry[3];
+
+	row_size = (img->width + 2) * 3;
+	err = (double*)calloc(row_size * 2, sizeof(double));
+
+	if(!err)
+	{
+		return 0;
+	}
+
+	cur = err;
+	next = err + row_size;
+
+	for(y = 0; y < img->height; ++y)
+	{
+		carry[0] = carry[1] = carry[2] = 0.0;
+
+		if(y & 1)
+		{
+			for(x = img->width; x; x -= n)
+			{
+				n = x < COLOR_CHUNK ? x : COLOR_CHUNK;
+				dither_span(ctx, y, x - n, n, cur, next, carry, -1);
+			}
+		}
+		else
+		{
+			for(x = 0; x < img->width; x += n)
+			{
+				n = img->width - x < COLOR_CHUNK ? img->width - x : COLOR_CHUNK;
+				dither_span(ctx, y, x, n, cur, next, carry, 1);
+			}
+		}
+
+		tmp = cur;
+		cur = next;
+		next = tmp;
+
+		memset(next, 0, row_size * sizeof(double));
+	}
+
+	free(err);
+	return 1;
+}
+
+static int dither_wavefront(struct dither_ctx const *ctx)
+{
+	struct color_image const *img = ctx->img;
+	size_t *progress;
+	size_t row_size, rows;
+	double *err;
+	int threads;
+
+	threads = img->width * img->height >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+
+	// rows in flight share a ring of error buffers. a row may only clear the
+	// buffer it writes once the row that last read it has finished.
+
+	rows = (size_t)threads * 2 + 1;
+	row_size = (img->width + 2) * 3;
+
+	err = (double*)calloc(row_size * rows, sizeof(double));
+	progress = (size_t*)calloc(img->height, sizeof(size_t));
+
+	if(!err || !progress)
+	{
+		free(err);
+		free(progress);
+		return 0;
+	}
+
+#pragma omp parallel num_threads(threads)
+	{
+		ptrdiff_t y;
+
+#pragma omp for schedule(static, 1)
+		for(y = 0; y < (ptrdiff_t)img->height; ++y)
+		{
+			double *cur = err + row_size * (y % rows);
+			double *next = err + row_size * ((y + 1) % rows);
+			double carry[3] = { 0.0, 0.0, 0.0 };
+			size_t x, n, need;
+
+			if(y + 1 >= (ptrdiff_t)rows)
+			{
+				while(color_load_acquire_size(&progress[y + 1 - rows]) < img->width)
+				{
+					color_pause();
+				}
+			}
+
+			memset(next, 0, row_size * sizeof(double));
+
+			for(x = 0; x < img->width; x += n)
+			{
+				n = img->width - x < COLOR_CHUNK ? img->width - x : COLOR_CHUNK;
+
+				if(y)
+				{
+					need = x + n + 1 < img->width ? x + n + 1 : img->width;
+
+					while(color_load_acquire_size(&progress[y - 1]) < need)
+					{
+						color_pause();
+					}
+				}
+
+				dither_span(ctx, y, x, n, cur, next, carry, 1);
+
+				// a release store, so the errors this span wrote are visible before progress reads x + n.
+				color_store_release_size(&progress[y], x + n);
+			}
+		}
+	}
+
+	free(err);
+	free(progress);
+	return 1;
+}
+
+static int dither_run(struct dither_ctx *ctx)
+{
+	struct color_image const *img = ctx->img;
+
+	assert(img != NULL);
+	assert(img->pixels != NULL || !img->width || !img->height);
+	assert(img->stride >= img->width);
+
+	if(!img->width || !img->height)
+	{
+		return 1;
+	}
+
+	color_plan_init(&ctx->plan, (enum color_type)img->pixels[0].type, img->pixels[0].extra, COLOR_LINEAR_RGB, 0);
+
+	switch(ctx->method)
+	{
+	case COLOR_DITHER_ORDERED:
+	case COLOR_DITHER_BLUE_NOISE:
+		dither_ordered(ctx);
+		return 1;
+	case COLOR_DITHER_FLOYD_STEINBERG:
+		return dither_wavefront(ctx);
+	case COLOR_DITHER_FLOYD_STEINBERG_SERPENTINE:
+		return dither_serpentine(ctx);
+	default:
+		assert(0);
+		return 0;
+	}
+}
+
+COLOR_EXPORT int COLOR_CALL color_dither_rgb8(struct color_image const *img, enum color_dither method)
+{
+	struct dither_ctx ctx;
+
+	ctx.img = img;
+	ctx.method = method;
+	ctx.indices = NULL;
+	ctx.palette = NULL;
+	ctx.colors = 0;
+
+	return dither_run(&ctx);
+}
+
+COLOR_EXPORT int COLOR_CALL color_dither_palette(uint8_t *indices, struct color_image const *img, struct color const *palette, unsigned colors, enum color_dither method)
+{
+	struct dither_ctx ctx;
+	double *pal;
+	unsigned i;
+	int ret;
+
+	assert(indices != NULL);
+	assert(palette != NULL);
+	assert(colors >= 1 && colors <= 256);
+
+	pal = (double*)malloc(sizeof(double) * 3 * colors);
+
+	if(!pal)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < colors; ++i)
+	{
+		struct color c = palette[i];
+
+		color_convert(&c, COLOR_LINEAR_RGB, 0);
+
+		pal[i * 3 + 0] = c.LinearRGB.R;
+		pal[i * 3 + 1] = c.LinearRGB.G;
+		pal[i * 3 + 2] = c.LinearRGB.B;
+	}
+
+	ctx.img = img;
+	ctx.method = method;
+	ctx.indices = indices;
+	ctx.palette = pal;
+	ctx.colors = colors;
+
+	ret = dither_run(&ctx);
+
+	free(pal);
+	return ret;
+}
@@ -0,0 +1,347 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Memory-mapped file conversion. Source and destination are mapped a window
+	at a time; each window runs through color_plan_execute_packed, which
+	converts it in parallel through a per-thread buffer of struct color. Only
+	the two mapped windows are ever resident on our account, whatever the
+	file size.
+
+	Windows are a whole number of colors and start on a multiple of 64 KiB in
+	both files, which satisfies mmap's page alignment and Windows' allocation
+	granularity.
+*/
+
+#ifndef _WIN32
+// 64-bit off_t, for files over 2 GiB on 32-bit systems.
+#define _FILE_OFFSET_BITS 64
+// dev_t, ino_t, ftruncate and posix_madvise, which strict C11 modes hide.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define COLOR_EXPORTS
+
+#include <assert.h>
+#include <stdio.h>
+#include "color_internal.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// colors per window. times any format size, a multiple of 64 KiB.
+#define WINDOW_COLORS ((size_t)1 << 20)
+
+#ifdef _WIN32
+
+struct mapped_file
+{
+	HANDLE file, mapping;
+	BY_HANDLE_FILE_INFORMATION info; // identifies the file, to tell when both paths name it.
+};
+
+static int open_source(struct mapped_file *f, char const *path, uint64_t *size)
+{
+	LARGE_INTEGER li;
+
+	f->mapping = NULL;
+	f->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if(f->file == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+
+	if(!GetFileInformationByHandle(f->file, &f->info) || !GetFileSizeEx(f->file, &li))
+	{
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	*size = (uint64_t)li.QuadPart;
+
+	// an empty file can't be mapped, and has nothing to map.
+	if(*size != 0 && !(f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READONLY, 0, 0, NULL)))
+	{
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	return 1;
+}
+
+// opens the destination without truncating it, so that it can first be checked against the
+// source. returns -1 on a failure that leaves the destination as it was, and 0 on one that
+// leaves it to be removed: a file this call created, or one it has already resized.
+
+static int open_destination(struct mapped_file *f, struct mapped_file const *src, char const *path, uint64_t size)
+{
+	LARGE_INTEGER li;
+	int created;
+
+	f->mapping = NULL;
+	f->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if(f->file == INVALID_HANDLE_VALUE)
+	{
+		return -1;
+	}
+
+	// OPEN_ALWAYS reports an existing file through the last error, even on success.
+	created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+	if(!GetFileInformationByHandle(f->file, &f->info))
+	{
+		CloseHandle(f->file);
+		return created ? 0 : -1;
+	}
+
+	if(f->info.dwVolumeSerialNumber == src->info.dwVolumeSerialNumber &&
+		f->info.nFileIndexHigh == src->info.nFileIndexHigh && f->info.nFileIndexLow == src->info.nFileIndexLow)
+	{
+		CloseHandle(f->file);
+		return -1;
+	}
+
+	li.QuadPart = (LONGLONG)size;
+
+	// the mapping would only extend the file, so set its size first.
+	if(!SetFilePointerEx(f->file, li, NULL, FILE_BEGIN) || !SetEndOfFile(f->file))
+	{
+		CloseHandle(f->file);
+		return created ? 0 : -1;
+	}
+
+	if(size != 0 && !(f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL)))
+	{
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void *map_window(struct mapped_file const *f, uint64_t offset, size_t size, int writable)
+{
+	return MapViewOfFile(f->mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset, size);
+}
+
+static void unmap_window(void *p, size_t size)
+{
+	(void)size;
+	UnmapViewOfFile(p);
+}
+
+static void close_file(struct mapped_file *f)
+{
+	if(f->mapping) CloseHandle(f->mapping);
+	CloseHandle(f->file);
+}
+
+#else
+
+struct mapped_file
+{
+	int fd;
+	dev_t dev; // identifies the file, to tell when both paths name it.
+	ino_t ino;
+};
+
+static int open_source(struct mapped_file *f, char const *path, uint64_t *size)
+{
+	struct stat st;
+
+	f->fd = open(path, O_RDONLY);
+
+	if(f->fd < 0)
+	{
+		return 0;
+	}
+
+	if(fstat(f->fd, &st))
+	{
+		close(f->fd);
+		return 0;
+	}
+
+	f->dev = st.st_dev;
+	f->ino = st.st_ino;
+	*size = (uint64_t)st.st_size;
+	return 1;
+}
+
+// opens the destination without truncating it, so that it can first be checked against the
+// source. returns -1 on a failure that leaves the destination as it was, and 0 on one that
+// leaves a file this call created, to be removed.
+
+static int open_destination(struct mapped_file *f, struct mapped_file const *src, char const *path, uint64_t size)
+{
+	struct stat st;
+	int created = 1;
+
+	// O_EXCL first, to know whether the file is this call's to remove.
+	f->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0666);
+
+	if(f->fd < 0 && errno == EEXIST)
+	{
+		created = 0;
+		f->fd = open(path, O_RDWR);
+	}
+
+	if(f->fd < 0)
+	{
+		return -1;
+	}
+
+	if(fstat(f->fd, &st))
+	{
+		close(f->fd);
+		return created ? 0 : -1;
+	}
+
+	if(st.st_dev == src->dev && st.st_ino == src->ino)
+	{
+		close(f->fd);
+		return -1;
+	}
+
+	f->dev = st.st_dev;
+	f->ino = st.st_ino;
+
+	// any old contents past size go; the rest is overwritten.
+	if(ftruncate(f->fd, (off_t)size))
+	{
+		close(f->fd);
+		return created ? 0 : -1;
+	}
+
+	return 1;
+}
+
+static void *map_window(struct mapped_file const *f, uint64_t offset, size_t size, int writable)
+{
+	void *p = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, f->fd, (off_t)offset);
+
+	if(p == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	// the window is walked front to back once: read ahead aggressively, and drop pages behind.
+	posix_madvise(p, size, POSIX_MADV_SEQUENTIAL);
+
+	return p;
+}
+
+static void unmap_window(void *p, size_t size)
+{
+	munmap(p, size);
+}
+
+static void close_file(struct mapped_file *f)
+{
+	close(f->fd);
+}
+
+#endif
+
+COLOR_EXPORT int COLOR_CALL color_convert_file(char const *dst_path, enum color_format dst_format, char const *src_path, enum color_format src_format, struct color_plan const *plan)
+{
+	struct mapped_file src, dst;
+	uint64_t src_bytes, count, first;
+	size_t src_size, dst_size;
+	int ok = 1, opened;
+
+	assert(dst_path != NULL);
+	assert(src_path != NULL);
+	assert(plan != NULL);
+
+	src_size = color_format_size(src_format);
+	dst_size = color_format_size(dst_format);
+
+	if(!open_source(&src, src_path, &src_bytes))
+	{
+		return 0;
+	}
+
+	count = src_bytes / src_size;
+
+	if(count * src_size != src_bytes || count > (uint64_t)-1 / dst_size)
+	{
+		close_file(&src);
+		return 0;
+	}
+
+	opened = open_destination(&dst, &src, dst_path, count * dst_size);
+
+	if(opened <= 0)
+	{
+		close_file(&src);
+
+		if(opened == 0)
+		{
+			remove(dst_path);
+		}
+
+		return 0;
+	}
+
+	for(first = 0; first < count && ok; first += WINDOW_COLORS)
+	{
+		size_t n = count - first < WINDOW_COLORS ? (size_t)(count - first) : WINDOW_COLORS;
+		void *in = map_window(&src, first * src_size, n * src_size, 0);
+		void *out = map_window(&dst, first * dst_size, n * dst_size, 1);
+
+		if(in && out)
+		{
+			color_plan_execute_packed(plan, out, dst_format, in, src_format, n);
+		}
+		else
+		{
+			ok = 0;
+		}
+
+		if(in) unmap_window(in, n * src_size);
+		if(out) unmap_window(out, n * dst_size);
+	}
+
+	close_file(&dst);
+	close_file(&src);
+
+	// don't leave a partly written file behind.
+	if(!ok)
+	{
+		remove(dst_path);
+	}
+
+	return ok;
+}
@@ -0,0 +1,216 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Gradient generation. Stops are converted to the interpolation space once,
+	and the route to the output type is planned once; samples are then
+	interpolated and converted a chunk at a time, and packed straight into the
+	caller's buffer.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+static double const achromatic = 1e-6;
+
+struct gradient_segment
+{
+	double t0, inv_len;
+	double base[3], delta[3];
+};
+
+// the period of the space's hue component, or 0 if it has none. hue is always
+// component 0 or 2, and chroma/saturation is always component 1.
+
+static double hue_period(enum color_type space, int *component)
+{
+	switch(space)
+	{
+	case COLOR_HSL:
+	case COLOR_HSV:
+		*component = 0;
+		return 6.0;
+	case COLOR_LCHAB:
+	case COLOR_LCHUV:
+	case COLOR_LSHUV:
+		*component = 2;
+		return 3.1415926535897932384626433833 * 2.0;
+	default:
+		*component = -1;
+		return 0.0;
+	}
+}
+
+static double hue_delta(double d, double period, enum color_hue_mode mode)
+{
+	d = fmod(d, period);
+
+	switch(mode)
+	{
+	case COLOR_HUE_SHORTER:
+		if(d > period * 0.5) d -= period;
+		else if(d < period * -0.5) d += period;
+		break;
+	case COLOR_HUE_LONGER:
+		if(d > 0.0 && d < period * 0.5) d -= period;
+		else if(d <= 0.0 && d > period * -0.5) d += period;
+		break;
+	case COLOR_HUE_INCREASING:
+		if(d < 0.0) d += period;
+		break;
+	case COLOR_HUE_DECREASING:
+		if(d > 0.0) d -= period;
+		break;
+	default:
+		assert(0);
+	}
+
+	return d;
+}
+
+COLOR_EXPORT int COLOR_CALL color_gradient(void *dst, enum color_format dst_format, size_t samples, struct color const *stops, double const *positions, size_t count,
+	enum color_type space, enum color_hue_mode hue_mode, enum color_type out_type, uint8_t out_extra)
+{
+	struct color buf[COLOR_CHUNK];
+	struct gradient_segment *seg;
+	struct color_plan plan;
+	double (*vals)[3], period, step;
+	size_t i, j, s, dst_size;
+	int hue;
+
+	assert(dst != NULL || samples == 0);
+	assert(stops != NULL);
+	assert(count >= 1);
+	assert(space > COLOR_NONE && space < COLOR_DUMMY_END);
+	assert(space != COLOR_RGB8 && space != COLOR_YCBCR);
+
+	if(!samples)
+	{
+		return 1;
+	}
+
+	vals = (double(*)[3])malloc(sizeof(double) * 3 * count);
+	seg = (struct gradient_segment*)malloc(sizeof(struct gradient_segment) * count);
+
+	if(!vals || !seg)
+	{
+		free(vals);
+		free(seg);
+		return 0;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		struct color c = stops[i];
+
+		color_convert(&c, space, 0);
+		color_extract_components(vals[i], &c);
+	}
+
+	period = hue_period(space, &hue);
+
+	for(i = 0; i < count; ++i)
+	{
+		size_t next = i + 1 < count ? i + 1 : i;
+		double t0 = positions ? positions[i] : count > 1 ? (double)i / (double)(count - 1) : 0.0;
+		double t1 = positions ? positions[next] : count > 1 ? (double)next / (double)(count - 1) : 0.0;
+
+		assert(t1 >= t0);
+
+		seg[i].t0 = t0;
+		seg[i].inv_len = t1 > t0 ? 1.0 / (t1 - t0) : 0.0;
+
+		for(j = 0; j < 3; ++j)
+		{
+			seg[i].base[j] = vals[i][j];
+			seg[i].delta[j] = vals[next][j] - vals[i][j];
+		}
+
+		if(hue >= 0)
+		{
+			// a stop with no chroma has no meaningful hue. within each segment it takes the
+			// hue of the other end, so that the gradient does not swing through unrelated
+			// hues. an interior gray stop can so have a different hue on either side.
+			// grays coming from RGB are only achromatic to within rounding.
+
+			double h0 = vals[i][hue], h1 = vals[next][hue];
+			int gray0 = fabs(vals[i][1]) < achromatic, gray1 = fabs(vals[next][1]) < achromatic;
+
+			if(gray0 && !gray1) h0 = h1;
+			else if(gray1 && !gray0) h1 = h0;
+
+			seg[i].base[hue] = h0;
+			seg[i].delta[hue] = hue_delta(h1 - h0, period, hue_mode);
+		}
+	}
+
+	color_plan_init(&plan, space, 0, out_type, out_extra);
+	dst_size = color_format_size(dst_format);
+
+	step = samples > 1 ? 1.0 / (double)(samples - 1) : 0.0;
+	s = 0;
+
+	for(i = 0; i < samples; i += COLOR_CHUNK)
+	{
+		size_t n = samples - i < COLOR_CHUNK ? samples - i : COLOR_CHUNK;
+
+		for(j = 0; j < n; ++j)
+		{
+			double t = (i + j) * step, f, v[3];
+			struct gradient_segment const *g;
+			int k;
+
+			// samples are increasing, so the segment only ever moves forward.
+
+			while(s + 1 < count && t >= seg[s + 1].t0) ++s;
+
+			g = &seg[s];
+			f = (t - g->t0) * g->inv_len;
+			f = f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+
+			for(k = 0; k < 3; ++k)
+			{
+				v[k] = g->delta[k] * f + g->base[k];
+			}
+
+			if(hue >= 0)
+			{
+				v[hue] -= floor(v[hue] / period) * period;
+			}
+
+			color_set_components(&buf[j], space, 0, v);
+		}
+
+		color_plan_execute_packed(&plan, (char*)dst + i * dst_size, dst_format, buf, COLOR_FORMAT_COLOR, n);
+	}
+
+	free(vals);
+	free(seg);
+	return 1;
+}
@@ -0,0 +1,223 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Opt-in instrumentation, compiled in with COLOR_INSTRUMENT. Each thread
+	counts calls and colors per conversion edge in its own table, so counting
+	needs no synchronization. Tables are linked into a global list when first
+	used and summed when read. They are never freed, so counts from threads
+	that have exited are kept.
+*/
+
+#define COLOR_EXPORTS
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+#define EDGE_COUNT ((COLOR_DUMMY_END - 1) * (COLOR_DUMMY_END - 1))
+
+#ifdef COLOR_INSTRUMENT
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define THREAD_LOCAL __declspec(thread)
+#else
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include <time.h>
+#define THREAD_LOCAL __thread
+#endif
+
+struct thread_edges
+{
+	struct color_edge_stats edges[EDGE_COUNT];
+	struct thread_edges *next;
+};
+
+static struct thread_edges *volatile g_threads;
+static THREAD_LOCAL struct thread_edges *t_edges;
+
+static struct thread_edges* compare_exchange(struct thread_edges *volatile *dst, struct thread_edges *value, struct thread_edges *comparand)
+{
+#ifdef _MSC_VER
+	return (struct thread_edges*)_InterlockedCompareExchangePointer((void *volatile*)dst, value, comparand);
+#else
+	return __sync_val_compare_and_swap(dst, comparand, value);
+#endif
+}
+
+uint64_t color_instrument_cycles(void)
+{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	// no cycle counter; nanoseconds stand in for cycles.
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+struct color_edge_stats* color_instrument_thread(void)
+{
+	static struct color_edge_stats discard[EDGE_COUNT];
+	struct thread_edges *t, *head;
+
+	if(t_edges)
+	{
+		return t_edges->edges;
+	}
+
+	t = (struct thread_edges*)calloc(1, sizeof(struct thread_edges));
+
+	if(!t)
+	{
+		// counts from this call are lost, but conversion continues.
+		return discard;
+	}
+
+	do
+	{
+		head = g_threads;
+		t->next = head;
+	}
+	while(compare_exchange(&g_threads, t, head) != head);
+
+	t_edges = t;
+	return t->edges;
+}
+
+#endif
+
+COLOR_EXPORT int COLOR_CALL color_instrument_enabled(void)
+{
+#ifdef COLOR_INSTRUMENT
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+COLOR_EXPORT void COLOR_CALL color_instrument_snapshot(struct color_edge_stats *dst)
+{
+#ifdef COLOR_INSTRUMENT
+	struct thread_edges const *t;
+	int i;
+#endif
+
+	assert(dst != NULL);
+
+	memset(dst, 0, sizeof(struct color_edge_stats) * EDGE_COUNT);
+
+#ifdef COLOR_INSTRUMENT
+	for(t = g_threads; t; t = t->next)
+	{
+		for(i = 0; i < EDGE_COUNT; ++i)
+		{
+			dst[i].calls += t->edges[i].calls;
+			dst[i].colors += t->edges[i].colors;
+			dst[i].cycles += t->edges[i].cycles;
+			dst[i].sampled_colors += t->edges[i].sampled_colors;
+		}
+	}
+#endif
+}
+
+COLOR_EXPORT void COLOR_CALL color_instrument_reset(void)
+{
+#ifdef COLOR_INSTRUMENT
+	struct thread_edges *t;
+
+	for(t = g_threads; t; t = t->next)
+	{
+		memset(t->edges, 0, sizeof t->edges);
+	}
+#endif
+}
+
+// once a line does not fit, nothing more is written, but the length keeps counting.
+
+static void append(char *dst, size_t size, size_t *len, int *full, char const *line)
+{
+	size_t n = strlen(line);
+
+	if(!*full && *len + n < size)
+	{
+		memcpy(dst + *len, line, n + 1);
+	}
+	else
+	{
+		*full = 1;
+	}
+
+	*len += n;
+}
+
+COLOR_EXPORT size_t COLOR_CALL color_instrument_format(char *dst, size_t size)
+{
+	struct color_edge_stats edges[EDGE_COUNT];
+	char line[160];
+	size_t len = 0;
+	int from, to, full = 0;
+
+	assert(dst != NULL || size == 0);
+
+	color_instrument_snapshot(edges);
+
+	if(size)
+	{
+		dst[0] = '\0';
+	}
+
+	sprintf(line, "%-12s %-12s %20s %20s %12s\n", "from", "to", "calls", "colors", "cycles/color");
+	append(dst, size, &len, &full, line);
+
+	for(from = 1; from < COLOR_DUMMY_END; ++from)
+	{
+		for(to = 1; to < COLOR_DUMMY_END; ++to)
+		{
+			struct color_edge_stats const *e = &edges[(from - 1) * (COLOR_DUMMY_END - 1) + (to - 1)];
+
+			if(!e->calls)
+			{
+				continue;
+			}
+
+			sprintf(line, "%-12s %-12s %20llu %20llu %12.1f\n",
+				color_name((enum color_type)from), color_name((enum color_type)to),
+				(unsigned long long)e->calls, (unsigned long long)e->colors,
+				e->sampled_colors ? (double)e->cycles / (double)e->sampled_colors : 0.0);
+
+			append(dst, size, &len, &full, line);
+		}
+	}
+
+	return len;
+}
@@ -0,0 +1,227 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Shared between the library's translation units; not part of the public API.
+
+	Multithreading is done with OpenMP. When built without it the pragmas are
+	ignored and everything runs on the calling thread.
+*/
+
+#pragma once
+
+#include "color.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _MSC_VER
+#define COLOR_ALIGN(n) __declspec(align(n))
+#else
+#define COLOR_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+// colors converted at a time when streaming through a plan. small enough to stay in L1.
+#define COLOR_CHUNK 256
+
+// below this many colors, threading costs more than it saves.
+#define COLOR_PARALLEL_MIN 16384
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// half float conversions in hardware. MSVC has no switch of its own for F16C; it comes with /arch:AVX2.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define COLOR_F16C
+#include <immintrin.h>
+#endif
+
+typedef void (*conversion_func)(struct color*, uint8_t);
+typedef void (*batch_conversion_func)(struct color*, size_t, uint8_t);
+
+// same results as linear_to_rgb8, by a branchless search of its thresholds.
+
+static __inline uint8_t color_linear_to_rgb8_fast(double c)
+{
+	double const *t = color_linear_rgb8_thresholds;
+	unsigned k = 0;
+
+	k += c >= t[k + 128] ? 128 : 0;
+	k += c >= t[k + 64] ? 64 : 0;
+	k += c >= t[k + 32] ? 32 : 0;
+	k += c >= t[k + 16] ? 16 : 0;
+	k += c >= t[k + 8] ? 8 : 0;
+	k += c >= t[k + 4] ? 4 : 0;
+	k += c >= t[k + 2] ? 2 : 0;
+	k += c >= t[k + 1] ? 1 : 0;
+
+	// linear_to_rgb8 maps NaN to 255.
+	return c == c ? (uint8_t)k : 255;
+}
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static __inline long color_load_acquire(long volatile *p)
+{
+#if defined(_MSC_VER) && defined(_M_ARM64)
+	// ARM64 defaults to /volatile:iso, where a volatile read is not an acquire.
+	return (long)__ldar32((unsigned __int32 volatile *)p);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	// volatile reads are acquires under /volatile:ms, the default on x86 and x64.
+	return *p;
+#elif defined(_MSC_VER)
+	return _InterlockedOr(p, 0);
+#else
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static __inline size_t color_load_acquire_size(size_t *p)
+{
+#if defined(_MSC_VER) && defined(_M_ARM64)
+	return (size_t)__ldar64((unsigned __int64 volatile *)p);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	return *(size_t volatile *)p;
+#elif defined(_MSC_VER)
+	return (size_t)_InterlockedOr((long volatile *)p, 0);
+#else
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static __inline void color_store_release_size(size_t *p, size_t v)
+{
+#if defined(_MSC_VER) && defined(_M_ARM64)
+	__stlr64((unsigned __int64 volatile *)p, v);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	// volatile writes are releases under /volatile:ms.
+	*(size_t volatile *)p = v;
+#elif defined(_MSC_VER)
+	_InterlockedExchange((long volatile *)p, (long)v);
+#else
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+// for spin waits: pause tells the core to yield to its hyperthread sibling.
+
+static __inline void color_pause(void)
+{
+#if defined(COLOR_SSE2)
+	_mm_pause();
+#elif defined(_MSC_VER) && (defined(_M_ARM64) || defined(_M_ARM))
+	__yield();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+void color_call_once_slow(long volatile *state, void (*init)(void));
+
+// runs init exactly once, even when first called from several threads. state starts at 0.
+
+static __inline void color_call_once(long volatile *state, void (*init)(void))
+{
+	if(color_load_acquire(state) != 2)
+	{
+		color_call_once_slow(state, init);
+	}
+}
+
+// per-channel tables for an 8-bit YCbCr range change with the matrix kept, from limited or full range.
+uint8_t const (*color_ycbcr_range_tables(int from_full))[256];
+
+// fixed-point form of an 8-bit YCbCr matrix and range change: output k is
+// (m[k * 4] * Y + m[k * 4 + 1] * Cb + m[k * 4 + 2] * Cr + m[k * 4 + 3]) >> COLOR_YCBCR_FIXED_BITS, clamped to [0, 255].
+#define COLOR_YCBCR_FIXED_BITS 20
+
+void color_ycbcr_fixed(int32_t *m, uint8_t from_extra, uint8_t to_extra);
+
+// per-channel tables of RGB8 -> Y' in the YUV matrix of extra, or -> luminance. summed in R, G, B
+// order they give color_convert's result exactly.
+double const (*color_luma_tables(int luminance, uint8_t extra))[256];
+double color_luminance_to_lightness(double Y);
+
+// Lab's f(t) and its inverse, and the matrices from linear sRGB to XYZ relative to the white point
+// and back, row-major, as the Lab conversions use them.
+double color_lab_f(double t);
+double color_lab_f_inv(double f);
+extern double const color_linear_to_xyzw[9];
+extern double const color_xyzw_to_linear[9];
+
+static __inline int color_thread_count(void)
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+static __inline int color_thread_index(void)
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+#ifdef COLOR_INSTRUMENT
+
+// one in this many calls per edge has its cycles counted.
+#define COLOR_INSTRUMENT_SAMPLE 64
+
+struct color_edge_stats* color_instrument_thread(void);
+uint64_t color_instrument_cycles(void);
+
+static __inline struct color_edge_stats* color_instrument_edge(int from, int to)
+{
+	return color_instrument_thread() + (from - 1) * (COLOR_DUMMY_END - 1) + (to - 1);
+}
+
+// returns a start time, or 0 when this call is not sampled.
+
+static __inline uint64_t color_instrument_begin(struct color_edge_stats *edge)
+{
+	return edge->calls % COLOR_INSTRUMENT_SAMPLE ? 0 : color_instrument_cycles();
+}
+
+static __inline void color_instrument_end(struct color_edge_stats *edge, uint64_t start, size_t colors)
+{
+	if(start)
+	{
+		edge->cycles += color_instrument_cycles() - start;
+		edge->sampled_colors += colors;
+	}
+
+	++edge->calls;
+	edge->colors += colors;
+}
+
+#endif
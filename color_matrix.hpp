@@ -0,0 +1,304 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Compile-time derivation of conversion matrices, in exact rational
+	arithmetic. Each entry is rounded to double only once, from a reduced
+	fraction, so results are bit-identical to hand-written constants such as
+	5067776.0/12288897.0.
+
+	Overflowing 64-bit intermediates is a compile error, not a wrong answer.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace colors
+{
+
+struct rational
+{
+	int64_t num, den;
+};
+
+constexpr int64_t gcd(int64_t a, int64_t b)
+{
+	if(a < 0) a = -a;
+	if(b < 0) b = -b;
+
+	while(b)
+	{
+		int64_t t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+constexpr rational ratio(int64_t num, int64_t den = 1)
+{
+	if(den < 0)
+	{
+		num = -num;
+		den = -den;
+	}
+
+	int64_t g = gcd(num, den);
+	return g > 1 ? rational{ num / g, den / g } : rational{ num, den };
+}
+
+constexpr rational operator-(rational a)
+{
+	return { -a.num, a.den };
+}
+
+constexpr rational operator+(rational a, rational b)
+{
+	int64_t g = gcd(a.den, b.den);
+	return ratio(a.num * (b.den / g) + b.num * (a.den / g), a.den / g * b.den);
+}
+
+constexpr rational operator-(rational a, rational b)
+{
+	return a + -b;
+}
+
+constexpr rational operator*(rational a, rational b)
+{
+	// cross-cancel first, to keep intermediates small.
+	int64_t g1 = gcd(a.num, b.den), g2 = gcd(b.num, a.den);
+	return ratio((a.num / g1) * (b.num / g2), (a.den / g2) * (b.den / g1));
+}
+
+constexpr rational operator/(rational a, rational b)
+{
+	return a * ratio(b.den, b.num);
+}
+
+constexpr bool operator==(rational a, rational b)
+{
+	return a.num == b.num && a.den == b.den;
+}
+
+// rounds once. exact for |num| and den up to 2^53, which as_double checks.
+
+constexpr bool exact(rational r)
+{
+	return (r.num < 0 ? -r.num : r.num) <= (int64_t(1) << 53) && r.den <= (int64_t(1) << 53);
+}
+
+constexpr double as_double(rational r)
+{
+	return (double)r.num / (double)r.den;
+}
+
+struct vec3
+{
+	rational v[3];
+};
+
+struct matrix3
+{
+	rational m[3][3];
+};
+
+struct dmatrix3
+{
+	double m[3][3];
+};
+
+constexpr matrix3 inverse(matrix3 const &a)
+{
+	rational const (&m)[3][3] = a.m;
+	matrix3 r = {};
+
+	r.m[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	r.m[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+	r.m[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+	r.m[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	r.m[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+	r.m[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+	r.m[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	r.m[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+	r.m[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+	rational det = m[0][0] * r.m[0][0] + m[0][1] * r.m[1][0] + m[0][2] * r.m[2][0];
+
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			r.m[i][j] = r.m[i][j] / det;
+		}
+	}
+
+	return r;
+}
+
+constexpr vec3 multiply(matrix3 const &a, vec3 const &b)
+{
+	vec3 r = {};
+
+	for(int i = 0; i < 3; ++i)
+	{
+		r.v[i] = a.m[i][0] * b.v[0] + a.m[i][1] * b.v[1] + a.m[i][2] * b.v[2];
+	}
+
+	return r;
+}
+
+// multiplies row i by s[i], or column j by s[j].
+
+constexpr matrix3 scale_rows(matrix3 a, vec3 const &s)
+{
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			a.m[i][j] = a.m[i][j] * s.v[i];
+		}
+	}
+
+	return a;
+}
+
+constexpr matrix3 scale_columns(matrix3 a, vec3 const &s)
+{
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			a.m[i][j] = a.m[i][j] * s.v[j];
+		}
+	}
+
+	return a;
+}
+
+constexpr bool exact(matrix3 const &a)
+{
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			if(!exact(a.m[i][j]))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+constexpr dmatrix3 as_double(matrix3 const &a)
+{
+	dmatrix3 r = {};
+
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			r.m[i][j] = as_double(a.m[i][j]);
+		}
+	}
+
+	return r;
+}
+
+constexpr bool operator==(dmatrix3 const &a, dmatrix3 const &b)
+{
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			if(a.m[i][j] != b.m[i][j])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+struct chromaticity
+{
+	rational x, y;
+};
+
+// XYZ of a white point, with Y = 1.
+
+constexpr vec3 white_xyz(chromaticity w)
+{
+	return { { w.x / w.y, ratio(1), (ratio(1) - w.x - w.y) / w.y } };
+}
+
+// XYZ of each primary, with Y = 1.
+
+constexpr matrix3 primaries_xyz(chromaticity r, chromaticity g, chromaticity b)
+{
+	return { {
+		{ r.x / r.y, g.x / g.y, b.x / b.y },
+		{ ratio(1), ratio(1), ratio(1) },
+		{ (ratio(1) - r.x - r.y) / r.y, (ratio(1) - g.x - g.y) / g.y, (ratio(1) - b.x - b.y) / b.y }
+	} };
+}
+
+// linear RGB -> XYZ for an RGB space, from its primaries and white point. white maps to white_xyz(w).
+
+constexpr matrix3 rgb_to_xyz(chromaticity r, chromaticity g, chromaticity b, chromaticity w)
+{
+	matrix3 p = primaries_xyz(r, g, b);
+	return scale_columns(p, multiply(inverse(p), white_xyz(w)));
+}
+
+// the inverse of rgb_to_xyz. inverting that directly needs intermediates past 64 bits, so this
+// inverts the primaries and undoes the white scale instead.
+
+constexpr matrix3 xyz_to_rgb(chromaticity r, chromaticity g, chromaticity b, chromaticity w)
+{
+	matrix3 p_inv = inverse(primaries_xyz(r, g, b));
+	vec3 s = multiply(p_inv, white_xyz(w));
+
+	return scale_rows(p_inv, { { ratio(1) / s.v[0], ratio(1) / s.v[1], ratio(1) / s.v[2] } });
+}
+
+// RGB -> luma and two scaled color differences, from luma coefficients kr and kb. this is YUV with
+// u_max = 0.436 and v_max = 0.615, and YDbDr with both at 1.333.
+
+constexpr matrix3 rgb_to_luma_chroma(rational kr, rational kb, rational u_max, rational v_max)
+{
+	rational kg = ratio(1) - kr - kb;
+
+	return { {
+		{ kr, kg, kb },
+		{ -u_max * kr / (ratio(1) - kb), -u_max * kg / (ratio(1) - kb), u_max },
+		{ v_max, -v_max * kg / (ratio(1) - kr), -v_max * kb / (ratio(1) - kr) }
+	} };
+}
+
+}
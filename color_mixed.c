@@ -0,0 +1,221 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Conversion of arrays mixing source types. Colors are bucketed by source
+	type and extra with a counting sort of their indices, then each bucket is
+	gathered a chunk at a time into a buffer that stays in L1, run through
+	that bucket's plan with its batch kernels, and scattered back in place.
+
+	Within a bucket the indices are increasing, so the gathers and scatters
+	walk the array forward. Chunks are spread over threads like any other
+	plan execution; every index is in exactly one chunk, so no two threads
+	write the same color.
+*/
+
+#define COLOR_EXPORTS
+
+#include <assert.h>
+#include <stdlib.h>
+#include "color_internal.h"
+
+// one bucket per source type and extra.
+#define KEY_COUNT ((COLOR_DUMMY_END - 1) * 256)
+
+COLOR_EXPORT int COLOR_CALL color_convert_mixed(struct color *c, size_t count, enum color_type to, uint8_t to_extra)
+{
+	uint16_t *slots;
+	size_t *starts, *order;
+	struct color_plan *plans;
+	size_t i, total;
+	unsigned buckets, b;
+	ptrdiff_t chunks, k;
+
+	assert(c != NULL || count == 0);
+	assert(to > COLOR_NONE);
+	assert(to < COLOR_DUMMY_END);
+
+	slots = (uint16_t*)malloc(KEY_COUNT * sizeof *slots);
+
+	if(!slots)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < KEY_COUNT; ++i)
+	{
+		slots[i] = UINT16_MAX;
+	}
+
+	// number the buckets in order of first appearance. colors already in the target need nothing.
+
+	buckets = 0;
+
+	for(i = 0; i < count; ++i)
+	{
+		assert(c[i].type > COLOR_NONE && c[i].type < COLOR_DUMMY_END);
+
+		if(c[i].type != to || c[i].extra != to_extra)
+		{
+			uint16_t *slot = &slots[(c[i].type - 1) * 256 + c[i].extra];
+
+			if(*slot == UINT16_MAX)
+			{
+				*slot = (uint16_t)buckets++;
+			}
+		}
+	}
+
+	if(!buckets)
+	{
+		free(slots);
+		return 1;
+	}
+
+	starts = (size_t*)calloc(buckets + 1, sizeof *starts);
+	plans = (struct color_plan*)malloc(buckets * sizeof *plans);
+	order = NULL;
+
+	if(starts && plans)
+	{
+		for(i = 0; i < KEY_COUNT; ++i)
+		{
+			if(slots[i] != UINT16_MAX)
+			{
+				color_plan_init(&plans[slots[i]], (enum color_type)(i / 256 + 1), (uint8_t)(i % 256), to, to_extra);
+			}
+		}
+
+		// counting sort of the indices: count per bucket, then place each index at its bucket's next free spot.
+
+		for(i = 0; i < count; ++i)
+		{
+			if(c[i].type != to || c[i].extra != to_extra)
+			{
+				++starts[slots[(c[i].type - 1) * 256 + c[i].extra] + 1];
+			}
+		}
+
+		for(b = 0; b < buckets; ++b)
+		{
+			starts[b + 1] += starts[b];
+		}
+
+		total = starts[buckets];
+
+		// one bucket holding every color is converted in place, without sorting.
+
+		if(total == count && buckets == 1)
+		{
+			free(slots);
+
+			chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+			for(k = 0; k < chunks; ++k)
+			{
+				size_t first = (size_t)k * COLOR_CHUNK;
+				color_plan_execute(&plans[0], c + first, count - first < COLOR_CHUNK ? count - first : COLOR_CHUNK);
+			}
+
+			free(starts);
+			free(plans);
+			return 1;
+		}
+
+		order = (size_t*)malloc(total * sizeof *order);
+	}
+
+	if(!order)
+	{
+		free(slots);
+		free(starts);
+		free(plans);
+		return 0;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		if(c[i].type != to || c[i].extra != to_extra)
+		{
+			order[starts[slots[(c[i].type - 1) * 256 + c[i].extra]]++] = i;
+		}
+	}
+
+	free(slots);
+
+	// placing the indices moved each start to the next bucket's; shift them back.
+
+	for(b = buckets; b > 0; --b)
+	{
+		starts[b] = starts[b - 1];
+	}
+
+	starts[0] = 0;
+
+	chunks = (ptrdiff_t)((total + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+#pragma omp parallel for schedule(static) if(total >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		struct color buf[COLOR_CHUNK];
+		size_t first = (size_t)k * COLOR_CHUNK;
+		size_t end = total - first < COLOR_CHUNK ? total : first + COLOR_CHUNK;
+		size_t j, n, run;
+		unsigned lo = 0, hi = buckets;
+
+		// the bucket holding the chunk's first index.
+
+		while(hi - lo > 1)
+		{
+			unsigned mid = (lo + hi) / 2;
+
+			if(starts[mid] <= first) lo = mid;
+			else hi = mid;
+		}
+
+		// a chunk can span buckets; each run of one bucket goes through its own plan.
+
+		for(j = first; j < end; j += run, ++lo)
+		{
+			run = (starts[lo + 1] < end ? starts[lo + 1] : end) - j;
+
+			for(n = 0; n < run; ++n)
+			{
+				buf[n] = c[order[j + n]];
+			}
+
+			color_plan_execute(&plans[lo], buf, run);
+
+			for(n = 0; n < run; ++n)
+			{
+				c[order[j + n]] = buf[n];
+			}
+		}
+	}
+
+	free(starts);
+	free(plans);
+	free(order);
+	return 1;
+}
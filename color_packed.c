@@ -0,0 +1,580 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Packed storage. Colors are unpacked a chunk at a time into a small buffer
+	of struct color that stays in L1, run through the plan's steps and packed
+	again, so memory traffic is that of the packed formats.
+
+	Half floats are widened and narrowed with F16C where it is enabled at
+	build time, and in software otherwise. Lab16 is encoded and decoded in
+	the same pass, so a plan producing or consuming Lab moves 6 bytes per
+	color through memory.
+
+	YCbCr range changes skip struct color altogether: with the matrix kept,
+	each channel is one lookup in a 256-entry table. Matrix changes are one
+	affine map in 32-bit fixed point, four colors at a time with SSE4.1.
+
+	Luma and luminance of RGB8 skip it too: with the other two channels at 0,
+	the conversion of each channel is a table, and the three summed in order
+	are bit for bit color_convert's component.
+*/
+
+#define COLOR_EXPORTS
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "color_internal.h"
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define COLOR_SSE41
+#include <smmintrin.h>
+#endif
+
+#ifndef COLOR_F16C
+
+// round to nearest even, with overflow to infinity. NaN stays NaN. these give the same
+// results as the F16C instructions used instead when COLOR_F16C is defined.
+
+static uint16_t float_to_half(float f)
+{
+	union { float f; uint32_t u; } v, magic;
+	uint32_t sign;
+	uint16_t h;
+
+	v.f = f;
+	sign = v.u & 0x80000000u;
+	v.u ^= sign;
+
+	if(v.u >= (127u + 16u) << 23)
+	{
+		// too large for a half, or Inf/NaN.
+		h = v.u > 0x7F800000u ? 0x7E00 : 0x7C00;
+	}
+	else if(v.u < 113u << 23)
+	{
+		// subnormal or zero: let a float add do the rounding.
+		magic.u = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+		v.f += magic.f;
+		h = (uint16_t)(v.u - magic.u);
+	}
+	else
+	{
+		uint32_t odd = (v.u >> 13) & 1;
+
+		v.u += ((uint32_t)(15 - 127) << 23) + 0xFFF + odd;
+		h = (uint16_t)(v.u >> 13);
+	}
+
+	return (uint16_t)(h | (sign >> 16));
+}
+
+static float half_to_float(uint16_t h)
+{
+	union { float f; uint32_t u; } v, magic;
+	uint32_t exp;
+
+	v.u = (uint32_t)(h & 0x7FFF) << 13;
+	exp = v.u & (0x7C00u << 13);
+	v.u += (127u - 15u) << 23;
+
+	if(exp == 0x7C00u << 13)
+	{
+		// Inf/NaN.
+		v.u += (128u - 16u) << 23;
+	}
+	else if(exp == 0)
+	{
+		// subnormal: renormalize.
+		magic.u = 113u << 23;
+		v.u += 1u << 23;
+		v.f -= magic.f;
+	}
+
+	v.u |= (uint32_t)(h & 0x8000) << 16;
+	return v.f;
+}
+
+#endif
+
+static int is_8bit(int type)
+{
+	return type == COLOR_RGB8 || type == COLOR_YCBCR;
+}
+
+static void unpack(struct color *dst, void const *src, enum color_format format, size_t count, uint8_t type, uint8_t extra)
+{
+	size_t i;
+
+	switch(format)
+	{
+	case COLOR_FORMAT_COLOR:
+		memcpy(dst, src, count * sizeof *dst);
+		break;
+	case COLOR_FORMAT_PACKED8:
+		{
+			struct color_packed8 const *p = (struct color_packed8 const*)src;
+
+			assert(is_8bit(type));
+
+			for(i = 0; i < count; ++i)
+			{
+				dst[i].type = type;
+				dst[i].extra = extra;
+				dst[i].RGB8.R = p[i].c[0];
+				dst[i].RGB8.G = p[i].c[1];
+				dst[i].RGB8.B = p[i].c[2];
+			}
+		}
+		break;
+	case COLOR_FORMAT_PACKED24:
+		{
+			struct color_packed24 const *p = (struct color_packed24 const*)src;
+
+			assert(is_8bit(type));
+
+			for(i = 0; i < count; ++i)
+			{
+				dst[i].type = type;
+				dst[i].extra = extra;
+				dst[i].RGB8.R = p[i].c[0];
+				dst[i].RGB8.G = p[i].c[1];
+				dst[i].RGB8.B = p[i].c[2];
+			}
+		}
+		break;
+	case COLOR_FORMAT_FLOAT:
+		{
+			struct color_packedf const *p = (struct color_packedf const*)src;
+
+			assert(!is_8bit(type));
+
+			for(i = 0; i < count; ++i)
+			{
+				dst[i].type = type;
+				dst[i].extra = extra;
+				dst[i].RGB.R = p[i].c[0];
+				dst[i].RGB.G = p[i].c[1];
+				dst[i].RGB.B = p[i].c[2];
+			}
+		}
+		break;
+	case COLOR_FORMAT_HALF:
+		{
+			struct color_packedh const *p = (struct color_packedh const*)src;
+
+			assert(!is_8bit(type));
+
+			for(i = 0; i < count; ++i)
+			{
+#ifdef COLOR_F16C
+				__m128 f = _mm_cvtph_ps(_mm_loadl_epi64((__m128i const*)p[i].c));
+
+				dst[i].type = type;
+				dst[i].extra = extra;
+				_mm_storeu_pd(&dst[i].RGB.R, _mm_cvtps_pd(f));
+				_mm_store_sd(&dst[i].RGB.B, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+#else
+				dst[i].type = type;
+				dst[i].extra = extra;
+				dst[i].RGB.R = half_to_float(p[i].c[0]);
+				dst[i].RGB.G = half_to_float(p[i].c[1]);
+				dst[i].RGB.B = half_to_float(p[i].c[2]);
+#endif
+			}
+		}
+		break;
+	case COLOR_FORMAT_LAB16:
+		{
+			struct color_packedlab16 const *p = (struct color_packedlab16 const*)src;
+
+			assert(type == COLOR_LAB);
+
+			for(i = 0; i < count; ++i)
+			{
+				dst[i].type = type;
+				dst[i].extra = extra;
+				dst[i].Lab.L = p[i].c[0] * (100.0 / 65535.0);
+				dst[i].Lab.a = p[i].c[1] * (1.0 / 257.0) - 128.0;
+				dst[i].Lab.b = p[i].c[2] * (1.0 / 257.0) - 128.0;
+			}
+		}
+		break;
+	default:
+		assert(0);
+	}
+}
+
+// rounded and clamped to 16 bits. NaN encodes as 0.
+
+static __inline uint16_t lab16_encode(double v)
+{
+	v += 0.5;
+	return v >= 65535.0 ? 65535 : v >= 0.0 ? (uint16_t)v : 0;
+}
+
+static void pack(void *dst, enum color_format format, struct color const *src, size_t count)
+{
+	size_t i;
+
+	switch(format)
+	{
+	case COLOR_FORMAT_COLOR:
+		memcpy(dst, src, count * sizeof *src);
+		break;
+	case COLOR_FORMAT_PACKED8:
+		{
+			struct color_packed8 *p = (struct color_packed8*)dst;
+
+			assert(count == 0 || is_8bit(src[0].type));
+
+			for(i = 0; i < count; ++i)
+			{
+				p[i].c[0] = src[i].RGB8.R;
+				p[i].c[1] = src[i].RGB8.G;
+				p[i].c[2] = src[i].RGB8.B;
+				p[i].c[3] = 0;
+			}
+		}
+		break;
+	case COLOR_FORMAT_PACKED24:
+		{
+			struct color_packed24 *p = (struct color_packed24*)dst;
+
+			assert(count == 0 || is_8bit(src[0].type));
+
+			for(i = 0; i < count; ++i)
+			{
+				p[i].c[0] = src[i].RGB8.R;
+				p[i].c[1] = src[i].RGB8.G;
+				p[i].c[2] = src[i].RGB8.B;
+			}
+		}
+		break;
+	case COLOR_FORMAT_FLOAT:
+		{
+			struct color_packedf *p = (struct color_packedf*)dst;
+
+			assert(count == 0 || !is_8bit(src[0].type));
+
+			for(i = 0; i < count; ++i)
+			{
+				p[i].c[0] = (float)src[i].RGB.R;
+				p[i].c[1] = (float)src[i].RGB.G;
+				p[i].c[2] = (float)src[i].RGB.B;
+				p[i].c[3] = 0.0f;
+			}
+		}
+		break;
+	case COLOR_FORMAT_HALF:
+		{
+			struct color_packedh *p = (struct color_packedh*)dst;
+
+			assert(count == 0 || !is_8bit(src[0].type));
+
+			for(i = 0; i < count; ++i)
+			{
+#ifdef COLOR_F16C
+				// [R, G] and [B, 0] narrowed to floats, joined, then to halves.
+				__m128 f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(&src[i].RGB.R)), _mm_cvtpd_ps(_mm_load_sd(&src[i].RGB.B)));
+				_mm_storel_epi64((__m128i*)p[i].c, _mm_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+#else
+				p[i].c[0] = float_to_half((float)src[i].RGB.R);
+				p[i].c[1] = float_to_half((float)src[i].RGB.G);
+				p[i].c[2] = float_to_half((float)src[i].RGB.B);
+				p[i].c[3] = 0;
+#endif
+			}
+		}
+		break;
+	case COLOR_FORMAT_LAB16:
+		{
+			struct color_packedlab16 *p = (struct color_packedlab16*)dst;
+
+			assert(count == 0 || src[0].type == COLOR_LAB);
+
+			for(i = 0; i < count; ++i)
+			{
+				p[i].c[0] = lab16_encode(src[i].Lab.L * 655.35);
+				p[i].c[1] = lab16_encode((src[i].Lab.a + 128.0) * 257.0);
+				p[i].c[2] = lab16_encode((src[i].Lab.b + 128.0) * 257.0);
+			}
+		}
+		break;
+	default:
+		assert(0);
+	}
+}
+
+COLOR_EXPORT size_t COLOR_CALL color_format_size(enum color_format format)
+{
+	static size_t const sizes[] =
+	{
+		sizeof(struct color),
+		sizeof(struct color_packed8),
+		sizeof(struct color_packedf),
+		sizeof(struct color_packedh),
+		sizeof(struct color_packed24),
+		sizeof(struct color_packedlab16)
+	};
+
+	assert(format >= COLOR_FORMAT_COLOR && format <= COLOR_FORMAT_LAB16);
+	return sizes[format];
+}
+
+COLOR_EXPORT void COLOR_CALL color_plan_execute_packed(struct color_plan const *plan, void *dst, enum color_format dst_format, void const *src, enum color_format src_format, size_t count)
+{
+	size_t src_size, dst_size;
+	ptrdiff_t chunks, k;
+
+	assert(plan != NULL);
+	assert((dst != NULL && src != NULL) || count == 0);
+	assert(dst != src || color_format_size(dst_format) == color_format_size(src_format));
+
+	src_size = color_format_size(src_format);
+	dst_size = color_format_size(dst_format);
+	chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+	// chunks are independent, and each stays in one thread's buffer. working in place is
+	// safe as every chunk is read in full before any of it is written.
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		struct color buf[COLOR_CHUNK];
+		size_t i = (size_t)k * COLOR_CHUNK;
+		size_t n = count - i < COLOR_CHUNK ? count - i : COLOR_CHUNK;
+
+		unpack(buf, (char const*)src + i * src_size, src_format, n, plan->src_type, plan->src_extra);
+		color_plan_execute(plan, buf, n);
+		pack((char*)dst + i * dst_size, dst_format, buf, n);
+	}
+}
+
+COLOR_EXPORT void COLOR_CALL color_ycbcr_range(void *dst, void const *src, enum color_format format, size_t count, int to_full)
+{
+	uint8_t const (*tbl)[256];
+	size_t size;
+	ptrdiff_t chunks, k;
+
+	assert((dst != NULL && src != NULL) || count == 0);
+	assert(format == COLOR_FORMAT_PACKED8 || format == COLOR_FORMAT_PACKED24);
+
+	tbl = color_ycbcr_range_tables(!to_full);
+	size = color_format_size(format);
+	chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		size_t i = (size_t)k * COLOR_CHUNK;
+		size_t end = count - i < COLOR_CHUNK ? count : i + COLOR_CHUNK;
+		uint8_t const *s = (uint8_t const*)src + i * size;
+		uint8_t *d = (uint8_t*)dst + i * size;
+
+		for(; i < end; ++i, s += size, d += size)
+		{
+			d[0] = tbl[0][s[0]];
+			d[1] = tbl[1][s[1]];
+			d[2] = tbl[2][s[2]];
+
+			if(size == 4)
+			{
+				d[3] = 0;
+			}
+		}
+	}
+}
+
+// size is 3 or 4 bytes per color. with SSE4.1, four colors are loaded as 16 bytes, which for
+// packed24 reaches into the sixth color, so the vector loop stops two colors short of n.
+
+static void ycbcr_fixed_run(uint8_t *d, uint8_t const *s, size_t size, size_t n, int32_t const *m)
+{
+	size_t i = 0;
+
+#ifdef COLOR_SSE41
+	__m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	__m128i gather = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m128i byte = _mm_set1_epi32(0xFF), zero = _mm_setzero_si128();
+	size_t vec_end = size == 4 ? n : n < 2 ? 0 : n - 2;
+
+	for(; i + 4 <= vec_end; i += 4, s += size * 4, d += size * 4)
+	{
+		__m128i v = _mm_loadu_si128((__m128i const*)s), in[3], out;
+		int k;
+
+		if(size == 3)
+		{
+			v = _mm_shuffle_epi8(v, spread);
+		}
+
+		in[0] = _mm_and_si128(v, byte);
+		in[1] = _mm_and_si128(_mm_srli_epi32(v, 8), byte);
+		in[2] = _mm_and_si128(_mm_srli_epi32(v, 16), byte);
+
+		out = zero;
+
+		for(k = 0; k < 3; ++k)
+		{
+			__m128i acc = _mm_set1_epi32(m[k * 4 + 3]);
+
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(in[0], _mm_set1_epi32(m[k * 4])));
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(in[1], _mm_set1_epi32(m[k * 4 + 1])));
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(in[2], _mm_set1_epi32(m[k * 4 + 2])));
+			acc = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(acc, COLOR_YCBCR_FIXED_BITS), zero), byte);
+
+			out = _mm_or_si128(out, _mm_slli_epi32(acc, k * 8));
+		}
+
+		if(size == 4)
+		{
+			_mm_storeu_si128((__m128i*)d, out);
+		}
+		else
+		{
+			int32_t last;
+
+			out = _mm_shuffle_epi8(out, gather);
+			last = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+
+			_mm_storel_epi64((__m128i*)d, out);
+			memcpy(d + 8, &last, 4);
+		}
+	}
+#endif
+
+	for(; i < n; ++i, s += size, d += size)
+	{
+		int k;
+		int32_t out[3];
+
+		for(k = 0; k < 3; ++k)
+		{
+			int32_t acc = (s[0] * m[k * 4] + s[1] * m[k * 4 + 1] + s[2] * m[k * 4 + 2] + m[k * 4 + 3]) >> COLOR_YCBCR_FIXED_BITS;
+			out[k] = acc < 0 ? 0 : acc > 255 ? 255 : acc;
+		}
+
+		d[0] = (uint8_t)out[0];
+		d[1] = (uint8_t)out[1];
+		d[2] = (uint8_t)out[2];
+
+		if(size == 4)
+		{
+			d[3] = 0;
+		}
+	}
+}
+
+COLOR_EXPORT void COLOR_CALL color_ycbcr_convert(void *dst, void const *src, enum color_format format, size_t count, uint8_t from_extra, uint8_t to_extra)
+{
+	int32_t m[12];
+	size_t size;
+	ptrdiff_t chunks, k;
+
+	assert((dst != NULL && src != NULL) || count == 0);
+	assert(format == COLOR_FORMAT_PACKED8 || format == COLOR_FORMAT_PACKED24);
+
+	// with the matrix kept, the tables are exact.
+
+	if(((from_extra ^ to_extra) & COLOR_YUV_MAT_MASK) == 0)
+	{
+		if(from_extra != to_extra)
+		{
+			color_ycbcr_range(dst, src, format, count, to_extra & COLOR_YCBCR_FULL_RANGE);
+		}
+		else if(dst != src)
+		{
+			memmove(dst, src, count * color_format_size(format));
+		}
+
+		return;
+	}
+
+	color_ycbcr_fixed(m, from_extra, to_extra);
+
+	size = color_format_size(format);
+	chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+	// chunks are independent, and ycbcr_fixed_run reads nothing outside its own, so
+	// working in place is safe.
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		size_t i = (size_t)k * COLOR_CHUNK;
+		size_t n = count - i < COLOR_CHUNK ? count - i : COLOR_CHUNK;
+
+		ycbcr_fixed_run((uint8_t*)dst + i * size, (uint8_t const*)src + i * size, size, n, m);
+	}
+}
+
+COLOR_EXPORT void COLOR_CALL color_rgb8_luma(double *dst, void const *src, enum color_format src_format, size_t count, enum color_luma luma, uint8_t extra)
+{
+	double const (*tbl)[256];
+	uint8_t const *base;
+	size_t size;
+	ptrdiff_t chunks, k;
+
+	assert((dst != NULL && src != NULL) || count == 0);
+	assert(src_format == COLOR_FORMAT_COLOR || src_format == COLOR_FORMAT_PACKED8 || src_format == COLOR_FORMAT_PACKED24);
+	assert(luma >= COLOR_LUMA_Y && luma <= COLOR_LUMA_LIGHTNESS);
+
+	tbl = color_luma_tables(luma != COLOR_LUMA_Y, extra);
+	size = color_format_size(src_format);
+	base = (uint8_t const*)src;
+
+	if(src_format == COLOR_FORMAT_COLOR)
+	{
+		base += offsetof(struct color, RGB8);
+	}
+
+	chunks = (ptrdiff_t)((count + COLOR_CHUNK - 1) / COLOR_CHUNK);
+
+#pragma omp parallel for schedule(static) if(count >= COLOR_PARALLEL_MIN)
+	for(k = 0; k < chunks; ++k)
+	{
+		size_t i = (size_t)k * COLOR_CHUNK;
+		size_t end = count - i < COLOR_CHUNK ? count : i + COLOR_CHUNK;
+		uint8_t const *s = base + i * size;
+
+		if(luma == COLOR_LUMA_LIGHTNESS)
+		{
+			for(; i < end; ++i, s += size)
+			{
+				assert(src_format != COLOR_FORMAT_COLOR || ((struct color const*)src)[i].type == COLOR_RGB8);
+				dst[i] = color_luminance_to_lightness(tbl[0][s[0]] + tbl[1][s[1]] + tbl[2][s[2]]);
+			}
+		}
+		else
+		{
+			for(; i < end; ++i, s += size)
+			{
+				assert(src_format != COLOR_FORMAT_COLOR || ((struct color const*)src)[i].type == COLOR_RGB8);
+				dst[i] = tbl[0][s[0]] + tbl[1][s[1]] + tbl[2][s[2]];
+			}
+		}
+	}
+}
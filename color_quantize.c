@@ -0,0 +1,472 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Color quantization: a palette is seeded by median cut and refined with
+	k-means, in either Lab or linear RGB.
+
+	Assignment runs in parallel, four centroids at a time with SSE2 when
+	available. Centroid sums are accumulated per thread and reduced after each
+	pass.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+struct quantize_box
+{
+	size_t begin, end;
+	float lo[3], hi[3];
+};
+
+static void box_bounds(struct quantize_box *box, uint32_t const *idx, float const *pts)
+{
+	size_t i;
+	int j;
+
+	for(j = 0; j < 3; ++j)
+	{
+		box->lo[j] = FLT_MAX;
+		box->hi[j] = -FLT_MAX;
+	}
+
+	for(i = box->begin; i < box->end; ++i)
+	{
+		float const *p = pts + idx[i] * (size_t)3;
+
+		for(j = 0; j < 3; ++j)
+		{
+			if(p[j] < box->lo[j]) box->lo[j] = p[j];
+			if(p[j] > box->hi[j]) box->hi[j] = p[j];
+		}
+	}
+}
+
+// partially sorts idx so that the point at nth has all smaller points before it.
+
+static void select_nth(uint32_t *idx, float const *pts, int axis, ptrdiff_t count, ptrdiff_t nth)
+{
+	ptrdiff_t lo = 0, hi = count - 1;
+
+	while(lo < hi)
+	{
+		float pivot = pts[idx[lo + (hi - lo) / 2] * (size_t)3 + axis];
+		ptrdiff_t i = lo, j = hi;
+
+		while(i <= j)
+		{
+			while(pts[idx[i] * (size_t)3 + axis] < pivot) ++i;
+			while(pts[idx[j] * (size_t)3 + axis] > pivot) --j;
+
+			if(i <= j)
+			{
+				uint32_t tmp = idx[i];
+				idx[i++] = idx[j];
+				idx[j--] = tmp;
+			}
+		}
+
+		if(nth <= j) hi = j;
+		else if(nth >= i) lo = i;
+		else break;
+	}
+}
+
+static unsigned median_cut(float *centroids, unsigned colors, float const *pts, size_t count)
+{
+	struct quantize_box *boxes;
+	uint32_t *idx;
+	unsigned nboxes, i;
+	size_t j;
+
+	boxes = (struct quantize_box*)malloc(sizeof(struct quantize_box) * colors);
+	idx = (uint32_t*)malloc(sizeof(uint32_t) * count);
+
+	if(!boxes || !idx)
+	{
+		free(boxes);
+		free(idx);
+		return 0;
+	}
+
+	for(j = 0; j < count; ++j)
+	{
+		idx[j] = (uint32_t)j;
+	}
+
+	boxes[0].begin = 0;
+	boxes[0].end = count;
+	box_bounds(&boxes[0], idx, pts);
+	nboxes = 1;
+
+	while(nboxes < colors)
+	{
+		struct quantize_box *box = NULL;
+		float extent = 0.0f;
+		int axis = 0, k;
+		size_t mid;
+
+		// split the box with the largest extent along any axis.
+
+		for(i = 0; i < nboxes; ++i)
+		{
+			if(boxes[i].end - boxes[i].begin < 2)
+			{
+				continue;
+			}
+
+			for(k = 0; k < 3; ++k)
+			{
+				if(boxes[i].hi[k] - boxes[i].lo[k] > extent)
+				{
+					extent = boxes[i].hi[k] - boxes[i].lo[k];
+					box = &boxes[i];
+					axis = k;
+				}
+			}
+		}
+
+		if(!box)
+		{
+			break;
+		}
+
+		mid = box->begin + (box->end - box->begin) / 2;
+		select_nth(idx + box->begin, pts, axis, (ptrdiff_t)(box->end - box->begin), (ptrdiff_t)(mid - box->begin));
+
+		boxes[nboxes].begin = mid;
+		boxes[nboxes].end = box->end;
+		box->end = mid;
+
+		box_bounds(box, idx, pts);
+		box_bounds(&boxes[nboxes], idx, pts);
+		++nboxes;
+	}
+
+	for(i = 0; i < nboxes; ++i)
+	{
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		double n = (double)(boxes[i].end - boxes[i].begin);
+
+		for(j = boxes[i].begin; j < boxes[i].end; ++j)
+		{
+			float const *p = pts + idx[j] * (size_t)3;
+
+			sum[0] += p[0];
+			sum[1] += p[1];
+			sum[2] += p[2];
+		}
+
+		centroids[i * 3 + 0] = (float)(sum[0] / n);
+		centroids[i * 3 + 1] = (float)(sum[1] / n);
+		centroids[i * 3 + 2] = (float)(sum[2] / n);
+	}
+
+	free(boxes);
+	free(idx);
+	return nboxes;
+}
+
+// centroids are stored as three planes padded to a multiple of 4 with far-away points.
+
+static unsigned nearest_centroid(float const *cx, float const *cy, float const *cz, unsigned padded, float const *p)
+{
+#ifdef COLOR_SSE2
+	COLOR_ALIGN(16) float dists[4];
+	COLOR_ALIGN(16) int32_t idxs[4];
+	__m128 px, py, pz, best;
+	__m128i bestidx, idx, four;
+	unsigned i, ret;
+	float d;
+
+	px = _mm_set1_ps(p[0]);
+	py = _mm_set1_ps(p[1]);
+	pz = _mm_set1_ps(p[2]);
+	best = _mm_set1_ps(FLT_MAX);
+	bestidx = _mm_setzero_si128();
+	idx = _mm_setr_epi32(0, 1, 2, 3);
+	four = _mm_set1_epi32(4);
+
+	for(i = 0; i < padded; i += 4)
+	{
+		__m128 dx, dy, dz, dist, mask;
+
+		dx = _mm_sub_ps(_mm_load_ps(cx + i), px);
+		dy = _mm_sub_ps(_mm_load_ps(cy + i), py);
+		dz = _mm_sub_ps(_mm_load_ps(cz + i), pz);
+		dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		mask = _mm_cmplt_ps(dist, best);
+		best = _mm_min_ps(dist, best);
+		bestidx = _mm_or_si128(_mm_and_si128(_mm_castps_si128(mask), idx), _mm_andnot_si128(_mm_castps_si128(mask), bestidx));
+		idx = _mm_add_epi32(idx, four);
+	}
+
+	_mm_store_ps(dists, best);
+	_mm_store_si128((__m128i*)idxs, bestidx);
+
+	// lowest index wins ties, same as the scalar loop.
+
+	ret = (unsigned)idxs[0];
+	d = dists[0];
+
+	for(i = 1; i < 4; ++i)
+	{
+		if(dists[i] < d || (dists[i] == d && (unsigned)idxs[i] < ret))
+		{
+			d = dists[i];
+			ret = (unsigned)idxs[i];
+		}
+	}
+
+	return ret;
+#else
+	unsigned i, ret = 0;
+	float best = FLT_MAX;
+
+	for(i = 0; i < padded; ++i)
+	{
+		float dx = cx[i] - p[0], dy = cy[i] - p[1], dz = cz[i] - p[2];
+		float dist = dx * dx + dy * dy + dz * dz;
+
+		if(dist < best)
+		{
+			best = dist;
+			ret = i;
+		}
+	}
+
+	return ret;
+#endif
+}
+
+static void load_points(float *pts, struct color_image const *img, enum color_type space)
+{
+	struct color_plan plan;
+
+	color_plan_init(&plan, (enum color_type)img->pixels[0].type, img->pixels[0].extra, space, 0);
+
+#pragma omp parallel if(img->width * img->height >= COLOR_PARALLEL_MIN)
+	{
+		struct color buf[COLOR_CHUNK];
+		double v[3];
+		ptrdiff_t y;
+		size_t x, n, k;
+
+#pragma omp for schedule(static)
+		for(y = 0; y < (ptrdiff_t)img->height; ++y)
+		{
+			float *out = pts + img->width * y * 3;
+
+			for(x = 0; x < img->width; x += n)
+			{
+				n = img->width - x < COLOR_CHUNK ? img->width - x : COLOR_CHUNK;
+
+				memcpy(buf, img->pixels + img->stride * y + x, n * sizeof(struct color));
+				color_plan_execute(&plan, buf, n);
+
+				for(k = 0; k < n; ++k)
+				{
+					color_extract_components(v, &buf[k]);
+
+					*out++ = (float)v[0];
+					*out++ = (float)v[1];
+					*out++ = (float)v[2];
+				}
+			}
+		}
+	}
+}
+
+COLOR_EXPORT int COLOR_CALL color_quantize(struct color *palette, unsigned *colors, uint8_t *indices, struct color_image const *img, enum color_type space, unsigned max_iterations, double threshold)
+{
+	float *pts, *centroids, *planes;
+	double *sums;
+	size_t count;
+	unsigned k, padded, iter, i;
+	int threads, t;
+
+	assert(palette != NULL);
+	assert(colors != NULL);
+	assert(*colors >= 1 && *colors <= 256);
+	assert(img != NULL);
+	assert(img->pixels != NULL);
+	assert(img->width && img->height);
+	assert(img->stride >= img->width);
+	assert(space == COLOR_LAB || space == COLOR_LINEAR_RGB);
+
+	count = img->width * img->height;
+	assert(count <= UINT32_MAX);
+
+	threads = count >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+	padded = (*colors + 3) & ~3u;
+
+	pts = (float*)malloc(sizeof(float) * 3 * count);
+	centroids = (float*)malloc(sizeof(float) * 3 * *colors);
+	planes = (float*)malloc(sizeof(float) * 3 * padded + 16);
+	sums = (double*)malloc(sizeof(double) * 4 * *colors * threads);
+
+	if(!pts || !centroids || !planes || !sums)
+	{
+		goto fail;
+	}
+
+	load_points(pts, img, space);
+
+	k = median_cut(centroids, *colors, pts, count);
+
+	if(!k)
+	{
+		goto fail;
+	}
+
+	for(iter = 0; iter <= max_iterations; ++iter)
+	{
+		float *cx, *cy, *cz;
+		double shift;
+
+		cx = (float*)(((uintptr_t)planes + 15) & ~(uintptr_t)15);
+		cy = cx + padded;
+		cz = cy + padded;
+
+		for(i = 0; i < padded; ++i)
+		{
+			cx[i] = i < k ? centroids[i * 3 + 0] : FLT_MAX;
+			cy[i] = i < k ? centroids[i * 3 + 1] : FLT_MAX;
+			cz[i] = i < k ? centroids[i * 3 + 2] : FLT_MAX;
+		}
+
+		if(iter == max_iterations)
+		{
+			// centroids are final; only the indices are left to assign.
+
+			if(indices)
+			{
+				ptrdiff_t j;
+
+#pragma omp parallel for schedule(static) num_threads(threads)
+				for(j = 0; j < (ptrdiff_t)count; ++j)
+				{
+					indices[j] = (uint8_t)nearest_centroid(cx, cy, cz, padded, pts + j * 3);
+				}
+			}
+
+			break;
+		}
+
+		memset(sums, 0, sizeof(double) * 4 * k * threads);
+
+#pragma omp parallel num_threads(threads)
+		{
+			double *sum = sums + (size_t)4 * k * color_thread_index();
+			ptrdiff_t j;
+
+#pragma omp for schedule(static)
+			for(j = 0; j < (ptrdiff_t)count; ++j)
+			{
+				float const *p = pts + j * 3;
+				unsigned c = nearest_centroid(cx, cy, cz, padded, p);
+
+				sum[c * 4 + 0] += p[0];
+				sum[c * 4 + 1] += p[1];
+				sum[c * 4 + 2] += p[2];
+				sum[c * 4 + 3] += 1.0;
+			}
+		}
+
+		for(t = 1; t < threads; ++t)
+		{
+			for(i = 0; i < 4 * k; ++i)
+			{
+				sums[i] += sums[(size_t)4 * k * t + i];
+			}
+		}
+
+		shift = 0.0;
+
+		for(i = 0; i < k; ++i)
+		{
+			double n = sums[i * 4 + 3], d, dx, dy, dz;
+			float nx, ny, nz;
+
+			if(n == 0.0)
+			{
+				continue;
+			}
+
+			nx = (float)(sums[i * 4 + 0] / n);
+			ny = (float)(sums[i * 4 + 1] / n);
+			nz = (float)(sums[i * 4 + 2] / n);
+
+			dx = nx - centroids[i * 3 + 0];
+			dy = ny - centroids[i * 3 + 1];
+			dz = nz - centroids[i * 3 + 2];
+
+			d = dx * dx + dy * dy + dz * dz;
+			if(d > shift) shift = d;
+
+			centroids[i * 3 + 0] = nx;
+			centroids[i * 3 + 1] = ny;
+			centroids[i * 3 + 2] = nz;
+		}
+
+		// stop early once no centroid moves further than the threshold. the next
+		// pass only assigns indices.
+
+		if(shift <= threshold * threshold)
+		{
+			max_iterations = iter + 1;
+		}
+	}
+
+	for(i = 0; i < k; ++i)
+	{
+		palette[i].type = (uint8_t)space;
+		palette[i].extra = 0;
+		palette[i].Lab.L = centroids[i * 3 + 0];
+		palette[i].Lab.a = centroids[i * 3 + 1];
+		palette[i].Lab.b = centroids[i * 3 + 2];
+	}
+
+	*colors = k;
+
+	free(pts);
+	free(centroids);
+	free(planes);
+	free(sums);
+	return 1;
+
+fail:
+	free(pts);
+	free(centroids);
+	free(planes);
+	free(sums);
+	return 0;
+}
@@ -0,0 +1,306 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Conversion of part of an image in place: the pixels set in a bitmask, or
+	those inside a list of rectangles. Everything else is left untouched,
+	including pixels of other types.
+
+	Masks are read 64 bits at a time. A full word is a run of 64 pixels and
+	is converted where it lies. Other words have their set bits compacted
+	into a buffer of pointers, and the pixels are gathered into an L1-sized
+	chunk, converted with the plan's batch kernels and scattered back.
+	Empty words cost one test.
+
+	Rectangles may overlap. Each row's spans are sorted and merged first, so
+	that every pixel is converted once, and each merged span is converted
+	where it lies.
+
+	Pixels are converted through one plan, from the type and extra of the
+	first converted pixel each thread meets; they must all share them.
+*/
+
+#define COLOR_EXPORTS
+
+#include <assert.h>
+#include <stdlib.h>
+#include "color_internal.h"
+
+struct region_span
+{
+	size_t begin, end;
+};
+
+// converted pixels gathered from partial mask words, with where they came from.
+struct region_gather
+{
+	struct color_plan plan;
+	int planned;
+	size_t count;
+	struct color *from[COLOR_CHUNK];
+	struct color buf[COLOR_CHUNK];
+};
+
+static __inline unsigned ctz64(uint64_t w)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+#ifdef _M_X64
+	_BitScanForward64(&i, w);
+#else
+	if(!_BitScanForward(&i, (unsigned long)w))
+	{
+		_BitScanForward(&i, (unsigned long)(w >> 32));
+		i += 32;
+	}
+#endif
+	return (unsigned)i;
+#else
+	return (unsigned)__builtin_ctzll(w);
+#endif
+}
+
+static void region_plan(struct region_gather *g, struct color const *c, enum color_type new_type, uint8_t new_extra)
+{
+	if(!g->planned)
+	{
+		color_plan_init(&g->plan, (enum color_type)c->type, c->extra, new_type, new_extra);
+		g->planned = 1;
+	}
+
+	assert(c->type == g->plan.src_type && c->extra == g->plan.src_extra);
+}
+
+static void region_flush(struct region_gather *g)
+{
+	size_t i;
+
+	for(i = 0; i < g->count; ++i)
+	{
+		g->buf[i] = *g->from[i];
+	}
+
+	color_plan_execute(&g->plan, g->buf, g->count);
+
+	for(i = 0; i < g->count; ++i)
+	{
+		*g->from[i] = g->buf[i];
+	}
+
+	g->count = 0;
+}
+
+// up to 64 mask bits from x on, those past width cleared.
+
+static __inline uint64_t mask_word(uint8_t const *row, size_t x, size_t width)
+{
+	size_t n = width - x < 64 ? width - x : 64;
+	size_t bytes = (n + 7) / 8, i;
+	uint64_t w = 0;
+
+	row += x / 8;
+
+	for(i = 0; i < bytes; ++i)
+	{
+		w |= (uint64_t)row[i] << (i * 8);
+	}
+
+	return n < 64 ? w & (((uint64_t)1 << n) - 1) : w;
+}
+
+COLOR_EXPORT void COLOR_CALL color_image_convert_masked(struct color_image const *img, uint8_t const *mask, size_t mask_stride, enum color_type new_type, uint8_t new_extra)
+{
+	int threads;
+
+	assert(img != NULL);
+	assert(img->pixels != NULL || !img->width || !img->height);
+	assert(img->stride >= img->width);
+	assert(mask != NULL || !img->width || !img->height);
+	assert(mask_stride * 8 >= img->width);
+	assert(new_type > COLOR_NONE);
+	assert(new_type < COLOR_DUMMY_END);
+
+	threads = img->width * img->height >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+
+#pragma omp parallel num_threads(threads)
+	{
+		struct region_gather gather, *g = &gather;
+		ptrdiff_t y;
+
+		g->planned = 0;
+		g->count = 0;
+
+#pragma omp for schedule(dynamic, 1)
+		for(y = 0; y < (ptrdiff_t)img->height; ++y)
+		{
+			struct color *row = img->pixels + img->stride * y;
+			uint8_t const *bits = mask + mask_stride * y;
+			size_t x;
+
+			for(x = 0; x < img->width; x += 64)
+			{
+				uint64_t w = mask_word(bits, x, img->width);
+				size_t n = img->width - x < 64 ? img->width - x : 64;
+
+				if(!w)
+				{
+					continue;
+				}
+
+				region_plan(g, &row[x + ctz64(w)], new_type, new_extra);
+
+				if(n == 64 ? w == ~(uint64_t)0 : w == ((uint64_t)1 << n) - 1)
+				{
+					color_plan_execute(&g->plan, &row[x], n);
+					continue;
+				}
+
+				do
+				{
+					assert(row[x + ctz64(w)].type == g->plan.src_type);
+
+					g->from[g->count] = &row[x + ctz64(w)];
+
+					if(++g->count == COLOR_CHUNK)
+					{
+						region_flush(g);
+					}
+
+					w &= w - 1;
+				}
+				while(w);
+			}
+		}
+
+		if(g->count)
+		{
+			region_flush(g);
+		}
+	}
+}
+
+static int span_compare(void const *a, void const *b)
+{
+	size_t x = ((struct region_span const*)a)->begin, y = ((struct region_span const*)b)->begin;
+	return x < y ? -1 : x > y;
+}
+
+COLOR_EXPORT int COLOR_CALL color_image_convert_rects(struct color_image const *img, struct color_rect const *rects, size_t count, enum color_type new_type, uint8_t new_extra)
+{
+	struct region_span *spans;
+	int threads;
+	size_t i;
+
+	assert(img != NULL);
+	assert(img->pixels != NULL || !img->width || !img->height);
+	assert(img->stride >= img->width);
+	assert(rects != NULL || count == 0);
+	assert(new_type > COLOR_NONE);
+	assert(new_type < COLOR_DUMMY_END);
+
+	for(i = 0; i < count; ++i)
+	{
+		assert(rects[i].x <= img->width && rects[i].width <= img->width - rects[i].x);
+		assert(rects[i].y <= img->height && rects[i].height <= img->height - rects[i].y);
+	}
+
+	if(!count)
+	{
+		return 1;
+	}
+
+	threads = img->width * img->height >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+	spans = (struct region_span*)malloc(sizeof(struct region_span) * count * threads);
+
+	if(!spans)
+	{
+		return 0;
+	}
+
+#pragma omp parallel num_threads(threads)
+	{
+		struct region_span *row_spans = spans + count * color_thread_index();
+		struct color_plan plan;
+		int planned = 0;
+		ptrdiff_t y;
+
+#pragma omp for schedule(dynamic, 1)
+		for(y = 0; y < (ptrdiff_t)img->height; ++y)
+		{
+			struct color *row = img->pixels + img->stride * y;
+			size_t n = 0, j, k;
+
+			// the spans of the rectangles crossing this row, merged where they overlap or touch.
+
+			for(j = 0; j < count; ++j)
+			{
+				if((size_t)y >= rects[j].y && (size_t)y - rects[j].y < rects[j].height && rects[j].width)
+				{
+					row_spans[n].begin = rects[j].x;
+					row_spans[n].end = rects[j].x + rects[j].width;
+					++n;
+				}
+			}
+
+			if(!n)
+			{
+				continue;
+			}
+
+			qsort(row_spans, n, sizeof *row_spans, span_compare);
+
+			for(j = 0, k = 1; k < n; ++k)
+			{
+				if(row_spans[k].begin <= row_spans[j].end)
+				{
+					if(row_spans[k].end > row_spans[j].end) row_spans[j].end = row_spans[k].end;
+				}
+				else
+				{
+					row_spans[++j] = row_spans[k];
+				}
+			}
+
+			for(k = 0; k <= j; ++k)
+			{
+				size_t x;
+
+				if(!planned)
+				{
+					color_plan_init(&plan, (enum color_type)row[row_spans[k].begin].type, row[row_spans[k].begin].extra, new_type, new_extra);
+					planned = 1;
+				}
+
+				for(x = row_spans[k].begin; x < row_spans[k].end; ++x)
+				{
+					assert(row[x].type == plan.src_type && row[x].extra == plan.src_extra);
+				}
+
+				color_plan_execute(&plan, &row[row_spans[k].begin], row_spans[k].end - row_spans[k].begin);
+			}
+		}
+	}
+
+	free(spans);
+	return 1;
+}
@@ -0,0 +1,356 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Gamma-correct resampling and compositing of RGB8 images. Pixels are
+	linearized by table, filtered in linear light and encoded with the
+	threshold encoder, one output row at a time. Only a few horizontally
+	filtered rows are kept per thread; the full-size linear image is never
+	stored.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+static double const pi = 3.1415926535897932384626433833;
+
+struct filter_taps
+{
+	size_t max_taps;
+	ptrdiff_t *start; // first source pixel of each output pixel.
+	size_t *count;
+	float *weights; // max_taps per output pixel.
+};
+
+static double filter_radius(enum color_filter filter)
+{
+	switch(filter)
+	{
+	case COLOR_FILTER_BOX: return 0.5;
+	case COLOR_FILTER_BILINEAR: return 1.0;
+	case COLOR_FILTER_LANCZOS3: return 3.0;
+	default: assert(0); return 0.0;
+	}
+}
+
+static double filter_weight(enum color_filter filter, double x)
+{
+	double px;
+
+	switch(filter)
+	{
+	case COLOR_FILTER_BOX:
+		return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+	case COLOR_FILTER_BILINEAR:
+		x = fabs(x);
+		return x < 1.0 ? 1.0 - x : 0.0;
+	case COLOR_FILTER_LANCZOS3:
+		if(x == 0.0) return 1.0;
+		if(fabs(x) >= 3.0) return 0.0;
+		px = x * pi;
+		return sin(px) * sin(px * (1.0 / 3.0)) / (px * px * (1.0 / 3.0));
+	default:
+		assert(0);
+		return 0.0;
+	}
+}
+
+static void filter_taps_free(struct filter_taps *taps)
+{
+	free(taps->start);
+	free(taps->count);
+	free(taps->weights);
+}
+
+static int filter_taps_init(struct filter_taps *taps, size_t in, size_t out, enum color_filter filter)
+{
+	double scale, fscale, support;
+	size_t o;
+
+	// when downscaling, the filter is stretched to cover every source pixel.
+
+	scale = (double)in / (double)out;
+	fscale = scale > 1.0 ? scale : 1.0;
+	support = filter_radius(filter) * fscale;
+
+	taps->max_taps = (size_t)ceil(support * 2.0) + 1;
+	taps->start = (ptrdiff_t*)malloc(sizeof(ptrdiff_t) * out);
+	taps->count = (size_t*)malloc(sizeof(size_t) * out);
+	taps->weights = (float*)malloc(sizeof(float) * taps->max_taps * out);
+
+	if(!taps->start || !taps->count || !taps->weights)
+	{
+		filter_taps_free(taps);
+		return 0;
+	}
+
+	for(o = 0; o < out; ++o)
+	{
+		float *w = taps->weights + taps->max_taps * o;
+		double center, sum, tmp[64], *ws;
+		ptrdiff_t first, last, i;
+		size_t n, j;
+
+		center = (o + 0.5) * scale;
+
+		first = (ptrdiff_t)floor(center - support);
+		last = (ptrdiff_t)ceil(center + support);
+
+		if(first < 0) first = 0;
+		if(last > (ptrdiff_t)in) last = (ptrdiff_t)in;
+
+		n = (size_t)(last - first);
+		if(n > taps->max_taps) n = taps->max_taps;
+
+		ws = n <= 64 ? tmp : (double*)malloc(sizeof(double) * n);
+
+		if(!ws)
+		{
+			filter_taps_free(taps);
+			return 0;
+		}
+
+		sum = 0.0;
+
+		for(j = 0; j < n; ++j)
+		{
+			i = first + (ptrdiff_t)j;
+			ws[j] = filter_weight(filter, (i + 0.5 - center) / fscale);
+			sum += ws[j];
+		}
+
+		// trim taps that do not contribute.
+
+		while(n && ws[n - 1] == 0.0) --n;
+		j = 0;
+		while(j < n && ws[j] == 0.0) ++j;
+
+		taps->start[o] = first + (ptrdiff_t)j;
+		taps->count[o] = n - j;
+
+		for(i = 0; (size_t)i < n - j; ++i)
+		{
+			w[i] = (float)(ws[j + i] / sum);
+		}
+
+		if(ws != tmp)
+		{
+			free(ws);
+		}
+
+		assert(taps->count[o] > 0);
+	}
+
+	return 1;
+}
+
+static void linearize_row(float *dst, struct color const *src, size_t width)
+{
+	double const *tbl = color_rgb8_linear_tbl;
+	size_t x;
+
+	for(x = 0; x < width; ++x)
+	{
+		assert(src[x].type == COLOR_RGB8);
+
+		dst[x * 3 + 0] = (float)tbl[src[x].RGB8.R];
+		dst[x * 3 + 1] = (float)tbl[src[x].RGB8.G];
+		dst[x * 3 + 2] = (float)tbl[src[x].RGB8.B];
+	}
+}
+
+static void filter_row(float *dst, float const *src, struct filter_taps const *taps, size_t width)
+{
+	size_t x, j;
+
+	for(x = 0; x < width; ++x)
+	{
+		float const *w = taps->weights + taps->max_taps * x;
+		float const *s = src + taps->start[x] * 3;
+		float R = 0.0f, G = 0.0f, B = 0.0f;
+
+		for(j = 0; j < taps->count[x]; ++j)
+		{
+			R += s[j * 3 + 0] * w[j];
+			G += s[j * 3 + 1] * w[j];
+			B += s[j * 3 + 2] * w[j];
+		}
+
+		dst[x * 3 + 0] = R;
+		dst[x * 3 + 1] = G;
+		dst[x * 3 + 2] = B;
+	}
+}
+
+COLOR_EXPORT int COLOR_CALL color_resample_rgb8(struct color_image const *dst, struct color_image const *src, enum color_filter filter)
+{
+	struct filter_taps htaps, vtaps;
+	float *buffers;
+	ptrdiff_t *ring_rows;
+	size_t per_thread;
+	int threads;
+
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(dst->pixels != NULL && dst->width && dst->height);
+	assert(src->pixels != NULL && src->width && src->height);
+	assert(dst->stride >= dst->width);
+	assert(src->stride >= src->width);
+	assert(dst->pixels != src->pixels);
+
+	if(!filter_taps_init(&htaps, src->width, dst->width, filter))
+	{
+		return 0;
+	}
+
+	if(!filter_taps_init(&vtaps, src->height, dst->height, filter))
+	{
+		filter_taps_free(&htaps);
+		return 0;
+	}
+
+	threads = dst->width * dst->height >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+
+	// each thread has a linearized source row, and a ring of horizontally
+	// filtered rows covering the vertical filter's window.
+
+	per_thread = src->width * 3 + vtaps.max_taps * dst->width * 3;
+	buffers = (float*)malloc(sizeof(float) * per_thread * threads);
+	ring_rows = (ptrdiff_t*)malloc(sizeof(ptrdiff_t) * vtaps.max_taps * threads);
+
+	if(!buffers || !ring_rows)
+	{
+		free(buffers);
+		free(ring_rows);
+		filter_taps_free(&htaps);
+		filter_taps_free(&vtaps);
+		return 0;
+	}
+
+#pragma omp parallel num_threads(threads)
+	{
+		int t = color_thread_index();
+		float *lin = buffers + per_thread * t;
+		float *ring = lin + src->width * 3;
+		ptrdiff_t *rows = ring_rows + vtaps.max_taps * t;
+		ptrdiff_t y;
+		size_t i;
+
+		for(i = 0; i < vtaps.max_taps; ++i)
+		{
+			rows[i] = -1;
+		}
+
+		// static scheduling hands each thread a contiguous band, so
+		// neighboring output rows reuse the filtered rows in the ring.
+
+#pragma omp for schedule(static)
+		for(y = 0; y < (ptrdiff_t)dst->height; ++y)
+		{
+			float const *w = vtaps.weights + vtaps.max_taps * y;
+			struct color *out = dst->pixels + dst->stride * y;
+			size_t x, j;
+
+			for(j = 0; j < vtaps.count[y]; ++j)
+			{
+				ptrdiff_t sy = vtaps.start[y] + (ptrdiff_t)j;
+				size_t slot = (size_t)sy % vtaps.max_taps;
+
+				if(rows[slot] != sy)
+				{
+					linearize_row(lin, src->pixels + src->stride * sy, src->width);
+					filter_row(ring + dst->width * 3 * slot, lin, &htaps, dst->width);
+					rows[slot] = sy;
+				}
+			}
+
+			for(x = 0; x < dst->width; ++x)
+			{
+				float R = 0.0f, G = 0.0f, B = 0.0f;
+
+				for(j = 0; j < vtaps.count[y]; ++j)
+				{
+					size_t slot = (size_t)(vtaps.start[y] + (ptrdiff_t)j) % vtaps.max_taps;
+					float const *s = ring + dst->width * 3 * slot + x * 3;
+
+					R += s[0] * w[j];
+					G += s[1] * w[j];
+					B += s[2] * w[j];
+				}
+
+				out[x].type = COLOR_RGB8;
+				out[x].extra = 0;
+				out[x].RGB8.R = color_linear_to_rgb8_fast(R);
+				out[x].RGB8.G = color_linear_to_rgb8_fast(G);
+				out[x].RGB8.B = color_linear_to_rgb8_fast(B);
+			}
+		}
+	}
+
+	free(buffers);
+	free(ring_rows);
+	filter_taps_free(&htaps);
+	filter_taps_free(&vtaps);
+	return 1;
+}
+
+COLOR_EXPORT void COLOR_CALL color_blend_over_rgb8(struct color_image const *dst, struct color_image const *src, uint8_t const *alpha, size_t alpha_stride)
+{
+	double const *tbl = color_rgb8_linear_tbl;
+	ptrdiff_t y;
+
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(alpha != NULL);
+	assert(dst->width == src->width && dst->height == src->height);
+	assert(dst->stride >= dst->width);
+	assert(src->stride >= src->width);
+	assert(alpha_stride >= dst->width);
+
+#pragma omp parallel for schedule(static) if(dst->width * dst->height >= COLOR_PARALLEL_MIN)
+	for(y = 0; y < (ptrdiff_t)dst->height; ++y)
+	{
+		struct color *d = dst->pixels + dst->stride * y;
+		struct color const *s = src->pixels + src->stride * y;
+		uint8_t const *a = alpha + alpha_stride * y;
+		size_t x;
+
+		for(x = 0; x < dst->width; ++x)
+		{
+			double sa = a[x] * (1.0 / 255.0), da = 1.0 - sa;
+
+			assert(d[x].type == COLOR_RGB8);
+			assert(s[x].type == COLOR_RGB8);
+
+			d[x].RGB8.R = color_linear_to_rgb8_fast(tbl[s[x].RGB8.R] * sa + tbl[d[x].RGB8.R] * da);
+			d[x].RGB8.G = color_linear_to_rgb8_fast(tbl[s[x].RGB8.G] * sa + tbl[d[x].RGB8.G] * da);
+			d[x].RGB8.B = color_linear_to_rgb8_fast(tbl[s[x].RGB8.B] * sa + tbl[d[x].RGB8.B] * da);
+		}
+	}
+}
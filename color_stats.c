@@ -0,0 +1,229 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Image statistics: histograms and mean/variance of an image in any colorspace,
+	computed in one streamed pass without storing the converted image.
+
+	Each thread keeps its own histogram and Welford accumulators, which are merged
+	at the end using Chan et al.'s pairwise update.
+*/
+
+#define COLOR_EXPORTS
+
+#include <math.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_internal.h"
+
+struct stats_accum
+{
+	uint64_t n;
+	double mean[3], m2[3];
+	double min[3], max[3];
+	uint64_t *histogram;
+};
+
+static void stats_accum_init(struct stats_accum *acc, uint64_t *histogram)
+{
+	int i;
+
+	acc->n = 0;
+
+	for(i = 0; i < 3; ++i)
+	{
+		acc->mean[i] = 0.0;
+		acc->m2[i] = 0.0;
+		acc->min[i] = HUGE_VAL;
+		acc->max[i] = -HUGE_VAL;
+	}
+
+	acc->histogram = histogram;
+}
+
+static void stats_accum_add(struct stats_accum *acc, struct color_stats const *stats, double const *scale, double const *v)
+{
+	double n, delta, bin;
+	unsigned idx;
+	int i;
+
+	n = (double)++acc->n;
+
+	for(i = 0; i < 3; ++i)
+	{
+		delta = v[i] - acc->mean[i];
+		acc->mean[i] += delta / n;
+		acc->m2[i] += delta * (v[i] - acc->mean[i]);
+
+		if(v[i] < acc->min[i]) acc->min[i] = v[i];
+		if(v[i] > acc->max[i]) acc->max[i] = v[i];
+
+		if(acc->histogram)
+		{
+			// written so that NaN lands in the first bin.
+
+			bin = (v[i] - stats->lo[i]) * scale[i];
+			idx =
+				!(bin >= 1.0) ? 0 :
+				bin >= (double)(stats->bins - 1) ? stats->bins - 1 :
+				(unsigned)bin;
+
+			++acc->histogram[i * stats->bins + idx];
+		}
+	}
+}
+
+static void stats_accum_merge(struct stats_accum *dst, struct stats_accum const *src)
+{
+	double n, delta;
+	uint64_t total;
+	int i;
+
+	if(!src->n)
+	{
+		return;
+	}
+
+	total = dst->n + src->n;
+	n = (double)total;
+
+	for(i = 0; i < 3; ++i)
+	{
+		delta = src->mean[i] - dst->mean[i];
+
+		dst->m2[i] += src->m2[i] + delta * delta * ((double)dst->n * (double)src->n / n);
+		dst->mean[i] += delta * ((double)src->n / n);
+
+		if(src->min[i] < dst->min[i]) dst->min[i] = src->min[i];
+		if(src->max[i] > dst->max[i]) dst->max[i] = src->max[i];
+	}
+
+	dst->n = total;
+}
+
+COLOR_EXPORT int COLOR_CALL color_image_stats(struct color_stats *stats, struct color_image const *img, enum color_type type, uint8_t extra)
+{
+	struct stats_accum *accs;
+	uint64_t *histograms;
+	struct color_plan plan;
+	double scale[3];
+	size_t hist_size;
+	int threads, t, i;
+	unsigned j;
+
+	assert(stats != NULL);
+	assert(img != NULL);
+	assert(img->pixels != NULL || !img->width || !img->height);
+	assert(img->stride >= img->width);
+	assert(type > COLOR_NONE);
+	assert(type < COLOR_DUMMY_END);
+	assert(stats->histogram == NULL || stats->bins > 0);
+
+	threads = img->width * img->height >= COLOR_PARALLEL_MIN ? color_thread_count() : 1;
+	hist_size = stats->histogram ? (size_t)stats->bins * 3 : 0;
+
+	accs = (struct stats_accum*)malloc(sizeof(struct stats_accum) * threads);
+	histograms = hist_size ? (uint64_t*)calloc(hist_size * threads, sizeof(uint64_t)) : NULL;
+
+	if(!accs || (hist_size && !histograms))
+	{
+		free(accs);
+		free(histograms);
+		return 0;
+	}
+
+	for(t = 0; t < threads; ++t)
+	{
+		stats_accum_init(&accs[t], histograms ? histograms + hist_size * t : NULL);
+	}
+
+	for(i = 0; i < 3; ++i)
+	{
+		scale[i] = stats->histogram ? stats->bins / (stats->hi[i] - stats->lo[i]) : 0.0;
+	}
+
+	if(img->width && img->height)
+	{
+		color_plan_init(&plan, (enum color_type)img->pixels[0].type, img->pixels[0].extra, type, extra);
+
+#pragma omp parallel num_threads(threads)
+		{
+			struct stats_accum *acc = &accs[color_thread_index()];
+			struct color buf[COLOR_CHUNK];
+			double v[3];
+			ptrdiff_t y;
+			size_t x, n, k;
+
+#pragma omp for schedule(dynamic, 1)
+			for(y = 0; y < (ptrdiff_t)img->height; ++y)
+			{
+				struct color const *row = img->pixels + img->stride * y;
+
+				for(x = 0; x < img->width; x += n)
+				{
+					n = img->width - x < COLOR_CHUNK ? img->width - x : COLOR_CHUNK;
+
+					memcpy(buf, row + x, n * sizeof(struct color));
+					color_plan_execute(&plan, buf, n);
+
+					for(k = 0; k < n; ++k)
+					{
+						color_extract_components(v, &buf[k]);
+						stats_accum_add(acc, stats, scale, v);
+					}
+				}
+			}
+		}
+	}
+
+	for(t = 1; t < threads; ++t)
+	{
+		stats_accum_merge(&accs[0], &accs[t]);
+
+		for(j = 0; j < hist_size; ++j)
+		{
+			histograms[j] += histograms[hist_size * t + j];
+		}
+	}
+
+	stats->count = accs[0].n;
+
+	for(i = 0; i < 3; ++i)
+	{
+		stats->mean[i] = accs[0].mean[i];
+		stats->variance[i] = accs[0].n ? accs[0].m2[i] / (double)accs[0].n : 0.0;
+		stats->min[i] = accs[0].min[i];
+		stats->max[i] = accs[0].max[i];
+	}
+
+	if(hist_size)
+	{
+		memcpy(stats->histogram, histograms, hist_size * sizeof(uint64_t));
+	}
+
+	free(accs);
+	free(histograms);
+	return 1;
+}
@@ -0,0 +1,919 @@
+/*
+	Color conversions
+	Copyright (c) 2011, Cory Nelson (phrosty@gmail.com)
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		 * Redistributions of source code must retain the above copyright
+			notice, this list of conditions and the following disclaimer.
+		 * Redistributions in binary form must reproduce the above copyright
+			notice, this list of conditions and the following disclaimer in the
+			documentation and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+	Streaming command-line converter. Reads frames from a file or stdin, converts
+	them between any two color types, and writes them to a file or stdout.
+
+	Input formats, detected from the stream unless -i raw is given:
+	- ppm: binary P6. maxval 255 loads as RGB8, others as RGB scaled to [0, 1].
+	- pfm: PF color float maps, as Linear RGB.
+	- y4m: YUV4MPEG2 with 4:4:4, 4:2:2, 4:2:0 or mono 8-bit chroma, as YCbCr.
+	  Chroma is upsampled by nearest neighbour. XCOLORRANGE=FULL selects full range.
+	- raw: three planes per frame, bytes for RGB8/YCbCr and native floats for
+	  other types. Needs -s.
+	Concatenated ppm/pfm images are read as consecutive frames. -f overrides the
+	type the input is loaded as.
+
+	Output is raw planes, as above, or pfm with the three components as floats.
+
+	Frames are pipelined over three buffers: while one is converted on all
+	threads, the next is read and the previous written. The reading and writing
+	threads join the conversion once their I/O is done. Throughput is printed to
+	stderr at the end.
+
+	With -m, input and output are instead headerless files of interleaved
+	colors: 3 bytes each for RGB8/YCbCr, 4 floats (the last unused) for other
+	types. Both are memory mapped a window at a time rather than streamed, so
+	arbitrarily large archives convert without any buffering of our own.
+
+	usage: colorconv -t type [-f type] [-x extra] [-X extra] [-i raw -s WxH] [-o raw|pfm] [input [output]]
+	       colorconv -m -t type [-f type] [-x extra] [-X extra] input output
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static double now_ns(void)
+{
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	return (double)count.QuadPart * 1e9 / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+#include <sys/stat.h>
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+#endif
+
+// pixels converted per grab of the shared counter.
+#define CONVERT_BLOCK 4096
+
+// the largest frame accepted, in pixels. frame sizes come from untrusted headers.
+#define FRAME_MAX_PIXELS ((size_t)1 << 30)
+
+enum file_format
+{
+	FORMAT_AUTO,
+	FORMAT_RAW,
+	FORMAT_PPM,
+	FORMAT_PFM,
+	FORMAT_Y4M
+};
+
+struct frame
+{
+	enum file_format format;
+	size_t width, height;
+	unsigned maxval; // ppm
+	int swap; // pfm: data is of the other endianness.
+	unsigned cshift_x, cshift_y; // y4m: chroma subsampling, as shifts. mono has no chroma planes.
+	int mono;
+	unsigned char *data;
+	size_t size, capacity;
+};
+
+struct options
+{
+	enum file_format in_format, out_format;
+	int mapped;
+	int from, to; // COLOR_NONE: from the input format.
+	unsigned from_extra, to_extra;
+	size_t raw_width, raw_height;
+};
+
+struct input
+{
+	FILE *file;
+	struct options const *opt;
+	int y4m; // the stream header has been read.
+	size_t y4m_width, y4m_height;
+	unsigned y4m_cshift_x, y4m_cshift_y;
+	int y4m_mono, y4m_full;
+};
+
+static int is_8bit(int type)
+{
+	return type == COLOR_RGB8 || type == COLOR_YCBCR;
+}
+
+static int little_endian(void)
+{
+	unsigned one = 1;
+	return *(unsigned char*)&one == 1;
+}
+
+static float load_float(unsigned char const *p, int swap)
+{
+	unsigned char b[4];
+	float f;
+
+	if(swap)
+	{
+		b[0] = p[3]; b[1] = p[2]; b[2] = p[1]; b[3] = p[0];
+		p = b;
+	}
+
+	memcpy(&f, p, 4);
+	return f;
+}
+
+static int parse_type(char const *name)
+{
+	int type;
+
+	// case and spaces are ignored: "linearrgb" matches "Linear RGB".
+
+	for(type = COLOR_NONE + 1; type < COLOR_DUMMY_END; ++type)
+	{
+		char const *a = name, *b = color_name((enum color_type)type);
+
+		for(;;)
+		{
+			while(*a == ' ') ++a;
+			while(*b == ' ') ++b;
+
+			if(tolower((unsigned char)*a) != tolower((unsigned char)*b)) break;
+			if(!*a) return type;
+
+			++a;
+			++b;
+		}
+	}
+
+	return COLOR_NONE;
+}
+
+static int frame_reserve(struct frame *f, size_t size)
+{
+	if(size > f->capacity)
+	{
+		unsigned char *data = (unsigned char*)realloc(f->data, size);
+
+		if(!data)
+		{
+			fprintf(stderr, "out of memory.\n");
+			return 0;
+		}
+
+		f->data = data;
+		f->capacity = size;
+	}
+
+	f->size = size;
+	return 1;
+}
+
+// bytes of a w x h frame of bpp bytes per pixel. 0, reported, when either is 0 or the frame is
+// above FRAME_MAX_PIXELS or its size overflows size_t.
+
+static size_t frame_bytes(size_t w, size_t h, size_t bpp)
+{
+	if(!w || !h || w > FRAME_MAX_PIXELS / h || w * h > SIZE_MAX / bpp)
+	{
+		fprintf(stderr, "bad frame size.\n");
+		return 0;
+	}
+
+	return w * h * bpp;
+}
+
+static int read_exact(FILE *file, void *dst, size_t size)
+{
+	if(fread(dst, 1, size, file) != size)
+	{
+		fprintf(stderr, "truncated frame.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+// reads a whitespace-separated token of a netpbm header, skipping comments.
+
+static int read_token(FILE *file, char *dst, size_t size)
+{
+	size_t len = 0;
+	int c;
+
+	do
+	{
+		c = getc(file);
+
+		if(c == '#')
+		{
+			while(c != '\n' && c != EOF) c = getc(file);
+		}
+	}
+	while(c != EOF && isspace(c));
+
+	while(c != EOF && !isspace(c) && len + 1 < size)
+	{
+		dst[len++] = (char)c;
+		c = getc(file);
+	}
+
+	// the single whitespace after the last header field is consumed here.
+
+	dst[len] = 0;
+	return len != 0;
+}
+
+static int read_netpbm(struct input *in, struct frame *f, int pfm)
+{
+	char tok[64];
+	unsigned long w, h;
+	size_t size;
+
+	if(!read_token(in->file, tok, sizeof tok) || !(w = strtoul(tok, NULL, 10)) ||
+		!read_token(in->file, tok, sizeof tok) || !(h = strtoul(tok, NULL, 10)) ||
+		!read_token(in->file, tok, sizeof tok))
+	{
+		fprintf(stderr, "bad %s header.\n", pfm ? "pfm" : "ppm");
+		return -1;
+	}
+
+	f->width = w;
+	f->height = h;
+
+	if(pfm)
+	{
+		double scale = strtod(tok, NULL);
+
+		f->format = FORMAT_PFM;
+		f->swap = (scale < 0.0) != little_endian();
+		size = frame_bytes(f->width, f->height, 12);
+	}
+	else
+	{
+		f->format = FORMAT_PPM;
+		f->maxval = (unsigned)strtoul(tok, NULL, 10);
+
+		if(f->maxval == 0 || f->maxval > 65535)
+		{
+			fprintf(stderr, "bad ppm maxval.\n");
+			return -1;
+		}
+
+		size = frame_bytes(f->width, f->height, f->maxval > 255 ? 6 : 3);
+	}
+
+	return size && frame_reserve(f, size) && read_exact(in->file, f->data, size) ? 1 : -1;
+}
+
+static int read_y4m_header(struct input *in)
+{
+	char line[1024], *tok;
+
+	if(!fgets(line, sizeof line, in->file))
+	{
+		fprintf(stderr, "bad y4m header.\n");
+		return 0;
+	}
+
+	in->y4m = 1;
+	in->y4m_width = in->y4m_height = 0;
+	in->y4m_cshift_x = in->y4m_cshift_y = 1;
+	in->y4m_mono = 0;
+	in->y4m_full = 0;
+
+	for(tok = strtok(line, " \n"); tok; tok = strtok(NULL, " \n"))
+	{
+		switch(tok[0])
+		{
+		case 'W':
+			in->y4m_width = strtoul(tok + 1, NULL, 10);
+			break;
+		case 'H':
+			in->y4m_height = strtoul(tok + 1, NULL, 10);
+			break;
+		case 'C':
+			if(!strcmp(tok, "C444"))
+			{
+				in->y4m_cshift_x = in->y4m_cshift_y = 0;
+			}
+			else if(!strcmp(tok, "C422"))
+			{
+				in->y4m_cshift_y = 0;
+			}
+			else if(!strcmp(tok, "Cmono"))
+			{
+				in->y4m_mono = 1;
+			}
+			else if(strncmp(tok, "C420", 4) || strstr(tok, "p1")) // C420p10 and such are not 8-bit.
+			{
+				fprintf(stderr, "unsupported y4m colorspace %s.\n", tok);
+				return 0;
+			}
+			break;
+		case 'X':
+			if(!strcmp(tok, "XCOLORRANGE=FULL"))
+			{
+				in->y4m_full = 1;
+			}
+			break;
+		}
+	}
+
+	if(!in->y4m_width || !in->y4m_height)
+	{
+		fprintf(stderr, "bad y4m header.\n");
+		return 0;
+	}
+
+	// a frame is at most three full planes.
+	if(!frame_bytes(in->y4m_width, in->y4m_height, 3))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int read_y4m_frame(struct input *in, struct frame *f)
+{
+	char line[256];
+	size_t w = in->y4m_width, h = in->y4m_height, cw, ch;
+
+	if(!fgets(line, sizeof line, in->file))
+	{
+		return 0;
+	}
+
+	if(strncmp(line, "FRAME", 5))
+	{
+		fprintf(stderr, "bad y4m frame header.\n");
+		return -1;
+	}
+
+	f->format = FORMAT_Y4M;
+	f->width = w;
+	f->height = h;
+	f->cshift_x = in->y4m_cshift_x;
+	f->cshift_y = in->y4m_cshift_y;
+	f->mono = in->y4m_mono;
+
+	cw = (w + ((size_t)1 << f->cshift_x) - 1) >> f->cshift_x;
+	ch = (h + ((size_t)1 << f->cshift_y) - 1) >> f->cshift_y;
+
+	return frame_reserve(f, w * h + (f->mono ? 0 : cw * ch * 2)) && read_exact(in->file, f->data, f->size) ? 1 : -1;
+}
+
+// 1: a frame was read. 0: end of input. -1: error, already reported.
+
+static int read_frame(struct input *in, struct frame *f)
+{
+	char magic[10];
+	int c;
+
+	if(in->opt->in_format == FORMAT_RAW)
+	{
+		size_t size = frame_bytes(in->opt->raw_width, in->opt->raw_height, 3 * (is_8bit(in->opt->from) ? 1 : 4));
+
+		f->format = FORMAT_RAW;
+		f->width = in->opt->raw_width;
+		f->height = in->opt->raw_height;
+
+		if(!size || !frame_reserve(f, size)) return -1;
+		if((c = getc(in->file)) == EOF) return 0;
+
+		f->data[0] = (unsigned char)c;
+		return read_exact(in->file, f->data + 1, size - 1) ? 1 : -1;
+	}
+
+	if(in->y4m)
+	{
+		return read_y4m_frame(in, f);
+	}
+
+	// skip whitespace between concatenated images.
+
+	do c = getc(in->file); while(c != EOF && isspace(c));
+
+	if(c == EOF)
+	{
+		return 0;
+	}
+
+	magic[0] = (char)c;
+
+	if(!read_exact(in->file, magic + 1, 1)) return -1;
+
+	if(magic[0] == 'P' && magic[1] == '6') return read_netpbm(in, f, 0);
+	if(magic[0] == 'P' && magic[1] == 'F') return read_netpbm(in, f, 1);
+
+	if(!read_exact(in->file, magic + 2, 7)) return -1;
+
+	if(!memcmp(magic, "YUV4MPEG2", 9))
+	{
+		return read_y4m_header(in) ? read_y4m_frame(in, f) : -1;
+	}
+
+	fprintf(stderr, "unrecognized input format.\n");
+	return -1;
+}
+
+// the type and extra a frame loads as.
+
+static void frame_source(struct frame const *f, struct input const *in, int *type, unsigned *extra)
+{
+	*type = in->opt->from;
+	*extra = in->opt->from_extra;
+
+	if(*type == COLOR_NONE)
+	{
+		switch(f->format)
+		{
+		case FORMAT_PPM: *type = f->maxval == 255 ? COLOR_RGB8 : COLOR_RGB; break;
+		case FORMAT_PFM: *type = COLOR_LINEAR_RGB; break;
+		case FORMAT_Y4M: *type = COLOR_YCBCR; break;
+		default: *type = COLOR_RGB8; break;
+		}
+	}
+
+	if(f->format == FORMAT_Y4M && in->y4m_full)
+	{
+		*extra |= COLOR_YCBCR_FULL_RANGE;
+	}
+}
+
+// pixels [first, first + n) of a frame, in row-major order from the top.
+
+static void load_pixels(struct color *dst, struct frame const *f, size_t first, size_t n, int type, uint8_t extra)
+{
+	size_t plane = f->width * f->height, i;
+	double v[3];
+	int j;
+
+	for(i = 0; i < n; ++i)
+	{
+		size_t p = first + i, x = p % f->width, y = p / f->width;
+
+		switch(f->format)
+		{
+		case FORMAT_PPM:
+			if(f->maxval == 255 && is_8bit(type))
+			{
+				unsigned char const *s = f->data + p * 3;
+
+				dst[i].type = (uint8_t)type;
+				dst[i].extra = extra;
+				dst[i].RGB8.R = s[0];
+				dst[i].RGB8.G = s[1];
+				dst[i].RGB8.B = s[2];
+				continue;
+			}
+
+			for(j = 0; j < 3; ++j)
+			{
+				unsigned s = f->maxval > 255 ? f->data[p * 6 + j * 2] << 8 | f->data[p * 6 + j * 2 + 1] : f->data[p * 3 + j];
+				v[j] = (double)s / f->maxval * (is_8bit(type) ? 255.0 : 1.0);
+			}
+			break;
+		case FORMAT_PFM:
+			{
+				// rows are stored bottom to top.
+				unsigned char const *s = f->data + ((f->height - 1 - y) * f->width + x) * 12;
+
+				// floats are nominally in [0, 1]; 8-bit types take their codes.
+				for(j = 0; j < 3; ++j)
+				{
+					v[j] = load_float(s + j * 4, f->swap) * (is_8bit(type) ? 255.0 : 1.0);
+				}
+			}
+			break;
+		case FORMAT_Y4M:
+			{
+				size_t cw = (f->width + ((size_t)1 << f->cshift_x) - 1) >> f->cshift_x;
+				size_t c = (y >> f->cshift_y) * cw + (x >> f->cshift_x);
+				size_t cplane = cw * ((f->height + ((size_t)1 << f->cshift_y) - 1) >> f->cshift_y);
+
+				v[0] = f->data[p];
+				v[1] = f->mono ? 128.0 : f->data[plane + c];
+				v[2] = f->mono ? 128.0 : f->data[plane + cplane + c];
+
+				if(!is_8bit(type))
+				{
+					v[0] *= 1.0 / 255.0; v[1] *= 1.0 / 255.0; v[2] *= 1.0 / 255.0;
+				}
+			}
+			break;
+		default:
+			if(is_8bit(type))
+			{
+				dst[i].type = (uint8_t)type;
+				dst[i].extra = extra;
+				dst[i].RGB8.R = f->data[p];
+				dst[i].RGB8.G = f->data[plane + p];
+				dst[i].RGB8.B = f->data[plane * 2 + p];
+				continue;
+			}
+
+			for(j = 0; j < 3; ++j)
+			{
+				v[j] = load_float(f->data + (plane * j + p) * 4, 0);
+			}
+			break;
+		}
+
+		color_set_components(&dst[i], (enum color_type)type, extra, v);
+	}
+}
+
+static void store_pixels(struct frame *f, struct color const *src, size_t first, size_t n)
+{
+	size_t plane = f->width * f->height, i;
+	int j;
+
+	for(i = 0; i < n; ++i)
+	{
+		size_t p = first + i;
+		double v[3];
+
+		if(f->format == FORMAT_RAW && is_8bit(src[i].type))
+		{
+			f->data[p] = src[i].RGB8.R;
+			f->data[plane + p] = src[i].RGB8.G;
+			f->data[plane * 2 + p] = src[i].RGB8.B;
+			continue;
+		}
+
+		color_extract_components(v, &src[i]);
+
+		for(j = 0; j < 3; ++j)
+		{
+			float c = (float)v[j];
+
+			if(f->format == FORMAT_PFM)
+			{
+				// back to [0, 1] for 8-bit types, as load_pixels scaled them up.
+				size_t x = p % f->width, y = p / f->width;
+				if(is_8bit(src[i].type)) c = (float)(v[j] * (1.0 / 255.0));
+				memcpy(f->data + ((f->height - 1 - y) * f->width + x) * 12 + j * 4, &c, 4);
+			}
+			else
+			{
+				memcpy(f->data + (plane * j + p) * 4, &c, 4);
+			}
+		}
+	}
+}
+
+static int write_frame(FILE *file, struct frame const *f)
+{
+	if(f->format == FORMAT_PFM && fprintf(file, "PF\n%llu %llu\n%s\n", (unsigned long long)f->width, (unsigned long long)f->height, little_endian() ? "-1.0" : "1.0") < 0)
+	{
+		return 0;
+	}
+
+	if(fwrite(f->data, 1, f->size, file) != f->size)
+	{
+		fprintf(stderr, "write failed.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+// converts in to out on every thread of the enclosing parallel region, in blocks taken from *next.
+
+static void convert_frame(struct frame *out, struct frame const *in, struct color_plan const *plan, long *next)
+{
+	size_t pixels = in->width * in->height;
+	struct color buf[256];
+
+	for(;;)
+	{
+		size_t first, end, i, n;
+		long block;
+
+#pragma omp atomic capture
+		block = (*next)++;
+
+		first = (size_t)block * CONVERT_BLOCK;
+
+		if(first >= pixels)
+		{
+			break;
+		}
+
+		end = pixels - first < CONVERT_BLOCK ? pixels : first + CONVERT_BLOCK;
+
+		for(i = first; i < end; i += n)
+		{
+			n = end - i < 256 ? end - i : 256;
+
+			load_pixels(buf, in, i, n, plan->src_type, plan->src_extra);
+			color_plan_execute(plan, buf, n);
+			store_pixels(out, buf, i, n);
+		}
+	}
+}
+
+static int convert_mapped(struct options const *opt, char const *in_name, char const *out_name)
+{
+	struct color_plan plan;
+	enum color_format in_format = is_8bit(opt->from) ? COLOR_FORMAT_PACKED24 : COLOR_FORMAT_FLOAT;
+	enum color_format out_format = is_8bit(opt->to) ? COLOR_FORMAT_PACKED24 : COLOR_FORMAT_FLOAT;
+	double start, seconds, pixels;
+	unsigned long long bytes = 0;
+#ifdef _WIN32
+	struct _stati64 st;
+#else
+	struct stat st;
+#endif
+
+	if(!strcmp(in_name, "-") || !strcmp(out_name, "-"))
+	{
+		fprintf(stderr, "-m needs an input and output file.\n");
+		return 1;
+	}
+
+	color_plan_init(&plan, (enum color_type)opt->from, (uint8_t)opt->from_extra, (enum color_type)opt->to, (uint8_t)opt->to_extra);
+
+	start = now_ns();
+
+	if(!color_convert_file(out_name, out_format, in_name, in_format, &plan))
+	{
+		fprintf(stderr, "can't convert %s to %s.\n", in_name, out_name);
+		return 1;
+	}
+
+	seconds = (now_ns() - start) * 1e-9;
+
+	// the size is only needed for the stats.
+
+#ifdef _WIN32
+	if(!_stati64(in_name, &st)) bytes = (unsigned long long)st.st_size;
+#else
+	if(!stat(in_name, &st)) bytes = (unsigned long long)st.st_size;
+#endif
+
+	pixels = (double)(bytes / color_format_size(in_format));
+
+	fprintf(stderr, "%.0f pixels in %.3f s: %.1f Mpixels/s, %.1f MB/s in, %.1f MB/s out.\n",
+		pixels, seconds, pixels / seconds * 1e-6, pixels * color_format_size(in_format) / seconds * 1e-6, pixels * color_format_size(out_format) / seconds * 1e-6);
+
+	return 0;
+}
+
+static void usage(char const *name)
+{
+	fprintf(stderr,
+		"usage: %s -t type [-f type] [-x extra] [-X extra] [-i raw -s WxH] [-o raw|pfm] [input [output]]\n"
+		"  -t, -f  target and source types, by name: RGB8, RGB, \"Linear RGB\", HSL, ..., LSHuv.\n"
+		"  -x, -X  source and target extras, as numbers: YUV matrix | 4 for full range YCbCr.\n"
+		"  -i raw  input is raw planes of -f (default RGB8), -s WxH pixels per frame.\n"
+		"  -o      output raw planes (default) or pfm.\n"
+		"  input and output default to stdin and stdout, or are given as -.\n"
+		"  -m      input and output are files of interleaved colors of -f (default RGB8) and -t, and are memory mapped.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct options opt;
+	struct input in;
+	struct frame frames[3], outs[3];
+	char const *in_name = "-", *out_name = "-";
+	FILE *out_file;
+	double start, seconds;
+	unsigned long long frame_count = 0, pixel_count = 0, bytes_in = 0, bytes_out = 0;
+	int have[3] = { 0, 0, 0 }, cur, positional = 0, ok = 1, a;
+
+	memset(&opt, 0, sizeof opt);
+	memset(&in, 0, sizeof in);
+	memset(frames, 0, sizeof frames);
+	memset(outs, 0, sizeof outs);
+
+	opt.out_format = FORMAT_RAW;
+
+	for(a = 1; a < argc; ++a)
+	{
+		char const *arg = argv[a];
+
+		if(!strcmp(arg, "-m"))
+		{
+			opt.mapped = 1;
+			continue;
+		}
+
+		if(arg[0] == '-' && arg[1] && !arg[2] && a + 1 < argc)
+		{
+			char const *val = argv[++a];
+
+			switch(arg[1])
+			{
+			case 't': opt.to = parse_type(val); if(!opt.to) goto bad_type; break;
+			case 'f': opt.from = parse_type(val); if(!opt.from) goto bad_type; break;
+			case 'x': opt.from_extra = (unsigned)strtoul(val, NULL, 0); break;
+			case 'X': opt.to_extra = (unsigned)strtoul(val, NULL, 0); break;
+			case 'i':
+				if(strcmp(val, "raw")) { usage(argv[0]); return 1; }
+				opt.in_format = FORMAT_RAW;
+				break;
+			case 'o':
+				if(!strcmp(val, "raw")) opt.out_format = FORMAT_RAW;
+				else if(!strcmp(val, "pfm")) opt.out_format = FORMAT_PFM;
+				else { usage(argv[0]); return 1; }
+				break;
+			case 's':
+				{
+					unsigned long w, h;
+
+					if(sscanf(val, "%lux%lu", &w, &h) != 2 || !w || !h) { usage(argv[0]); return 1; }
+					opt.raw_width = w;
+					opt.raw_height = h;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+			}
+
+			continue;
+
+		bad_type:
+			fprintf(stderr, "unknown color type \"%s\".\n", val);
+			return 1;
+		}
+
+		if(positional == 0) in_name = arg;
+		else if(positional == 1) out_name = arg;
+		else { usage(argv[0]); return 1; }
+
+		++positional;
+	}
+
+	if(!opt.to || (opt.in_format == FORMAT_RAW && !opt.raw_width))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if((opt.in_format == FORMAT_RAW || opt.mapped) && !opt.from)
+	{
+		opt.from = COLOR_RGB8;
+	}
+
+	if(opt.mapped)
+	{
+		return convert_mapped(&opt, in_name, out_name);
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	in.opt = &opt;
+	in.file = strcmp(in_name, "-") ? fopen(in_name, "rb") : stdin;
+	out_file = strcmp(out_name, "-") ? fopen(out_name, "wb") : stdout;
+
+	if(!in.file || !out_file)
+	{
+		fprintf(stderr, "can't open %s.\n", !in.file ? in_name : out_name);
+		return 1;
+	}
+
+	start = now_ns();
+
+	// frame i is read into buffer i % 3. each round converts the current frame while
+	// reading the next and writing the previous.
+
+	have[0] = read_frame(&in, &frames[0]);
+	ok = have[0] >= 0;
+
+	for(cur = 0; ok && have[cur] > 0; cur = (cur + 1) % 3)
+	{
+		int next = (cur + 1) % 3, prev = (cur + 2) % 3;
+		struct color_plan plan;
+		struct frame *src = &frames[cur], *dst = &outs[cur];
+		int type, read_ok = 1, write_ok = 1;
+		unsigned extra;
+		long block = 0;
+		size_t size;
+
+		frame_source(src, &in, &type, &extra);
+
+		color_plan_init(&plan, (enum color_type)type, (uint8_t)extra, (enum color_type)opt.to, (uint8_t)opt.to_extra);
+
+		dst->format = opt.out_format;
+		dst->width = src->width;
+		dst->height = src->height;
+
+		size = frame_bytes(src->width, src->height, 3 * (opt.out_format == FORMAT_RAW && is_8bit(opt.to) ? 1 : 4));
+
+		if(!size || !frame_reserve(dst, size))
+		{
+			ok = 0;
+			break;
+		}
+
+#pragma omp parallel
+		{
+			int t = 0, nt = 1;
+
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+			nt = omp_get_num_threads();
+#endif
+
+			if(t == 0)
+			{
+				have[next] = read_frame(&in, &frames[next]);
+				read_ok = have[next] >= 0;
+			}
+
+			if(t == nt - 1 && have[prev] > 0)
+			{
+				write_ok = write_frame(out_file, &outs[prev]);
+				have[prev] = 0;
+			}
+
+			convert_frame(dst, src, &plan, &block);
+		}
+
+		ok = read_ok && write_ok;
+
+		++frame_count;
+		pixel_count += src->width * src->height;
+		bytes_in += src->size;
+		bytes_out += dst->size;
+	}
+
+	// the last converted frame is still waiting.
+
+	if(ok && have[(cur + 2) % 3] > 0)
+	{
+		ok = write_frame(out_file, &outs[(cur + 2) % 3]);
+	}
+
+	if(fflush(out_file))
+	{
+		ok = 0;
+	}
+
+	seconds = (now_ns() - start) * 1e-9;
+
+	fprintf(stderr, "%llu frames, %llu pixels in %.3f s: %.1f frames/s, %.1f Mpixels/s, %.1f MB/s in, %.1f MB/s out.\n",
+		frame_count, pixel_count, seconds, frame_count / seconds, pixel_count / seconds * 1e-6, bytes_in / seconds * 1e-6, bytes_out / seconds * 1e-6);
+
+	for(a = 0; a < 3; ++a)
+	{
+		free(frames[a].data);
+		free(outs[a].data);
+	}
+
+	if(in.file != stdin) fclose(in.file);
+	if(out_file != stdout) fclose(out_file);
+
+	return ok ? 0 : 1;
+}